@@ -16,5 +16,19 @@ CONFIG( tests ) {
         lib/lastfm/core/tests/test_libcore.pro \
         lib/lastfm/types/tests/test_libtypes.pro \
         lib/lastfm/scrobble/tests/test_libscrobble.pro \
-        lib/listener/tests/test_liblistener.pro
+        lib/listener/tests/test_liblistener.pro \
+        common/c++/tests/test_silencedetection.pro \
+        common/c++/tests/test_pcmconversion.pro \
+        app/fingerprinter/tests/bench_sources.pro \
+        app/fingerprinter/tests/test_fingerprintqueue.pro \
+        app/boffin/tests/bench_shuffler.pro \
+        app/boffin/tests/test_editdistance.pro \
+        app/boffin/tests/bench_collectionscanner.pro \
+        app/boffin/tests/bench_cometparser.pro \
+        app/boffin/tests/bench_xspfreader.pro \
+        app/client/tests/test_stopwatch.pro \
+        app/client/tests/bench_exclusiontrie.pro \
+        app/client/tests/test_scrobblejournal.pro \
+        app/client/tests/bench_scrobblescheduler.pro \
+        lib/unicorn/tests/bench_settings.pro
 }
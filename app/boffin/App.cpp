@@ -29,6 +29,7 @@
 #include <phonon/audiooutput.h>
 #include <phonon/backendcapabilities.h>
 #include <lastfm/NetworkAccessManager>
+#include <lastfm/misc.h>
 #include "lib/unicorn/QMessageBoxBuilder.h"
 #include "lib/unicorn/UnicornSettings.h"
 #include "App.h"
@@ -49,6 +50,7 @@
 #define OUTPUT_DEVICE_KEY "OutputDevice"
 #define PLAYDAR_AUTHTOKEN_KEY "PlaydarAuth"
 #define PLAYDAR_URLBASE_KEY "PlaydarUrlBase"
+#define LOOKAHEAD_KEY "LookAhead"
 
 App::App( int& argc, char** argv )
    : unicorn::Application( argc, argv )
@@ -70,6 +72,8 @@ App::App( int& argc, char** argv )
 
     m_shuffler = new Shuffler(this);
     m_tracksource = new TrackSource(m_shuffler, this);
+    m_tracksource->setNetworkAccessManager(m_wam);
+    m_tracksource->setSize(QSettings().value(LOOKAHEAD_KEY, 3).toUInt());
 }
 
 
@@ -384,17 +388,18 @@ App::onRescan()
         if (directories.size()) {
             LocalCollectionScanner *scanner = new LocalCollectionScanner(this);
             m_scanWidget = new ScanProgressWidget();
-            connect(scanner, SIGNAL(track(Track)), m_scanWidget, SLOT(onNewTrack(Track)));
+            connect(scanner, SIGNAL(tracks(QList<Track>)), m_scanWidget, SLOT(onNewTracks(QList<Track>)));
             connect(scanner, SIGNAL(directory(QString)), m_scanWidget, SLOT(onNewDirectory(QString)));
             connect(scanner, SIGNAL(finished()), m_scanWidget, SLOT(onFinished()));
             connect(scanner, SIGNAL(finished()), SLOT(newTagcloud()));
             connect(m_scanWidget, SIGNAL(statusMessage(QString)), m_mainwindow->statusBar(), SLOT(showMessage(QString)));
 
             // TODO: fix hard coded paths here!
-            scanner->run(
+            QString collectionDb = "c:\\cygwin\\home\\doug\\src\\playdar\\win32\\collection.db";
+            scanner->setPlaydarScanner(
                 QDir("c:\\cygwin\\home\\doug\\src\\playdar\\win32\\debug\\bin\\"), 
-                "c:\\cygwin\\home\\doug\\src\\playdar\\win32\\collection.db", 
-                directories);
+                collectionDb);
+            scanner->scan(directories, lastfm::dir::runtimeData().filePath("boffin_collection.manifest"));
 
             m_mainwindow->setCentralWidget(m_scanWidget);
         }
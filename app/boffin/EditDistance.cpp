@@ -0,0 +1,348 @@
+/*
+   Copyright 2013 Last.fm Ltd.
+
+   This file is part of the Last.fm Desktop Application Suite.
+
+   lastfm-desktop is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   lastfm-desktop is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with lastfm-desktop.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "EditDistance.h"
+
+#include <cstring>
+#include <vector>
+
+#ifdef _MSC_VER
+typedef unsigned __int64 Word;
+#else
+#include <stdint.h>
+typedef uint64_t Word;
+#endif
+
+static const int WORD_BITS = 64;
+
+// playdar only counts a swap once both strings are past their first
+// character, so transpositions can't end in the first two rows or columns
+static const Word TRANSPOSE_ROWS = ~Word( 3 );
+static const int TRANSPOSE_FIRST_COLUMN = 2;
+
+
+/** Which positions of the pattern hold each character, one bit per
+  * position, in words words. Latin 1 is looked up directly, anything else
+  * is searched for. */
+class PatternMasks
+{
+public:
+    PatternMasks( const QChar* pattern, int length, int words )
+        : m_words( words )
+        , m_latin1( 256 * words, 0 )
+        , m_none( words, 0 )
+    {
+        for ( int i = 0; i < length; ++i )
+        {
+            ushort c = pattern[i].unicode();
+            Word bit = Word( 1 ) << ( i % WORD_BITS );
+
+            if ( c < 256 )
+            {
+                m_latin1[c * m_words + i / WORD_BITS] |= bit;
+                continue;
+            }
+
+            size_t e = 0;
+            while ( e < m_other.size() && m_other[e] != c )
+                ++e;
+
+            if ( e == m_other.size() )
+            {
+                m_other.push_back( c );
+                m_otherMasks.resize( m_otherMasks.size() + m_words, 0 );
+            }
+
+            m_otherMasks[e * m_words + i / WORD_BITS] |= bit;
+        }
+    }
+
+    const Word* operator[]( QChar qc ) const
+    {
+        ushort c = qc.unicode();
+        if ( c < 256 )
+            return &m_latin1[c * m_words];
+
+        for ( size_t e = 0; e < m_other.size(); ++e )
+            if ( m_other[e] == c )
+                return &m_otherMasks[e * m_words];
+
+        return &m_none[0];
+    }
+
+private:
+    int m_words;
+    std::vector<Word> m_latin1;
+    std::vector<Word> m_none;
+    std::vector<ushort> m_other;
+    std::vector<Word> m_otherMasks;
+};
+
+
+/** pattern is at most 64 characters, and not empty */
+static int
+distanceSingleWord( const QChar* pattern, int m, const QChar* text, int n, int max )
+{
+    // a table on the stack is much cheaper than PatternMasks for the
+    // usual short latin 1 names
+    Word latin1[256];
+    std::memset( latin1, 0, sizeof( latin1 ) );
+
+    ushort other[WORD_BITS];
+    Word otherMasks[WORD_BITS];
+    int otherCount = 0;
+
+    for ( int i = 0; i < m; ++i )
+    {
+        ushort c = pattern[i].unicode();
+        if ( c < 256 )
+        {
+            latin1[c] |= Word( 1 ) << i;
+            continue;
+        }
+
+        int e = 0;
+        while ( e < otherCount && other[e] != c )
+            ++e;
+        if ( e == otherCount )
+        {
+            other[otherCount] = c;
+            otherMasks[otherCount++] = 0;
+        }
+        otherMasks[e] |= Word( 1 ) << i;
+    }
+
+    const Word last = Word( 1 ) << ( m - 1 );
+    Word VP = m == WORD_BITS ? ~Word( 0 ) : ( last << 1 ) - 1;
+    Word VN = 0;
+    Word D0 = 0;
+    Word PM = 0;
+    int score = m;
+
+    for ( int j = 0; j < n; ++j )
+    {
+        Word PMprev = PM;
+        Word D0prev = D0;
+
+        ushort c = text[j].unicode();
+        if ( c < 256 )
+        {
+            PM = latin1[c];
+        }
+        else
+        {
+            PM = 0;
+            for ( int e = 0; e < otherCount; ++e )
+                if ( other[e] == c )
+                    PM = otherMasks[e];
+        }
+
+        Word X = PM | VN;
+        D0 = ( ( VP + ( X & VP ) ) ^ VP ) | X;
+
+        if ( j >= TRANSPOSE_FIRST_COLUMN )
+            D0 |= ( ( ~D0prev & PM ) << 1 ) & PMprev & TRANSPOSE_ROWS;
+
+        Word HP = VN | ~( D0 | VP );
+        Word HN = VP & D0;
+
+        if ( HP & last )
+            ++score;
+        else if ( HN & last )
+            --score;
+
+        // each column can only lower the final score by one
+        if ( score - ( n - 1 - j ) > max )
+            return max + 1;
+
+        HP = ( HP << 1 ) | 1;
+        HN = HN << 1;
+        VP = HN | ~( D0 | HP );
+        VN = HP & D0;
+    }
+
+    return score;
+}
+
+
+/** the same as distanceSingleWord, with carries between the words */
+static int
+distanceMultiWord( const QChar* pattern, int m, const QChar* text, int n, int max )
+{
+    const int words = ( m + WORD_BITS - 1 ) / WORD_BITS;
+    const Word last = Word( 1 ) << ( ( m - 1 ) % WORD_BITS );
+
+    PatternMasks masks( pattern, m, words );
+
+    std::vector<Word> VP( words, ~Word( 0 ) );
+    std::vector<Word> VN( words, 0 );
+    std::vector<Word> D0( words, 0 );
+    const Word* PMprev = 0;
+    int score = m;
+
+    for ( int j = 0; j < n; ++j )
+    {
+        const Word* PM = masks[text[j]];
+
+        Word addCarry = 0;
+        Word trCarry = 0;
+        Word hpCarry = 1;
+        Word hnCarry = 0;
+
+        for ( int w = 0; w < words; ++w )
+        {
+            Word X = PM[w] | VN[w];
+
+            Word addend = X & VP[w];
+            Word sum = VP[w] + addend;
+            Word carryOut = sum < addend;
+            sum += addCarry;
+            carryOut |= sum < addCarry;
+            addCarry = carryOut;
+
+            Word d0 = ( sum ^ VP[w] ) | X;
+
+            if ( j >= TRANSPOSE_FIRST_COLUMN )
+            {
+                Word t = ~D0[w] & PM[w];
+                Word tr = ( ( t << 1 ) | trCarry ) & PMprev[w];
+                if ( w == 0 )
+                    tr &= TRANSPOSE_ROWS;
+                trCarry = t >> ( WORD_BITS - 1 );
+                d0 |= tr;
+            }
+
+            Word HP = VN[w] | ~( d0 | VP[w] );
+            Word HN = VP[w] & d0;
+
+            if ( w == words - 1 )
+            {
+                if ( HP & last )
+                    ++score;
+                else if ( HN & last )
+                    --score;
+            }
+
+            Word HPshifted = ( HP << 1 ) | hpCarry;
+            Word HNshifted = ( HN << 1 ) | hnCarry;
+            hpCarry = HP >> ( WORD_BITS - 1 );
+            hnCarry = HN >> ( WORD_BITS - 1 );
+
+            VP[w] = HNshifted | ~( d0 | HPshifted );
+            VN[w] = HPshifted & d0;
+            D0[w] = d0;
+        }
+
+        if ( score - ( n - 1 - j ) > max )
+            return max + 1;
+
+        PMprev = PM;
+    }
+
+    return score;
+}
+
+
+int
+levenshtein( const QString& source, const QString& target, int max )
+{
+    // the distance is symmetric, so make the shorter one the pattern
+    const QString& pattern = source.length() <= target.length() ? source : target;
+    const QString& text = source.length() <= target.length() ? target : source;
+
+    const int m = pattern.length();
+    const int n = text.length();
+
+    if ( n - m > max )
+        return max + 1;
+
+    if ( m == 0 )
+        return n;
+
+    if ( m <= WORD_BITS )
+        return distanceSingleWord( pattern.constData(), m, text.constData(), n, max );
+
+    return distanceMultiWord( pattern.constData(), m, text.constData(), n, max );
+}
+
+
+// lifted from playdar
+int levenshteinDP(const QString& source, const QString& target)
+{
+  // Step 1
+  const int n = source.length();
+  const int m = target.length();
+  if (n == 0) {
+    return m;
+  }
+  if (m == 0) {
+    return n;
+  }
+  // Good form to declare a TYPEDEF
+  typedef std::vector< std::vector<int> > Tmatrix;
+  Tmatrix matrix(n+1);
+  // Size the vectors in the 2.nd dimension. Unfortunately C++ doesn't
+  // allow for allocation on declaration of 2.nd dimension of vec of vec
+  for (int i = 0; i <= n; i++) {
+    matrix[i].resize(m+1);
+  }
+  // Step 2
+  for (int i = 0; i <= n; i++) {
+    matrix[i][0]=i;
+  }
+  for (int j = 0; j <= m; j++) {
+    matrix[0][j]=j;
+  }
+  // Step 3
+  for (int i = 1; i <= n; i++) {
+    const QChar s_i = source[i-1];
+    // Step 4
+    for (int j = 1; j <= m; j++) {
+      const QChar t_j = target[j-1];
+      // Step 5
+      int cost;
+      if (s_i == t_j) {
+        cost = 0;
+      }
+      else {
+        cost = 1;
+      }
+      // Step 6
+      const int above = matrix[i-1][j];
+      const int left = matrix[i][j-1];
+      const int diag = matrix[i-1][j-1];
+      //int cell = min( above + 1, min(left + 1, diag + cost));
+      int cell = (((left+1)>(diag+cost))?diag+cost:left+1);
+      if(above+1 < cell) cell = above+1;
+      // Step 6A: Cover transposition, in addition to deletion,
+      // insertion and substitution. This step is taken from:
+      // Berghel, Hal ; Roach, David : "An Extension of Ukkonen's
+      // Enhanced Dynamic Programming ASM Algorithm"
+      // (http://www.acm.org/~hlb/publications/asm/asm.html)
+      if (i>2 && j>2) {
+        int trans=matrix[i-2][j-2]+1;
+        if (source[i-2]!=t_j) trans++;
+        if (s_i!=target[j-2]) trans++;
+        if (cell>trans) cell=trans;
+      }
+      matrix[i][j]=cell;
+    }
+  }
+  // Step 7
+  return matrix[n][m];
+}
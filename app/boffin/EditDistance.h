@@ -0,0 +1,41 @@
+/*
+   Copyright 2013 Last.fm Ltd.
+
+   This file is part of the Last.fm Desktop Application Suite.
+
+   lastfm-desktop is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   lastfm-desktop is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with lastfm-desktop.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef EDIT_DISTANCE_H
+#define EDIT_DISTANCE_H
+
+#include <QString>
+#include <climits>
+
+/** Edit distance as playdar computes it: insertions, deletions,
+  * substitutions and swapping two adjacent characters each cost one,
+  * except that a swap involving the first character of either string
+  * costs two.
+  *
+  * Uses Myers' bit-parallel algorithm with Hyyrö's transposition
+  * extension, a 64 bit word at a time, so it is O(n) for strings up to 64
+  * characters.
+  *
+  * @return the distance, or max + 1 as soon as it's clear the distance
+  * is more than max */
+int levenshtein(const QString& source, const QString& target, int max = INT_MAX - 1);
+
+/** the dynamic programming version lifted from playdar, for comparison */
+int levenshteinDP(const QString& source, const QString& target);
+
+#endif
@@ -19,13 +19,421 @@
 
 #include "LocalCollectionScanner.h"
 
+#include <QDataStream>
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutex>
+#include <QRunnable>
+#include <QSet>
+#include <QThread>
+#include <QThreadPool>
+#include <QTimer>
+#include <QUrl>
 #include <QDebug>
 
-using namespace std;
+#include <cstring>
+
+static const quint32 MANIFEST_MAGIC = 0x4d414e31; // "MAN1"
+
+static const int TRACK_BATCH_SIZE = 500;
+static const int TRACK_BATCH_MS = 50;
+
+
+static bool
+isMusic(const QString& suffix)
+{
+    static QSet<QString> suffixes;
+    static QMutex mutex;
+    QMutexLocker locker(&mutex);
+    if (suffixes.isEmpty())
+        suffixes << "mp3" << "ogg" << "flac" << "m4a" << "mp4" << "aac" << "wma" << "wav";
+    return suffixes.contains(suffix.toLower());
+}
+
+
+/** shared by the tasks of one scan() and the scanner, which polls it */
+struct ScanState
+{
+    struct File
+    {
+        QString path;
+        LocalCollectionScanner::ManifestEntry entry;
+        bool changed;
+    };
+
+    struct Directory
+    {
+        QString path;
+        QList<File> files;
+        bool changed;
+    };
+
+    ScanState(const LocalCollectionScanner::Manifest& old, const TagReader* reader, QThreadPool* pool)
+        : old(old)
+        , reader(reader)
+        , pool(pool)
+        , pending(0)
+        , cancelled(0)
+    {}
+
+    // only ever read, so safe to share between the tasks
+    const LocalCollectionScanner::Manifest old;
+    const TagReader* reader;
+    QThreadPool* pool;
+    // the directories we were asked to scan, set before any task starts
+    QStringList roots;
+
+    // directories queued or being scanned
+    QAtomicInt pending;
+    QAtomicInt cancelled;
+
+    QMutex mutex;
+    QList<Directory> done;
+
+    /** false if we've been here before, by another path or round a loop
+      * of links */
+    bool visit(const QString& path)
+    {
+        QString canonical = QFileInfo(path).canonicalFilePath();
+        if (canonical.isEmpty())
+            return false;
+
+        QMutexLocker locker(&mutex);
+        if (visited.contains(canonical))
+            return false;
+        visited.insert(canonical);
+        return true;
+    }
+
+    QSet<QString> visited;
+};
+
+
+/** Scans one directory, and queues a task for each subdirectory */
+class DirectoryScanTask : public QRunnable
+{
+public:
+    DirectoryScanTask(ScanState* state, const QString& path)
+        : m_state(state)
+        , m_path(path)
+    {}
+
+    virtual void run()
+    {
+        if (m_state->cancelled == 0)
+            scan();
+
+        // the results are in before the count can reach zero
+        m_state->pending.deref();
+    }
+
+private:
+    void scan()
+    {
+        ScanState::Directory result;
+        result.path = m_path;
+        result.changed = false;
+
+        QFileInfoList entries = QDir(m_path).entryInfoList(
+                QDir::Dirs | QDir::Files | QDir::NoDotAndDotDot | QDir::Readable,
+                QDir::Name);
+
+        foreach (const QFileInfo& info, entries)
+        {
+            if (info.isDir()) {
+                if (m_state->visit(info.absoluteFilePath())) {
+                    m_state->pending.ref();
+                    m_state->pool->start(new DirectoryScanTask(m_state, info.absoluteFilePath()));
+                }
+                continue;
+            }
+
+            if (!isMusic(info.suffix()))
+                continue;
+
+            ScanState::File file;
+            file.path = info.absoluteFilePath();
+            file.entry.size = info.size();
+            file.entry.mtime = info.lastModified().toTime_t();
+
+            LocalCollectionScanner::Manifest::const_iterator i = m_state->old.constFind(file.path);
+            if (i != m_state->old.constEnd() && i->size == file.entry.size && i->mtime == file.entry.mtime) {
+                file.entry.tags = i->tags;
+                file.changed = false;
+            } else {
+                if (!m_state->reader->read(file.path, file.entry.tags))
+                    continue;
+                file.changed = true;
+                result.changed = true;
+            }
+
+            result.files << file;
+        }
+
+        QMutexLocker locker(&m_state->mutex);
+        m_state->done << result;
+    }
+
+    ScanState* m_state;
+    QString m_path;
+};
+
 
 LocalCollectionScanner::LocalCollectionScanner(QObject* parent)
     : QObject(parent)
+    , m_proc(0)
+    , m_batchTimer(new QTimer(this))
+    , m_quiet(false)
+    , m_recording(false)
+    , m_pool(new QThreadPool(this))
+    , m_progressTimer(new QTimer(this))
+    , m_state(0)
+    , m_changedFiles(0)
+    , m_unchangedFiles(0)
+{
+    // mostly waiting on the disk, so more threads than cores
+    m_pool->setMaxThreadCount(qMax(4, QThread::idealThreadCount() * 2));
+
+    m_progressTimer->setInterval(50);
+    connect(m_progressTimer, SIGNAL(timeout()), SLOT(onScanProgress()));
+
+    m_batchTimer->setSingleShot(true);
+    m_batchTimer->setInterval(TRACK_BATCH_MS);
+    connect(m_batchTimer, SIGNAL(timeout()), SLOT(flushTracks()));
+}
+
+LocalCollectionScanner::~LocalCollectionScanner()
+{
+    if (m_state) {
+        m_state->cancelled = 1;
+        m_pool->waitForDone();
+        delete m_state;
+    }
+}
+
+void
+LocalCollectionScanner::setPlaydarScanner(QDir playdarBinDir, QString collectionDbFilename)
+{
+    m_playdarBinDir = playdarBinDir;
+    m_collectionDbFilename = collectionDbFilename;
+}
+
+void
+LocalCollectionScanner::scan(QStringList directories, QString manifestFilename, TagReader* reader)
+{
+    Q_ASSERT(!m_state);
+
+    m_manifestFilename = manifestFilename;
+    m_newManifest.clear();
+    m_changedFiles = 0;
+    m_unchangedFiles = 0;
+
+    Manifest old = loadManifest(manifestFilename);
+
+    // With nothing to compare against every file is new, and playdar's
+    // scanner would read every file again after us. Let it read them
+    // once, and fill the manifest in from what it reports
+    if (old.isEmpty() && !m_collectionDbFilename.isEmpty()) {
+        m_recording = true;
+        run(m_playdarBinDir, m_collectionDbFilename, directories);
+        return;
+    }
+
+    m_state = new ScanState(old, reader ? reader : &m_defaultReader, m_pool);
+
+    foreach (const QString& d, directories) {
+        QString path = QDir(d).absolutePath();
+        m_state->roots << path;
+    }
+
+    foreach (const QString& path, m_state->roots) {
+        if (!m_state->visit(path))
+            continue;
+        m_state->pending.ref();
+        m_pool->start(new DirectoryScanTask(m_state, path));
+    }
+
+    m_progressTimer->start();
+}
+
+void
+LocalCollectionScanner::onScanProgress()
+{
+    // read before taking the results, as everything a task found is in
+    // before it stops counting as pending
+    bool finished = m_state->pending == 0;
+
+    QList<ScanState::Directory> done;
+    {
+        QMutexLocker locker(&m_state->mutex);
+        done = m_state->done;
+        m_state->done.clear();
+    }
+
+    foreach (const ScanState::Directory& d, done) {
+        flushTracks();
+        emit directory(d.path);
+        foreach (const ScanState::File& f, d.files) {
+            m_newManifest.insert(f.path, f.entry);
+            if (f.changed)
+                ++m_changedFiles;
+            else
+                ++m_unchangedFiles;
+            addTrack(f.path, f.entry.tags);
+        }
+        if (d.changed)
+            m_changedDirectories << d.path;
+    }
+
+    if (finished)
+        scanFinished();
+}
+
+void
+LocalCollectionScanner::scanFinished()
 {
+    m_progressTimer->stop();
+
+    // playdar needs to hear about removed files too, and if their whole
+    // directory has gone it can only find out from the one above
+    for (Manifest::const_iterator i = m_state->old.constBegin(); i != m_state->old.constEnd(); ++i) {
+        if (!m_newManifest.contains(i.key())) {
+            QString dir = QFileInfo(i.key()).absolutePath();
+            while (!QFileInfo(dir).isDir() && !m_state->roots.contains(dir)) {
+                QString parent = QFileInfo(dir).absolutePath();
+                if (parent == dir)
+                    break;
+                dir = parent;
+            }
+            if (QFileInfo(dir).isDir())
+                m_changedDirectories << dir;
+        }
+    }
+
+    delete m_state;
+    m_state = 0;
+
+    qDebug() << "Scanned" << m_changedFiles << "new or changed files and"
+             << m_unchangedFiles << "unchanged files";
+
+    if (!saveManifest(m_manifestFilename, m_newManifest))
+        qWarning() << "Couldn't save the collection manifest to" << m_manifestFilename;
+    m_newManifest.clear();
+
+    QStringList dirs = m_changedDirectories.toList();
+    m_changedDirectories.clear();
+
+    flushTracks();
+
+    if (m_collectionDbFilename.isEmpty() || dirs.isEmpty()) {
+        emit finished();
+        return;
+    }
+
+    // playdar's scanner recurses, so leave out anything inside another
+    qSort(dirs);
+    QStringList roots;
+    foreach (const QString& d, dirs) {
+        if (roots.isEmpty() || !(d + '/').startsWith(roots.last() + '/'))
+            roots << d;
+    }
+
+    m_quiet = true;
+    run(m_playdarBinDir, m_collectionDbFilename, roots);
+}
+
+void
+LocalCollectionScanner::addTrack(const QString& path, const TagReader::Tags& tags)
+{
+    lastfm::Track t;
+    lastfm::MutableTrack mt(t);
+    mt.setArtist(tags.artist);
+    mt.setAlbum(tags.album);
+    mt.setTitle(tags.title);
+    mt.setUrl(QUrl::fromLocalFile(path));
+    addTrack(t);
+}
+
+void
+LocalCollectionScanner::addTrack(const Track& t)
+{
+    m_tracks << t;
+    if (m_tracks.size() >= TRACK_BATCH_SIZE)
+        flushTracks();
+    else if (!m_batchTimer->isActive())
+        m_batchTimer->start();
+}
+
+void
+LocalCollectionScanner::flushTracks()
+{
+    m_batchTimer->stop();
+    if (m_tracks.isEmpty())
+        return;
+
+    QList<Track> batch = m_tracks;
+    m_tracks.clear();
+    emit tracks(batch);
+}
+
+LocalCollectionScanner::Manifest
+LocalCollectionScanner::loadManifest(const QString& filename)
+{
+    Manifest manifest;
+
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly))
+        return manifest;
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_4_4);
+
+    quint32 magic, count;
+    in >> magic >> count;
+    if (magic != MANIFEST_MAGIC) {
+        qWarning() << "Ignoring unrecognised collection manifest" << filename;
+        return manifest;
+    }
+
+    manifest.reserve(count);
+    while (count-- && in.status() == QDataStream::Ok) {
+        QString path;
+        ManifestEntry e;
+        in >> path >> e.size >> e.mtime >> e.tags.artist >> e.tags.album >> e.tags.title;
+        if (in.status() == QDataStream::Ok)
+            manifest.insert(path, e);
+    }
+
+    return manifest;
+}
+
+bool
+LocalCollectionScanner::saveManifest(const QString& filename, const Manifest& manifest)
+{
+    // written aside and renamed over, so a crash leaves the old one
+    QString temp = filename + ".new";
+    QFile file(temp);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_4_4);
+    out << MANIFEST_MAGIC << quint32(manifest.count());
+
+    for (Manifest::const_iterator i = manifest.constBegin(); i != manifest.constEnd(); ++i) {
+        const ManifestEntry& e = i.value();
+        out << i.key() << e.size << e.mtime << e.tags.artist << e.tags.album << e.tags.title;
+    }
+
+    file.close();
+    if (out.status() != QDataStream::Ok || file.error() != QFile::NoError) {
+        QFile::remove(temp);
+        return false;
+    }
+
+    QFile::remove(filename);
+    return QFile::rename(temp, filename);
 }
 
 void 
@@ -46,18 +454,22 @@ LocalCollectionScanner::run(QDir playdarBinDir, QString collectionDbFilename, QS
 void
 LocalCollectionScanner::onReadyReadStandardOutput()
 {
-    QByteArray ba = m_proc->readAllStandardOutput();
-    m_buffer.write(ba.constData(), ba.size());
-    while (true) {
-        string line;
-        getline(m_buffer, line);
-        if (m_buffer.fail()) {
-            // the line is incomplete (for now)
-            m_buffer.clear(); // clears the failbit
-            return;
-        } 
-        LocalCollectionScanner::line(line);
+    m_buffer += m_proc->readAllStandardOutput();
+
+    // parse the complete lines where they lie, and keep the incomplete
+    // one at the end for next time
+    const char* data = m_buffer.constData();
+    const int size = m_buffer.size();
+    int start = 0;
+    while (start < size) {
+        const char* eol = static_cast<const char*>(memchr(data + start, '\n', size - start));
+        if (!eol)
+            break;
+        int end = eol - data;
+        line(data + start, end - start);
+        start = end + 1;
     }
+    m_buffer.remove(0, start);
 }
 
 void
@@ -68,36 +480,109 @@ LocalCollectionScanner::onReadyReadStandardError()
 void  
 LocalCollectionScanner::onFinished(int /*exitCode*/, QProcess::ExitStatus /*exitStatus*/)
 {
-    emit finished();
+    processFinished();
 }
 
 void
 LocalCollectionScanner::onError(QProcess::ProcessError)
 {
+    processFinished();
+}
+
+void
+LocalCollectionScanner::processFinished()
+{
+    flushTracks();
+    m_quiet = false;
+
+    if (m_recording) {
+        m_recording = false;
+        qDebug() << "playdar's scanner found" << m_changedFiles << "files";
+        if (!saveManifest(m_manifestFilename, m_newManifest))
+            qWarning() << "Couldn't save the collection manifest to" << m_manifestFilename;
+        m_newManifest.clear();
+    }
+
     emit finished();
 }
 
 void
-LocalCollectionScanner::line(const string& s)
-{
-    QString line = QString::fromUtf8(s.data(), s.length()).trimmed();
-    QStringList fields = line.split(QChar('\t'), QString::KeepEmptyParts, Qt::CaseInsensitive);
-    if (fields.size()) {
-        if (fields[0] == "DIR:") {
-            if (fields.size() > 1) {
-                emit directory(fields[1]);
-            }
-        } else if (fields[0] == "TRACK:") {
-            if (fields.size() > 4) {
-                lastfm::Track t;
-                lastfm::MutableTrack mt(t);
-                mt.setArtist(fields[1]);
-                mt.setAlbum(fields[2]);
-                mt.setTitle(fields[3]);
-                mt.setUrl(fields[4]);
-                emit track(t);
-            }
+LocalCollectionScanner::record(const QString& location, const Track& t)
+{
+    QString path = location.startsWith("file:")
+            ? QUrl(location).toLocalFile()
+            : QDir::fromNativeSeparators(location);
+    QFileInfo info(path);
+    if (!info.isFile())
+        return;
+
+    ManifestEntry e;
+    e.size = info.size();
+    e.mtime = info.lastModified().toTime_t();
+    e.tags.artist = t.artist();
+    e.tags.album = t.album();
+    e.tags.title = t.title();
+
+    // the same form DirectoryScanTask finds it by
+    m_newManifest.insert(info.absoluteFilePath(), e);
+    ++m_changedFiles;
+}
+
+static inline bool
+isSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' || c == '\f';
+}
+
+/** "DIR:\t<dir>" or "TRACK:\t<artist>\t<album>\t<title>\t<url>" */
+void
+LocalCollectionScanner::line(const char* data, int length)
+{
+    if (m_quiet)
+        return;
+
+    while (length && isSpace(data[length - 1]))
+        --length;
+    while (length && isSpace(*data)) {
+        ++data;
+        --length;
+    }
+
+    // only the first five fields are ever used
+    enum { MAX_FIELDS = 5 };
+    const char* fields[MAX_FIELDS];
+    int lengths[MAX_FIELDS];
+    int count = 0;
+
+    const char* end = data + length;
+    for (const char* p = data; count < MAX_FIELDS; ++count) {
+        const char* tab = static_cast<const char*>(memchr(p, '\t', end - p));
+        fields[count] = p;
+        lengths[count] = (tab ? tab : end) - p;
+        if (!tab)
+            break;
+        p = tab + 1;
+    }
+    if (count < MAX_FIELDS)
+        ++count;
+
+    if (lengths[0] == 4 && qstrncmp(fields[0], "DIR:", 4) == 0) {
+        if (count > 1) {
+            flushTracks();
+            emit directory(QString::fromUtf8(fields[1], lengths[1]));
+        }
+    } else if (lengths[0] == 6 && qstrncmp(fields[0], "TRACK:", 6) == 0) {
+        if (count > 4) {
+            lastfm::Track t;
+            lastfm::MutableTrack mt(t);
+            mt.setArtist(QString::fromUtf8(fields[1], lengths[1]));
+            mt.setAlbum(QString::fromUtf8(fields[2], lengths[2]));
+            mt.setTitle(QString::fromUtf8(fields[3], lengths[3]));
+            mt.setUrl(QString::fromUtf8(fields[4], lengths[4]));
+            addTrack(t);
+
+            if (m_recording)
+                record(QString::fromUtf8(fields[4], lengths[4]), t);
         }
     }
 }
-
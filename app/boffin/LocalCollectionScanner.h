@@ -20,23 +20,64 @@
 #ifndef LOCAL_COLLECTION_SCANNER_H
 #define LOCAL_COLLECTION_SCANNER_H
 
-#include <sstream>
 #include <QDir>
+#include <QByteArray>
+#include <QHash>
+#include <QSet>
 #include <QProcess>
 #include <QStringList>
 #include <types/Track.h>
+#include "TagReader.h"
 
+class QThreadPool;
+class QTimer;
+struct ScanState;
 
+
+/** Finds the music in some directories, either by running playdar's
+  * scanner, or in-process with scan().
+  *
+  * scan() walks the directories on a thread pool and remembers the size
+  * and modification time of every file it finds in a manifest, so the
+  * next scan only reads the tags of files that are new or changed. Files
+  * that haven't changed are still reported, from the manifest. Links are
+  * followed, but no directory is scanned twice.
+  *
+  * Tracks are reported in batches of up to 500, or whatever has arrived
+  * within 50ms, so big collections don't flood the event loop. A batch is
+  * always delivered before the next directory() signal. */
 class LocalCollectionScanner : public QObject
 {
     Q_OBJECT;
 
 public:
     LocalCollectionScanner(QObject* parent);
+    ~LocalCollectionScanner();
+
+    /** runs playdar's scanner over everything in directories */
     void run(QDir playdarBinDir, QString collectionDbFilename, QStringList directories);
 
+    /** scans in-process, keeping the manifest in manifestFilename. reader
+      * defaults to a SimpleTagReader, and isn't owned by us.
+      *
+      * If setPlaydarScanner() was called, the directories that had new or
+      * changed files are then handed to playdar's scanner so its
+      * collection stays up to date; finished() is emitted after that.
+      * Those files get read twice, once by each, so when there is no
+      * manifest yet playdar's scanner does the whole first scan on its own
+      * and the manifest is built from what it reports. */
+    void scan(QStringList directories, QString manifestFilename, TagReader* reader = 0);
+
+    /** see scan() */
+    void setPlaydarScanner(QDir playdarBinDir, QString collectionDbFilename);
+
+    /** how many files the last scan() read the tags of, and how many came
+      * from the manifest */
+    int changedFiles() const { return m_changedFiles; }
+    int unchangedFiles() const { return m_unchangedFiles; }
+
 signals:
-    void track(Track);
+    void tracks(QList<Track>);
     void directory(QString);
     void finished();
 
@@ -45,14 +86,56 @@ private slots:
     void onReadyReadStandardError();
     void onFinished(int, QProcess::ExitStatus);
     void onError(QProcess::ProcessError);
+    void onScanProgress();
+    void flushTracks();
 
 private:
-    void line(const std::string& line);
+    struct ManifestEntry
+    {
+        qint64 size;
+        uint mtime;
+        TagReader::Tags tags;
+    };
+    typedef QHash<QString, ManifestEntry> Manifest;
+
+    friend class DirectoryScanTask;
+    friend struct ScanState;
+
+    void line(const char* data, int length);
+    void addTrack(const Track& t);
+    void addTrack(const QString& path, const TagReader::Tags& tags);
+    void scanFinished();
+    void processFinished();
+    void record(const QString& location, const Track& t);
+
+    static Manifest loadManifest(const QString& filename);
+    static bool saveManifest(const QString& filename, const Manifest& manifest);
 
     QProcess* m_proc;
     QString m_collectionDbFilename;
     QDir m_playdarBinDir;
-    std::stringstream m_buffer;
+    QByteArray m_buffer;
+
+    QList<Track> m_tracks;
+    QTimer* m_batchTimer;
+
+    // output from playdar's scanner is ignored when it only runs to
+    // update its collection after scan()
+    bool m_quiet;
+
+    // a first scan() leaves the reading to playdar's scanner, and builds
+    // the manifest from its output
+    bool m_recording;
+
+    QThreadPool* m_pool;
+    QTimer* m_progressTimer;
+    ScanState* m_state;
+    SimpleTagReader m_defaultReader;
+    QString m_manifestFilename;
+    Manifest m_newManifest;
+    QSet<QString> m_changedDirectories;
+    int m_changedFiles;
+    int m_unchangedFiles;
 };
 
 #endif
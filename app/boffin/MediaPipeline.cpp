@@ -34,10 +34,18 @@ MediaPipeline::MediaPipeline( Phonon::AudioOutput* ao, QObject* parent )
              , m_source( 0 )
              , m_errorRecover( false )
              , m_phonon_sucks( false )
+             , m_skipping( false )
+             , m_skipStart( 0 )
+             , m_changing( false )
+             , m_expectedEnd( 0 )
+             , m_skipLatency( -1 )
+             , m_trackChangeLatency( -1 )
 {
+    m_clock.start();
+
     mo = new Phonon::MediaObject;
     connect( mo, SIGNAL(stateChanged( Phonon::State, Phonon::State )), SLOT(onPhononStateChanged( Phonon::State, Phonon::State )) );
-    connect( mo, SIGNAL(aboutToFinish()), SLOT(enqueue()) ); // fires just before track finishes
+    connect( mo, SIGNAL(aboutToFinish()), SLOT(onAboutToFinish()) ); // fires just before track finishes
     connect( mo, SIGNAL(currentSourceChanged( Phonon::MediaSource )), SLOT(onPhononSourceChanged( Phonon::MediaSource )) ); 
     Phonon::createPath( mo, ao );
 }
@@ -92,7 +100,12 @@ void
 MediaPipeline::skip()
 {    
     using namespace Phonon;
-        
+
+    m_skipping = true;
+    m_skipStart = m_clock.elapsed();
+    m_changing = false;
+
+    // normally the look-ahead means the next track is already queued
     enqueue();
         
     QList<MediaSource> q = mo->queue();
@@ -114,6 +127,8 @@ MediaPipeline::stop()
     qDebug() << mo->state();
     
     m_tracks.clear();
+    m_skipping = false;
+    m_changing = false;
     
     if (mo->state() != Phonon::StoppedState)
     {
@@ -186,6 +201,13 @@ MediaPipeline::onPhononStateChanged( Phonon::State newstate, Phonon::State oldst
             break;
             
         case PlayingState:
+            if (m_skipping) {
+                m_skipping = false;
+                m_skipLatency = int( m_clock.elapsed() - m_skipStart );
+                qDebug() << "skip took" << m_skipLatency << "ms";
+                emit skipMeasured( m_skipLatency );
+            }
+
             if (oldstate == PausedState)
                 emit resumed();
             else
@@ -201,10 +223,28 @@ MediaPipeline::onPhononStateChanged( Phonon::State newstate, Phonon::State oldst
 void
 MediaPipeline::onPhononSourceChanged( const Phonon::MediaSource& source )
 {
+    if (m_changing)
+    {
+        m_changing = false;
+        m_trackChangeLatency = int( qMax( qint64( 0 ), m_clock.elapsed() - m_expectedEnd ) );
+        qDebug() << "track change gap" << m_trackChangeLatency << "ms";
+        emit trackChangeMeasured( m_trackChangeLatency );
+    }
+
     emit started( m_tracks.value( source.url() ) );
 }
 
 
+void
+MediaPipeline::onAboutToFinish()
+{
+    // the gap is however late the next source starts after this one ends
+    m_changing = true;
+    m_expectedEnd = m_clock.elapsed() + mo->remainingTime();
+    enqueue();
+}
+
+
 void
 MediaPipeline::enqueue()
 {    
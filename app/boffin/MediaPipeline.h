@@ -22,6 +22,13 @@
 #include <lastfm/ws.h>
 #include <QPointer>
 #include <QObject>
+#if QT_VERSION >= 0x040700
+#include <QElapsedTimer>
+typedef QElapsedTimer MediaPipelineClock;
+#else
+#include <QTime>
+typedef QTime MediaPipelineClock;
+#endif
 #include <phonon/phononnamespace.h>
 
 
@@ -46,6 +53,12 @@ public:
 
     void play( class TrackSource* );
 
+    /** milliseconds from skip() until the next track was playing, and the
+      * gap between the end of one track and the start of the next, for
+      * the last skip and track change, -1 before there was one */
+    int skipLatency() const { return m_skipLatency; }
+    int trackChangeLatency() const { return m_trackChangeLatency; }
+
 public slots:
     void setPaused( bool );
     void stop();
@@ -58,10 +71,14 @@ signals:
     void stopped();
     void error( const QString& );
 
+    void skipMeasured( int ms );
+    void trackChangeMeasured( int ms );
+
 private slots:
     void onPhononSourceChanged( const Phonon::MediaSource& );
     void onPhononStateChanged( Phonon::State, Phonon::State );
     void onSourceError( lastfm::ws::Error );
+    void onAboutToFinish();
     void enqueue();
 
 private:
@@ -73,4 +90,12 @@ private:
 
     bool m_errorRecover;
     bool m_phonon_sucks;
+
+    MediaPipelineClock m_clock; // QTime wraps at midnight
+    bool m_skipping;
+    qint64 m_skipStart;
+    bool m_changing;
+    qint64 m_expectedEnd;
+    int m_skipLatency;
+    int m_trackChangeLatency;
 };
@@ -25,8 +25,21 @@
 
 PlaydarTagCloudModel::PlaydarTagCloudModel(PlaydarConnection* playdar)
 :m_playdar(playdar)
+,m_rowCount( 0 )
+,m_firstChanged( -1 )
+,m_lastChanged( -1 )
+,m_maxTrackCount( 0 )
+,m_maxWeight( 0 )
+,m_flushedMaxWeight( 0 )
+,m_maxLogCount( FLT_MIN )
+,m_minLogCount( FLT_MAX )
 ,m_loadingTimer( 0 )
 {
+    // new tags are shown in batches rather than one row at a time
+    m_flushTimer = new QTimer( this );
+    m_flushTimer->setSingleShot( true );
+    m_flushTimer->setInterval( 100 );
+    connect( m_flushTimer, SIGNAL(timeout()), SLOT(flush()) );
 }
 
 PlaydarTagCloudModel::~PlaydarTagCloudModel()
@@ -37,10 +50,16 @@ void
 PlaydarTagCloudModel::startGetTags(const QString& rql)
 {
     m_hosts.clear();
-    m_tagListBuffer.clear();
     m_tagList.clear();
+    m_rows.clear();
+    m_counts.clear();
+    m_rowCount = 0;
+    m_firstChanged = m_lastChanged = -1;
+    m_flushTimer->stop();
+    reset();
 
     m_maxWeight = 0;
+    m_flushedMaxWeight = 0;
     m_maxLogCount = FLT_MIN;
     m_minLogCount = FLT_MAX;
     m_maxTrackCount = 0;
@@ -69,25 +88,40 @@ PlaydarTagCloudModel::onTag(BoffinTagItem tag)
     if (!m_hostFilter.contains(tag.m_host)) {
         m_hosts.insert(tag.m_host);
 
-		if( int i = m_tagListBuffer.indexOf( tag ) >= 0 )
+        QHash< QString, int >::const_iterator row = m_rows.constFind( tag.m_name );
+		if( row != m_rows.constEnd() )
 		{
     		// merge into existing tag
-			m_tagListBuffer[ i ].m_weight += tag.m_weight;
-            m_tagListBuffer[ i ].m_count += tag.m_count;
-			m_tagListBuffer[ i ].m_logCount = log( (float) m_tagListBuffer[i].m_count );
-			m_maxWeight = qMax( m_tagListBuffer[i].m_weight, m_maxWeight);
-			m_maxLogCount = qMax( m_tagListBuffer[i].m_logCount, m_maxLogCount);
+            BoffinTagItem& existing = m_tagList[ *row ];
+
+            if( --m_counts[ existing.m_count ] == 0 )
+                m_counts.remove( existing.m_count );
+
+			existing.m_weight += tag.m_weight;
+            existing.m_count += tag.m_count;
+			existing.m_logCount = log( (float) existing.m_count );
+			m_maxWeight = qMax( existing.m_weight, m_maxWeight);
+            m_counts[ existing.m_count ]++;
+
+            // rows the views haven't seen yet go out with the insert
+            if( *row < m_rowCount )
+            {
+                m_firstChanged = m_firstChanged == -1 ? *row : qMin( m_firstChanged, *row );
+                m_lastChanged = qMax( m_lastChanged, *row );
+            }
         }
         else
         {
             // new tag
 		    tag.m_logCount = log( (float) tag.m_count );
-		    m_tagListBuffer << tag;
-		    m_maxTrackCount = qMax( tag.m_count, m_maxTrackCount );
+            m_rows.insert( tag.m_name, m_tagList.size() );
+		    m_tagList << tag;
 		    m_maxWeight = qMax( tag.m_weight, m_maxWeight );
-		    m_maxLogCount = qMax( m_maxLogCount, tag.m_logCount );
-		    m_minLogCount = qMin( m_minLogCount, tag.m_logCount );
+            m_counts[ tag.m_count ]++;
         }
+
+        if( !m_flushTimer->isActive() )
+            m_flushTimer->start();
 	}
 
     // fire onFetchedTags after 1 second of idle-ness
@@ -101,19 +135,85 @@ PlaydarTagCloudModel::onTag(BoffinTagItem tag)
 
 }
 
+// let the views know about the tags that have arrived since last time
+void
+PlaydarTagCloudModel::flush()
+{
+    m_flushTimer->stop();
+
+    // counts only ever go up, but the smallest one can still change when
+    // that tag is merged into
+    float minLogCount = FLT_MAX;
+    float maxLogCount = FLT_MIN;
+    int maxTrackCount = 0;
+    if( !m_counts.isEmpty() )
+    {
+        minLogCount = log( (float) m_counts.constBegin().key() );
+        maxTrackCount = ( m_counts.constEnd() - 1 ).key();
+        maxLogCount = log( (float) maxTrackCount );
+    }
+
+    // every row's weight is relative to these
+    if( minLogCount != m_minLogCount || maxLogCount != m_maxLogCount || m_maxWeight != m_flushedMaxWeight )
+    {
+        m_firstChanged = 0;
+        m_lastChanged = m_rowCount - 1;
+    }
+
+    m_minLogCount = minLogCount;
+    m_maxLogCount = maxLogCount;
+    m_maxTrackCount = maxTrackCount;
+    m_flushedMaxWeight = m_maxWeight;
+
+    if( m_firstChanged != -1 && m_lastChanged >= m_firstChanged )
+        emit dataChanged( index( m_firstChanged, 0 ), index( m_lastChanged, 0 ) );
+    m_firstChanged = m_lastChanged = -1;
+
+    if( m_tagList.size() > m_rowCount )
+    {
+        beginInsertRows( QModelIndex(), m_rowCount, m_tagList.size() - 1 );
+        m_rowCount = m_tagList.size();
+        endInsertRows();
+    }
+}
+
 void
 PlaydarTagCloudModel::onFetchedTags()
 {
 	m_loadingTimer->deleteLater();
 	m_loadingTimer = 0;
-//	beginInsertRows( QModelIndex(), m_tagList.size(), m_tagListBuffer.size() );
-		m_tagList = m_tagListBuffer;
-		qSort( m_tagList.begin(), m_tagList.end(), qGreater<BoffinTagItem >() );
-//	endInsertRows();
-    reset();
+
+    flush();
+    sortRows();
 	emit fetchedTags();
 }
 
+// biggest tags first
+void
+PlaydarTagCloudModel::sortRows()
+{
+    emit layoutAboutToBeChanged();
+
+    qStableSort( m_tagList.begin(), m_tagList.end(), qGreater<BoffinTagItem >() );
+
+    QHash< int, int > moved;   // old row -> new row
+    for( int i = 0; i < m_tagList.size(); ++i )
+    {
+        int& row = m_rows[ m_tagList[i].m_name ];
+        if( row != i )
+            moved.insert( row, i );
+        row = i;
+    }
+
+    QModelIndexList from = persistentIndexList();
+    QModelIndexList to;
+    foreach( const QModelIndex& i, from )
+        to << index( moved.value( i.row(), i.row() ), i.column() );
+    changePersistentIndexList( from, to );
+
+    emit layoutChanged();
+}
+
 void
 PlaydarTagCloudModel::onTagError()
 {
@@ -123,7 +223,7 @@ PlaydarTagCloudModel::onTagError()
 QVariant
 PlaydarTagCloudModel::data( const QModelIndex& index, int role ) const
 {
-	if( index.row() >= m_tagList.count() )
+	if( index.row() >= m_rowCount )
 		return QVariant();
 
     QList< BoffinTagItem >::const_iterator i = m_tagList.constBegin();
@@ -159,7 +259,7 @@ PlaydarTagCloudModel::data( const QModelIndex& index, int role ) const
 QModelIndex
 PlaydarTagCloudModel::index( int row, int column, const QModelIndex& parent /*= QModelIndex()*/) const
 {
-    return parent.isValid() || row > m_tagList.count() ?
+    return parent.isValid() || row > m_rowCount ?
         QModelIndex() :
         createIndex( row, column );
 }
@@ -167,7 +267,8 @@ PlaydarTagCloudModel::index( int row, int column, const QModelIndex& parent /*=
 QModelIndex
 PlaydarTagCloudModel::indexOf( const BoffinTagItem& tag )
 {
-	return createIndex( m_tagList.indexOf( tag ), 0 );
+    int row = m_rows.value( tag.m_name, -1 );
+	return row >= 0 && row < m_rowCount ? createIndex( row, 0 ) : QModelIndex();
 }
 
 //virtual
@@ -184,7 +285,7 @@ PlaydarTagCloudModel::rowCount( const QModelIndex& p ) const
     if( p.isValid())
         return 0;
 
-    return m_tagList.count();
+    return m_rowCount;
 }
 
 //virtual
@@ -27,11 +27,18 @@
 #include <QAbstractTableModel>
 #include <QSet>
 #include <QMap>
+#include <QHash>
 #include <QList>
 #include <QMultiMap>
 
 class PlaydarConnection;
 
+/** Tags from every playdar host, merged by name.
+  *
+  * Rows are added as tags arrive, a few at a time, and are sorted by track
+  * count once the tags stop coming. Whenever the range of counts or the
+  * largest weight changes, every row's weight changes with it, so
+  * dataChanged is emitted for all of them. */
 class PlaydarTagCloudModel : public QAbstractTableModel
 {
     Q_OBJECT
@@ -66,15 +73,26 @@ private slots:
     void onTag(BoffinTagItem tag);
     void onTagError();
     void onFetchedTags();
+    void flush();
 
 private:
+    void sortRows();
+
     PlaydarConnection* m_playdar;
 
     QSet<QString> m_hostFilter;     // hosts to filter from this tag cloud
     QSet<QString> m_hosts;          // hosts contributing to this tag cloud
 
-    QList< BoffinTagItem > m_tagListBuffer;
+    // the rows, only the first m_rowCount of which views know about yet
     QList< BoffinTagItem > m_tagList;
+    QHash< QString, int > m_rows;   // tag name -> row
+    int m_rowCount;
+
+    // rows merged into since the last flush
+    int m_firstChanged;
+    int m_lastChanged;
+
+    QMap< int, int > m_counts;      // track count -> number of tags with it
 
     BoffinTagItem m_tag;    // the last tag provided via onTags
 
@@ -83,11 +101,13 @@ private:
     int m_totalDuration;
 
     float m_maxWeight;
+    float m_flushedMaxWeight;       // m_maxWeight as the views last saw it
     float m_maxLogCount;
     float m_minLogCount;
 //    float m_minLogWeight, m_maxLogWeight;
 
     class QTimer* m_loadingTimer;
+    class QTimer* m_flushTimer;
 };
 
 #endif
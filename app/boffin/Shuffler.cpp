@@ -17,119 +17,62 @@
    You should have received a copy of the GNU General Public License
    along with lastfm-desktop.  If not, see <http://www.gnu.org/licenses/>.
 */
+#include <algorithm>
+#include <QSet>
+#include "EditDistance.h"
 #include "Shuffler.h"
 
 
 ////////////////////////////////////////////////////////////////////////
 
 
-// lifted from playdar
-int levenshtein(const QString& source, const QString& target) 
+// tolerances:
+static const float tol_art = 1.5;
+static const float tol_trk = 1.5;
+
+// names less than this many chars aren't dismissed based on % edit-dist:
+static const int grace_len = 6;
+
+
+// the largest edit distance from a name this long that doesn't fail
+// normalisedLevenshtein outright, so levenshtein can give up early
+static int
+maxDistance(int length, float tolerance)
 {
-  // Step 1
-  const int n = source.length();
-  const int m = target.length();
-  if (n == 0) {
-    return m;
-  }
-  if (m == 0) {
-    return n;
-  }
-  // Good form to declare a TYPEDEF
-  typedef std::vector< std::vector<int> > Tmatrix; 
-  Tmatrix matrix(n+1);
-  // Size the vectors in the 2.nd dimension. Unfortunately C++ doesn't
-  // allow for allocation on declaration of 2.nd dimension of vec of vec
-  for (int i = 0; i <= n; i++) {
-    matrix[i].resize(m+1);
-  }
-  // Step 2
-  for (int i = 0; i <= n; i++) {
-    matrix[i][0]=i;
-  }
-  for (int j = 0; j <= m; j++) {
-    matrix[0][j]=j;
-  }
-  // Step 3
-  for (int i = 1; i <= n; i++) {
-    const QChar s_i = source[i-1];
-    // Step 4
-    for (int j = 1; j <= m; j++) {
-      const QChar t_j = target[j-1];
-      // Step 5
-      int cost;
-      if (s_i == t_j) {
-        cost = 0;
-      }
-      else {
-        cost = 1;
-      }
-      // Step 6
-      const int above = matrix[i-1][j];
-      const int left = matrix[i][j-1];
-      const int diag = matrix[i-1][j-1];
-      //int cell = min( above + 1, min(left + 1, diag + cost));
-      int cell = (((left+1)>(diag+cost))?diag+cost:left+1);
-      if(above+1 < cell) cell = above+1;
-      // Step 6A: Cover transposition, in addition to deletion,
-      // insertion and substitution. This step is taken from:
-      // Berghel, Hal ; Roach, David : "An Extension of Ukkonen's 
-      // Enhanced Dynamic Programming ASM Algorithm"
-      // (http://www.acm.org/~hlb/publications/asm/asm.html)
-      if (i>2 && j>2) {
-        int trans=matrix[i-2][j-2]+1;
-        if (source[i-2]!=t_j) trans++;
-        if (s_i!=target[j-2]) trans++;
-        if (cell>trans) cell=trans;
-      }
-      matrix[i][j]=cell;
-    }
-  }
-  // Step 7
-  return matrix[n][m];
+    int max = length - 1;
+    if (length > grace_len && length / tolerance < max)
+        max = (int) (length / tolerance);
+    return max;
 }
 
 
+// o_ names are from the query, the others from the candidate result,
+// all simplified and lower case already
 float
-normalisedLevenshtein(const BoffinPlayableItem& a, const BoffinPlayableItem& b)
+normalisedLevenshtein(const QString& o_art, const QString& o_trk, const QString& art, const QString& trk)
 {
     // logic lifted from playdar's Resolver::calculate_score
     // not yet comparing album titles
 
-    using namespace boost;
-    // original names from the query:
-    QString o_art = a.artist().simplified().toLower();
-    QString o_trk = a.track().simplified().toLower();
-
-    // names from candidate result:
-    QString art = b.artist().simplified().toLower();
-    QString trk = b.track().simplified().toLower();
-
     // short-circuit for exact match
     if (o_art == art && o_trk == trk) return 1.0;
 
     // the real deal, with edit distances:
-    int trked = levenshtein(trk, o_trk);
-    int arted = levenshtein(art, o_art);
+    int arted = levenshtein(art, o_art, maxDistance(o_art.length(), tol_art));
 
-    // tolerances:
-    const float tol_art = 1.5;
-    const float tol_trk = 1.5;
-    
-    // names less than this many chars aren't dismissed based on % edit-dist:
-    const int grace_len = 6; 
-    
     // if % edit distance is greater than tolerance, fail them outright:
     if( o_art.length() > grace_len && arted > o_art.length()/tol_art )
         return 0.0;
 
-    if( o_trk.length() > grace_len && trked > o_trk.length()/tol_trk )
-        return 0.0;
-
     // if edit distance longer than original name, fail them outright:
     if( arted >= o_art.length() )
         return 0.0;
 
+    int trked = levenshtein(trk, o_trk, maxDistance(o_trk.length(), tol_trk));
+
+    if( o_trk.length() > grace_len && trked > o_trk.length()/tol_trk )
+        return 0.0;
+
     if( trked >= o_trk.length() )
         return 0.0;
     
@@ -140,30 +83,97 @@ normalisedLevenshtein(const BoffinPlayableItem& a, const BoffinPlayableItem& b)
 }
 
 
+// Whether normalisedLevenshtein could score a song by artist a above 0.5
+// against one by artist b, looking only at the artists. Mirrors its checks.
+static bool
+artistsCouldMatch(const QString& a, const QString& b)
+{
+    QString o_art = a.simplified().toLower();
+    QString art = b.simplified().toLower();
+
+    if (o_art == art) return true;
+
+    int arted = levenshtein(art, o_art, maxDistance(o_art.length(), tol_art));
+
+    if( o_art.length() > grace_len && arted > o_art.length()/tol_art )
+        return false;
+
+    return arted < o_art.length();
+}
+
+
+static QString
+artistKey(const BoffinPlayableItem& item)
+{
+    return item.artist().toLower();
+}
+
+
 ////////////////////////////////////////////////////////////////////////
 
 
 Shuffler::Shuffler(QObject* parent /* = 0 */)
 : QObject(parent)
+, m_takenCount(0)
+, m_reweightAll(false)
 , m_artistHistorySize(4)        // to mix up the artists
+, m_songHistoryBase(0)
 , m_songHistorySize(100)        // to suppress dup songs
 {
 }
 
+//static
+Shuffler::SongKey
+Shuffler::songKey(const BoffinPlayableItem& item)
+{
+    SongKey key;
+    key.artist = item.artist().simplified().toLower();
+    key.track = item.track().simplified().toLower();
+    return key;
+}
+
 BoffinPlayableItem 
 Shuffler::sampleOne()
 {
     BoffinPlayableItem result = sample();
     if (result.isValid()) {
+        QSet<QString> affected;
+        affected << artistKey(result);
+
         // artist memory
         m_artistHistory.push_back(result.artist());
         while (m_artistHistory.size() > m_artistHistorySize) {
-            m_artistHistory.pop_front();
+            affected << m_artistHistory.takeFirst().toLower();
         }
         // track memory
+        QStringList similar = similarArtists(artistKey(result));
+        SongKey resultKey = songKey(result);
+        matchNewSong(resultKey, similar);
         m_songHistory.push_back(result);
+        m_songHistoryKeys.push_back(resultKey);
+
+        bool shifted = false;
         while (m_songHistory.size() > m_songHistorySize) {
-            m_songHistory.pop_front();
+            affected += similarArtists(artistKey(m_songHistory.takeFirst())).toSet();
+            m_songHistoryKeys.pop_front();
+            m_songHistoryBase++;
+            shifted = true;
+        }
+
+        // pushdownSong depends on where in the history a match is, so once
+        // the history is full every match moves along one
+        if (shifted) {
+            foreach(const BoffinPlayableItem& historicItem, m_songHistory) {
+                affected += similarArtists(artistKey(historicItem)).toSet();
+            }
+        } else {
+            affected += similar.toSet();
+        }
+
+        if (!m_reweightAll) {
+            foreach(const QString& key, affected) {
+                reweightArtist(key);
+            }
         }
     }
     return result;
@@ -172,6 +182,7 @@ Shuffler::sampleOne()
 const Shuffler::ItemList& 
 Shuffler::items()
 {
+    compact();
     return m_items;
 }
 
@@ -179,12 +190,27 @@ void
 Shuffler::setArtistHistorySize(unsigned size)
 {
     m_artistHistorySize = size;
+    m_reweightAll = true;
+}
+
+void 
+Shuffler::setSongHistorySize(unsigned size)
+{
+    m_songHistorySize = size;
+    m_reweightAll = true;
 }
 
 void
 Shuffler::clear()
 {
     m_items.clear();
+    m_keys.clear();
+    m_matches.clear();
+    m_taken.clear();
+    m_takenCount = 0;
+    m_artistSlots.clear();
+    m_similarArtists.clear();
+    m_sampler.clear();
 }
 
 void
@@ -192,11 +218,11 @@ Shuffler::clearHistory()
 {
     m_artistHistory.clear();
     m_songHistory.clear();
-}
-
-bool orderByWorkingWeightDesc(const BoffinPlayableItem& a, const BoffinPlayableItem& b)
-{
-    return a.workingweight() > b.workingweight();
+    m_songHistoryKeys.clear();
+    for (int i = 0; i < m_matches.size(); i++) {
+        m_matches[i].clear();
+    }
+    m_reweightAll = true;
 }
 
 // pull out a single item
@@ -205,61 +231,230 @@ Shuffler::sample()
 {
     BoffinPlayableItem result;
 
-    if (m_items.size()) {
-        ItemList::iterator begin = m_items.begin();
-        ItemList::iterator end = m_items.end();
-        ItemList::iterator it;
+    if (m_reweightAll) {
+        reweightAll();
+    }
 
-        // reweight:
-        float totalWeight = 0;
-        for (it = begin; it != end; it++) {
-            it->workingweight() = it->weight() * pushdown(*it);
-            totalWeight += it->workingweight();
-        }
-        // normalise weights, sum to 1
-        for (it = begin; it != end; it++) {
-            it->workingweight() /= totalWeight;
+    if (m_takenCount < m_items.size()) {
+        size_t slot = m_sampler.sample();
+
+        // nothing has any weight, just take the first one
+        if (slot == m_sampler.size()) {
+            slot = std::find(m_taken.begin(), m_taken.end(), false) - m_taken.begin();
         }
-        qSort(begin, end, orderByWorkingWeightDesc);
 
-        ItemList::iterator sample = m_sampler.singleSample(begin, end, true);
-        result = *sample;
-        m_items.removeAt(sample - begin);
+        result = m_items[slot];
+        m_taken[slot] = true;
+        m_takenCount++;
+        m_sampler.set(slot, 0);
+
+        // don't let picked items pile up
+        if (m_takenCount > 1024 && m_takenCount > m_items.size() / 2) {
+            compact();
+        }
     }
 
     return result;
 }
 
 
+void
+Shuffler::reweight(int slot)
+{
+    if (m_taken[slot])
+        return;
+
+    BoffinPlayableItem& item = m_items[slot];
+    item.workingweight() = item.weight() * pushdown(slot);
+    m_sampler.set(slot, item.workingweight());
+}
+
+
+void
+Shuffler::reweightArtist(const QString& key)
+{
+    QHash<QString, QList<int> >::const_iterator it = m_artistSlots.find(key);
+    if (it == m_artistSlots.end())
+        return;
+
+    foreach(int slot, *it) {
+        reweight(slot);
+    }
+}
+
+
+void
+Shuffler::reweightAll()
+{
+    std::vector<double> weights(m_items.size(), 0);
+    for (int i = 0; i < m_items.size(); i++) {
+        if (!m_taken[i]) {
+            BoffinPlayableItem& item = m_items[i];
+            item.workingweight() = item.weight() * pushdown(i);
+            weights[i] = item.workingweight();
+        }
+    }
+    m_sampler.assign(weights);
+    m_reweightAll = false;
+}
+
+
+const QStringList&
+Shuffler::similarArtists(const QString& historyArtistKey)
+{
+    QHash<QString, QStringList>::iterator it = m_similarArtists.find(historyArtistKey);
+    if (it == m_similarArtists.end()) {
+        QStringList similar;
+        foreach(const QString& key, m_artistSlots.keys()) {
+            if (artistsCouldMatch(key, historyArtistKey)) {
+                similar << key;
+            }
+        }
+        it = m_similarArtists.insert(historyArtistKey, similar);
+    }
+    return *it;
+}
+
+
+// drop the items we've already picked
+void
+Shuffler::compact()
+{
+    if (m_takenCount == 0)
+        return;
+
+    ItemList items;
+    items.reserve(m_items.size() - m_takenCount);
+    QVector<SongKey> keys;
+    keys.reserve(m_items.size() - m_takenCount);
+    QVector<QList<Match> > matches;
+    matches.reserve(m_items.size() - m_takenCount);
+    std::vector<double> weights;
+    weights.reserve(m_items.size() - m_takenCount);
+
+    // keep the keys, m_similarArtists already knows about them
+    for (QHash<QString, QList<int> >::iterator it = m_artistSlots.begin(); it != m_artistSlots.end(); ++it) {
+        it->clear();
+    }
+
+    for (int i = 0; i < m_items.size(); i++) {
+        if (!m_taken[i]) {
+            m_artistSlots[artistKey(m_items[i])] << items.size();
+            items << m_items[i];
+            keys << m_keys[i];
+            matches << m_matches[i];
+            weights.push_back(m_sampler.weight(i));
+        }
+    }
+
+    m_items = items;
+    m_keys = keys;
+    m_matches = matches;
+    m_taken.assign(m_items.size(), false);
+    m_takenCount = 0;
+    m_sampler.assign(weights);
+}
+
+
 float 
-Shuffler::pushdown(const BoffinPlayableItem& item)
+Shuffler::pushdown(int slot)
 {
-    return pushdownSong(item) * 
-        (m_artistHistory.contains(item.artist(), Qt::CaseInsensitive) ? 0.00001 : 1.0);
+    return pushdownSong(slot) * 
+        (m_artistHistory.contains(m_items[slot].artist(), Qt::CaseInsensitive) ? 0.00001 : 1.0);
 }
 
 
 float
-Shuffler::pushdownSong(const BoffinPlayableItem& item)
+Shuffler::pushdownSong(int slot)
 {
-    int i = 1;
+    QList<Match>& matches = m_matches[slot];
     float result = 1.0;
-    foreach(const BoffinPlayableItem& historicItem, m_songHistory) {
-        float nl = normalisedLevenshtein(item,  historicItem);
+
+    QList<Match>::iterator it = matches.begin();
+    while (it != matches.end()) {
+        // forget songs that have left the history
+        if (it->seq < m_songHistoryBase) {
+            it = matches.erase(it);
+            continue;
+        }
+        int i = it->seq - m_songHistoryBase + 1;
+        float score = 0.1 * (it->similarity * i / (float) m_songHistorySize);
+        if (score < result) {
+            result = score;
+        }
+        ++it;
+    }
+    return result;
+}
+
+
+// compare a new item against everything in the song history
+void
+Shuffler::matchHistory(int slot)
+{
+    const SongKey& key = m_keys[slot];
+    quint64 seq = m_songHistoryBase;
+
+    foreach(const SongKey& historic, m_songHistoryKeys) {
+        float nl = normalisedLevenshtein(key.artist, key.track, historic.artist, historic.track);
         // levenshtein values not very reliable when less than 0.5
         if (nl > 0.5) {
-            float score = 0.1 * (nl * i / (float) m_songHistorySize);
-            if (score < result) {
-                result = score;
+            Match match = { seq, nl };
+            m_matches[slot] << match;
+        }
+        seq++;
+    }
+}
+
+
+// compare a song about to join the history against the items by the
+// artists that could match it
+void
+Shuffler::matchNewSong(const SongKey& key, const QStringList& artistKeys)
+{
+    quint64 seq = m_songHistoryBase + m_songHistoryKeys.size();
+
+    foreach(const QString& artist, artistKeys) {
+        foreach(int slot, m_artistSlots.value(artist)) {
+            if (m_taken[slot])
+                continue;
+
+            const SongKey& candidate = m_keys[slot];
+            float nl = normalisedLevenshtein(candidate.artist, candidate.track, key.artist, key.track);
+            if (nl > 0.5) {
+                Match match = { seq, nl };
+                m_matches[slot] << match;
             }
         }
-        i++;
     }
-    return result;
 }
 
 void 
 Shuffler::receivePlayableItem(BoffinPlayableItem item)
 {
+    QString key = artistKey(item);
+    QHash<QString, QList<int> >::iterator artistSlots = m_artistSlots.find(key);
+
+    if (artistSlots == m_artistSlots.end()) {
+        // a new artist might be similar to ones in the song history
+        for (QHash<QString, QStringList>::iterator it = m_similarArtists.begin(); it != m_similarArtists.end(); ++it) {
+            if (artistsCouldMatch(key, it.key())) {
+                it->append(key);
+            }
+        }
+        artistSlots = m_artistSlots.insert(key, QList<int>());
+    }
+
+    int slot = m_items.size();
+    artistSlots->append(slot);
+    m_keys.push_back(songKey(item));
+    m_matches.push_back(QList<Match>());
+    m_taken.push_back(false);
+    matchHistory(slot);
+
+    // pushdown() reads the item from its slot, and setting the weight on
+    // our copy would detach it from the one in m_items
     m_items.push_back(item);
-}
\ No newline at end of file
+    m_items[slot].workingweight() = item.weight() * pushdown(slot);
+    m_sampler.push_back(m_items[slot].workingweight());
+}
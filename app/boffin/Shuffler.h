@@ -21,13 +21,29 @@
 #define SHUFFLER_H
 
 #include <QStringList>
+#include <QHash>
+#include <QVector>
+#include <vector>
 #include "playdar/BoffinPlayableItem.h"
-#include "sample/SampleFromDistribution.h"
-
-
+#include "sample/FenwickSampler.h"
+
+
+/** Picks items at random, weighted by their weight() but pushed down if
+  * their artist was played recently or they sound like a recent song.
+  *
+  * Weights are kept in a FenwickSampler. After each pick only the items
+  * whose pushdown could have changed are reweighted: those by the artists
+  * entering or leaving the artist history, and those by artists similar
+  * enough to a song in the song history that normalisedLevenshtein could
+  * rate them above 0.5.
+  *
+  * Each item's similarity to the songs in the history is worked out once,
+  * when either of them arrives, and remembered until the song leaves the
+  * history. */
 class Shuffler : public QObject
 {
     Q_OBJECT
+    friend class BenchShuffler;
 
 public:
     typedef QList<BoffinPlayableItem> ItemList;
@@ -44,40 +60,57 @@ public slots:
     void receivePlayableItem(BoffinPlayableItem item);
 
 private:
-    BoffinPlayableItem sample();
-    void result(const BoffinPlayableItem& item);
-    float pushdown(const BoffinPlayableItem& item);
-    float pushdownSong(const BoffinPlayableItem& item);
-
-    struct AccessPolicy
+    // artist and track, simplified and lower case
+    struct SongKey
     {
-        float operator()(const QList<BoffinPlayableItem>::const_iterator& el) const
-        { 
-            return el->workingweight(); 
-        }
+        QString artist;
+        QString track;
     };
 
-    struct CopyPolicy
+    // an item that sounds like the song with this sequence number in the
+    // song history
+    struct Match
     {
-       template <typename IT>
-       BoffinPlayableItem operator()(IT& it) const
-       {
-          return *it;
-       }
-
-       template <typename IT>
-       const BoffinPlayableItem operator()(const IT& it) const
-       {
-          return *it;
-       }
+        quint64 seq;
+        float similarity;
     };
 
+    static SongKey songKey(const BoffinPlayableItem& item);
+
+    BoffinPlayableItem sample();
+    void result(const BoffinPlayableItem& item);
+    float pushdown(int slot);
+    float pushdownSong(int slot);
+    void matchHistory(int slot);
+    void matchNewSong(const SongKey& key, const QStringList& artistKeys);
+
+    void reweight(int slot);
+    void reweightArtist(const QString& artistKey);
+    void reweightAll();
+    const QStringList& similarArtists(const QString& historyArtistKey);
+    void compact();
+
+    // items() in the order they arrived, including the ones already picked
+    // until compact() drops them
+    ItemList m_items;
+    QVector<SongKey> m_keys;
+    QVector<QList<Match> > m_matches;
+    std::vector<bool> m_taken;
+    int m_takenCount;
+
+    // slots in m_items for each artist, keyed on artist().toLower()
+    QHash<QString, QList<int> > m_artistSlots;
+    // the artist keys that could match songs by a history artist
+    QHash<QString, QStringList> m_similarArtists;
+
+    fm::last::algo::FenwickSampler m_sampler;
+    bool m_reweightAll;
 
-    fm::last::algo::ListBasedSampler<AccessPolicy, CopyPolicy> m_sampler;
-    ItemList m_items;               // items arrive here
     QStringList m_artistHistory;
     int m_artistHistorySize;
     QList<BoffinPlayableItem> m_songHistory;
+    QList<SongKey> m_songHistoryKeys;
+    quint64 m_songHistoryBase;      // sequence number of m_songHistory.first()
     int m_songHistorySize;
 };
 
@@ -17,7 +17,6 @@
    You should have received a copy of the GNU General Public License
    along with lastfm-desktop.  If not, see <http://www.gnu.org/licenses/>.
 */
-#include <boost/timer.hpp>
 #include "TagCloudView.h"
 #include "PlaydarTagCloudModel.h"
 #include <QApplication>
@@ -25,10 +24,18 @@
 #include <QPainter>
 #include <QScrollBar>
 #include <limits.h>
+#include <algorithm>
 
 
 TagCloudView::TagCloudView( QWidget* parent )
              : QAbstractItemView( parent )
+             , m_maxRise( 0 )
+             , m_baseline( 0 )
+             , m_leftMargin( 0 )
+             , m_x( 0 )
+             , m_tallest( 0 )
+             , m_sizesDirty( true )
+             , m_dirty( true )
              , m_fetched( false )
 {
     QFont f = font();
@@ -62,13 +69,21 @@ TagCloudView::setSelection( const QRect& rect, QItemSelectionModel::SelectionFla
     if (state() == DragSelectingState)
         return;
 
-    QRect r = rect.translated( 0, verticalScrollBar()->value());
-    RectsConstIt it = m_rects.constBegin();
-    for (int c = 0; it != m_rects.constEnd(); it++, c++) {
-        if (it->intersects(r)) {
-            selectionModel()->select(model()->index(c, 0), f);
+    QVector<int> rows = rowsIn( rect.translated( 0, verticalScrollBar()->value()) );
+    if (rows.isEmpty())
+        return;
+
+    // select runs of rows in one go rather than a row at a time
+    QItemSelection selection;
+    int first = rows[0];
+    for (int i = 1; i <= rows.size(); ++i) {
+        if (i == rows.size() || rows[i] != rows[i - 1] + 1) {
+            selection.select( model()->index( first, 0 ), model()->index( rows[i - 1], 0 ) );
+            if (i < rows.size())
+                first = rows[i];
         }
     }
+    selectionModel()->select( selection, f );
 }
 
 
@@ -89,7 +104,8 @@ TagCloudView::paintEvent( QPaintEvent* e )
     QPainter p( viewport() );
     p.setClipRect( e->rect());
 
-    if (!m_fetched) {
+    // tags are shown as they arrive
+    if (!m_fetched && model()->rowCount() == 0) {
 		p.drawText( viewport()->rect(), Qt::AlignCenter, "Fetching tags.." + m_loadedTag );
 		return;
     }
@@ -99,34 +115,31 @@ TagCloudView::paintEvent( QPaintEvent* e )
         m_dirty = false;
     }
 
-    if (m_rects.isEmpty()) {
+    if (m_rects.isEmpty() && m_fetched) {
         p.drawText( viewport()->rect(), Qt::AlignCenter,  "No tags have been found!" );
         return;
     }
 
     QStyleOptionViewItem opt = viewOptions();
-    RectsConstIt it = m_rects.constBegin();
-    for (int c = 0; it != m_rects.constEnd(); it++, c++) 
+    foreach (int c, rowsIn( e->rect().translated( 0, verticalScrollBar()->value() ) ))
     {
-        opt.rect = it->translated( 0, -verticalScrollBar()->value() );
+        opt.rect = m_rects[c].translated( 0, -verticalScrollBar()->value() );
 
-        if( e->rect().intersects( opt.rect )) {
-            const QModelIndex& index = model()->index(c, 0);
+        const QModelIndex& index = model()->index(c, 0);
 
-            opt.state = QStyle::State_None;
-            if( m_hoverIndex == index && isEnabled() )
-                opt.state = qApp->mouseButtons() == Qt::NoButton
-                        ? QStyle::State_MouseOver
-                        : QStyle::State_Active;
+        opt.state = QStyle::State_None;
+        if( m_hoverIndex == index && isEnabled() )
+            opt.state = qApp->mouseButtons() == Qt::NoButton
+                    ? QStyle::State_MouseOver
+                    : QStyle::State_Active;
 
-            if( selectionModel()->isSelected( index ) )
-                opt.state |= QStyle::State_Selected;
+        if( selectionModel()->isSelected( index ) )
+            opt.state |= QStyle::State_Selected;
 
-            if( isEnabled() )
-                opt.state |= QStyle::State_Enabled;
+        if( isEnabled() )
+            opt.state |= QStyle::State_Enabled;
 
-            itemDelegate()->paint( &p, opt, index );
-        }
+        itemDelegate()->paint( &p, opt, index );
     }
 }
 
@@ -142,9 +155,20 @@ void
 TagCloudView::setModel(QAbstractItemModel *model)
 {
     QAbstractItemView::setModel(model);
-    connect(model, SIGNAL(rowsInserted(QModelIndex, int, int)), SLOT(onRows(QModelIndex, int, int)));
+    connect(model, SIGNAL(rowsInserted(QModelIndex, int, int)), SLOT(onRowsInserted(QModelIndex, int, int)));
     connect(model, SIGNAL(rowsRemoved(QModelIndex, int, int)), SLOT(onRows(QModelIndex, int, int)));
-//    connect(model, SIGNAL(modelReset()), SLOT(onModelReset()));
+    // weights and order change while the tags are loading
+    connect(model, SIGNAL(dataChanged(QModelIndex, QModelIndex)), SLOT(onDataChanged(QModelIndex, QModelIndex)));
+    connect(model, SIGNAL(layoutChanged()), SLOT(onModelChanged()));
+    connect(model, SIGNAL(modelReset()), SLOT(onModelChanged()));
+}
+
+void
+TagCloudView::onModelChanged()
+{
+    m_sizesDirty = true;
+    m_dirty = true;
+    viewport()->update();
 }
 
 void
@@ -158,85 +182,195 @@ TagCloudView::onRows(const QModelIndex & parent, int start, int end)
     // which means our rects are now rubbish 
     // (they will get refreshed in paintEvent()
     //  ...which will happen eventually)
+    m_sizesDirty = true;
+    m_dirty = true;
+    viewport()->update();
+}
+
+void
+TagCloudView::onRowsInserted(const QModelIndex & parent, int start, int end)
+{
+    // rows added to the end carry on from where the layout got to,
+    // anything else moves the rows after it along
+    if (m_sizesDirty || start == 0 || start != m_sizes.size()) {
+        onRows( parent, start, end );
+        return;
+    }
+
+    rectcalc( start, end );
+    if (!m_dirty) {
+        layout( start );
+        updateScrollRange();
+    }
+    viewport()->update();
+}
+
+void
+TagCloudView::onDataChanged(const QModelIndex & topLeft, const QModelIndex & bottomRight)
+{
+    // the first row sets the baseline for all the others
+    if (!topLeft.isValid() || !bottomRight.isValid() || topLeft.row() == 0
+        || bottomRight.row() >= m_sizes.size()) {
+        m_sizesDirty = true;
+    } else if (!m_sizesDirty) {
+        rectcalc( topLeft.row(), bottomRight.row() );
+    }
+
     m_dirty = true;
     viewport()->update();
 }
 
 int gBaseline, gLeftMargin; //filthy but easiest
 void
-TagCloudView::rectcalc()
+TagCloudView::rectcalc( int first, int last )
 {
     QStyleOptionViewItem const opt = viewOptions();
-    int baseline = 0;
 
-    m_rects.clear();
-    for (int j = 0; j < model()->rowCount(); ++j)
+    m_sizes.resize( model()->rowCount() );
+    for (int j = first; j <= last; ++j)
     {
         QModelIndex const i = model()->index( j, 0 );
         QRect r( QPoint(), itemDelegate()->sizeHint( opt, i ) );
-        if (baseline == 0)
-            baseline = gBaseline;
+        if (j == 0)
+            m_baseline = gBaseline;
 
-        r.moveTo( gLeftMargin, baseline-gBaseline );
+        r.moveTo( gLeftMargin, m_baseline-gBaseline );
 
-        m_rects.insert(j, r);
+        m_sizes[j] = r;
     }
 }
 
 
+static const int VIEWPORT_MARGIN = 10;
+
+// lay the rows from first onwards out left to right, in model order
 void
-TagCloudView::updateGeometries()
+TagCloudView::layout( int first )
 {
-    boost::timer bt;
-
-    if (!model())
-        return;
-
-    rectcalc(); //TODO only needs to be done once when data is set!
-
-    const int VIEWPORT_MARGIN = 10;
-
-    int y = VIEWPORT_MARGIN;
-    int left_margin = 0; // the left baseline to align text against
+    const int count = m_sizes.size();
+    m_rects.resize( count );
+
+    if (first == 0) {
+        m_lines.clear();
+        m_maxBottom.clear();
+        m_maxRise = 0;
+        m_leftMargin = 0; // the left baseline to align text against
+    }
 
-    // iterate in model-order to lay the tags out left to right
-    for (int j = 0; j < model()->rowCount(); ++j)
+    for (int j = first; j < count; ++j)
     {
-        QRect r = m_rects[j];
-        if (left_margin == 0) 
-            left_margin = r.x();
-
-        // do new row
-        int x = VIEWPORT_MARGIN + (left_margin - r.x());
-        int tallest = 0;
-        for (; j < model()->rowCount(); ++j)
-        {
-            QRect r = m_rects[j];
-            r.moveTo( x, y + r.y() );
-
-            x += r.width();
-            if (tallest != 0 //need at least one thing per row
-                && x > viewport()->width() - VIEWPORT_MARGIN) 
-            { 
-                --j; break; 
-            }
-
-            m_rects[j] = r;
-            tallest = qMax( tallest, r.bottom() - y );
+        QRect r = m_sizes[j];
+        if (m_leftMargin == 0)
+            m_leftMargin = r.x();
+
+        // need at least one thing per row
+        bool newLine = m_lines.isEmpty()
+                    || (m_tallest != 0 && m_x + r.width() > viewport()->width() - VIEWPORT_MARGIN);
+
+        if (newLine) {
+            Line line;
+            line.first = j;
+            line.y = m_lines.isEmpty() ? VIEWPORT_MARGIN : m_lines.last().y + m_tallest;
+            line.top = INT_MAX;
+            line.bottom = INT_MIN;
+            m_lines << line;
+            m_maxBottom << (m_maxBottom.isEmpty() ? INT_MIN : m_maxBottom.last());
+
+            m_x = VIEWPORT_MARGIN + (m_leftMargin - r.x());
+            m_tallest = 0;
         }
 
-        y += tallest;
+        Line& line = m_lines.last();
+        r.moveTo( m_x, line.y + r.y() );
+        m_x += r.width();
+        m_rects[j] = r;
+
+        m_tallest = qMax( m_tallest, r.bottom() - line.y );
+        line.top = qMin( line.top, r.top() );
+        line.bottom = qMax( line.bottom, r.bottom() );
+        m_maxBottom.last() = qMax( m_maxBottom.last(), r.bottom() );
+        m_maxRise = qMax( m_maxRise, line.y - r.top() );
     }
+}
+
+
+void
+TagCloudView::updateScrollRange()
+{
+    int y = m_lines.isEmpty() ? VIEWPORT_MARGIN : m_lines.last().y + m_tallest;
 
     verticalScrollBar()->setRange( 0, y + VIEWPORT_MARGIN - viewport()->height() );
     verticalScrollBar()->setPageStep( viewport()->height() );
     verticalScrollBar()->setSingleStep( 20 /*TODO*/ );
+}
+
+
+void
+TagCloudView::updateGeometries()
+{
+    if (!model())
+        return;
+
+    // the sizes only change with the model, not the viewport
+    if (m_sizesDirty || m_sizes.size() != model()->rowCount()) {
+        m_sizes.clear();
+        rectcalc( 0, model()->rowCount() - 1 );
+        m_sizesDirty = false;
+    }
+
+    layout( 0 );
+    updateScrollRange();
 
     viewport()->update();
     QAbstractItemView::updateGeometries();
 }
 
 
+static bool
+rightOf( const QRect& r, int x )
+{
+    return r.right() < x;
+}
+
+
+// the rows whose rects intersect rect, in row order
+QVector<int>
+TagCloudView::rowsIn( const QRect& rect ) const
+{
+    QVector<int> rows;
+
+    // the first line that reaches down as far as rect
+    int i = std::lower_bound( m_maxBottom.constBegin(), m_maxBottom.constEnd(), rect.top() ) - m_maxBottom.constBegin();
+
+    for (; i < m_lines.size(); ++i)
+    {
+        const Line& line = m_lines[i];
+
+        // the lines below can't poke up into rect either
+        if (line.y - m_maxRise > rect.bottom())
+            break;
+
+        if (line.top > rect.bottom() || line.bottom < rect.top())
+            continue;
+
+        // rects on a line are in x order and don't overlap
+        QVector<QRect>::const_iterator begin = m_rects.constBegin() + line.first;
+        QVector<QRect>::const_iterator end = i + 1 < m_lines.size()
+                ? m_rects.constBegin() + m_lines[i + 1].first
+                : m_rects.constEnd();
+
+        for (QVector<QRect>::const_iterator it = std::lower_bound( begin, end, rect.left(), rightOf );
+             it != end && it->left() <= rect.right(); ++it)
+        {
+            if (it->intersects( rect ))
+                rows << it - m_rects.constBegin();
+        }
+    }
+
+    return rows;
+}
+
+
 void
 TagCloudView::selectAll()
 {
@@ -250,19 +384,17 @@ QModelIndex
 TagCloudView::indexAt( const QPoint& pos ) const
 {
     QPoint p = pos + QPoint( 0, verticalScrollBar()->value());
-    RectsConstIt it = m_rects.constBegin();
-    for (int c = 0; it != m_rects.constEnd(); it++, c++) {
-        if( it->contains( p )) {
-            return model()->index(c, 0);
-        }
-    }
-    return QModelIndex();
+    QVector<int> rows = rowsIn( QRect( p, QSize( 1, 1 ) ) );
+    return rows.isEmpty() ? QModelIndex() : model()->index( rows.first(), 0 );
 }
 
 
 QRect
 TagCloudView::visualRect( const QModelIndex& i ) const
 {
+    if (!i.isValid() || i.row() >= m_rects.size())
+        return QRect();
+
     return m_rects[ i.row() ].translated( 0, -verticalScrollBar()->value());
 }
 
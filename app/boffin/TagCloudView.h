@@ -21,6 +21,7 @@
 #define TAG_CLOUD_VIEW_H
 
 #include <QAbstractItemView>
+#include <QVector>
 #include "playdar/BoffinTagRequest.h"
 
 class TagCloudView : public QAbstractItemView
@@ -43,11 +44,17 @@ public slots:
 protected slots:
     virtual void updateGeometries();
     void onRows(const QModelIndex & parent, int start, int end);
+    void onRowsInserted(const QModelIndex & parent, int start, int end);
+    void onDataChanged(const QModelIndex & topLeft, const QModelIndex & bottomRight);
+    void onModelChanged();
     void onFetchedTags();
     void onTag( const BoffinTagItem& );
 
 protected:
-    void rectcalc();
+    void rectcalc( int first, int last );
+    void layout( int first );
+    void updateScrollRange();
+    QVector<int> rowsIn( const QRect& ) const;
 
     virtual void paintEvent( QPaintEvent* );
     virtual bool isIndexHidden( const QModelIndex& ) const{ return false; }
@@ -61,11 +68,30 @@ protected:
     virtual bool viewportEvent(QEvent *event);
 
     QModelIndex m_hoverIndex;
-    QHash<int, QRect> m_rects;      // row -> QRect
-
-    typedef QHash<int, QRect>::const_iterator RectsConstIt;
-    typedef QHash<int, QRect>::iterator RectsIt;
-
+    QVector<QRect> m_sizes;         // row -> size and offset from the baseline
+    QVector<QRect> m_rects;         // row -> where it is laid out
+
+    // The tags are laid out left to right in rows, in model order, so each
+    // line holds a run of rows sorted by x. Hit tests binary search the
+    // lines and then the rows within one.
+    struct Line
+    {
+        int first;                  // first row on the line
+        int y;                      // where the line starts
+        int top;                    // highest and lowest of its rects
+        int bottom;
+    };
+    QVector<Line> m_lines;
+    QVector<int> m_maxBottom;       // the lowest bottom of lines 0..i
+    int m_maxRise;                  // how far any rect pokes above its line
+
+    // where layout() got up to, so appended rows can carry on from there
+    int m_baseline;
+    int m_leftMargin;
+    int m_x;
+    int m_tallest;
+
+    bool m_sizesDirty;
     bool m_dirty;
     bool m_fetched;
     QString m_loadedTag;
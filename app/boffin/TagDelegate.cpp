@@ -107,10 +107,28 @@ QSize
 TagDelegate::sizeHint( const QStyleOptionViewItem& option, const QModelIndex& index ) const
 {
     const float weight = index.data( PlaydarTagCloudModel::LinearWeightRole ).value<float>();
-    QFontMetrics fm( font( option.font, weight ) );
+    const QFont f = font( option.font, weight );
+
+    if( option.font != m_metricsFont )
+    {
+        m_metricsFont = option.font;
+        m_textSizes.clear();
+        m_ascents.clear();
+    }
+
+    const int fontKey = f.pointSize() * 128 + f.weight();
+    const QPair<QString, int> key( index.data().toString(), fontKey );
+
+    QHash< QPair<QString, int>, QSize >::const_iterator size = m_textSizes.constFind( key );
+    if( size == m_textSizes.constEnd() )
+    {
+        QFontMetrics fm( f );
+        size = m_textSizes.insert( key, fm.size( Qt::TextSingleLine, key.first ) );
+        m_ascents.insert( fontKey, fm.ascent() );
+    }
 
     const QSize margin = margins( weight );
-    gBaseline = margin.height()/2 + fm.ascent();
+    gBaseline = margin.height()/2 + m_ascents.value( fontKey );
     gLeftMargin = margin.width()/2;
-    return fm.size( Qt::TextSingleLine, index.data().toString() ) + margin;
+    return *size + margin;
 }
@@ -21,6 +21,10 @@
 #define TAG_DELEGATE_H
 
 #include <QAbstractItemDelegate>
+#include <QFont>
+#include <QHash>
+#include <QPair>
+#include <QSize>
 
 class TagDelegate: public QAbstractItemDelegate
 {
@@ -28,7 +32,14 @@ public:
     TagDelegate( QObject* parent = 0 );
     virtual void paint( QPainter* painter, const QStyleOptionViewItem& option, const QModelIndex& index ) const;
     virtual QSize sizeHint( const QStyleOptionViewItem& option, const QModelIndex& index ) const;
-    
+
+private:
+    // Measuring text is the expensive part of sizeHint, and tags only come
+    // in a few dozen font sizes, so the metrics are remembered per
+    // (text, point size and weight) for the current view font
+    mutable QFont m_metricsFont;
+    mutable QHash< QPair<QString, int>, QSize > m_textSizes;
+    mutable QHash< int, int > m_ascents;
 };
 
 #endif //TAG_DELEGATE_H
@@ -0,0 +1,82 @@
+/*
+   Copyright 2013 Last.fm Ltd.
+
+   This file is part of the Last.fm Desktop Application Suite.
+
+   lastfm-desktop is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   lastfm-desktop is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with lastfm-desktop.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "TagReader.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QRegExp>
+
+static const int ID3V1_SIZE = 128;
+
+
+/** the fields are padded with nuls or spaces */
+static QString
+id3v1Field( const char* data, int length )
+{
+    int n = 0;
+    while ( n < length && data[n] )
+        ++n;
+    return QString::fromLatin1( data, n ).trimmed();
+}
+
+
+bool
+SimpleTagReader::read( const QString& path, Tags& tags ) const
+{
+    QFile file( path );
+    if ( !file.open( QIODevice::ReadOnly ) )
+        return false;
+
+    guessFromPath( path, tags );
+
+    if ( file.size() < ID3V1_SIZE || !file.seek( file.size() - ID3V1_SIZE ) )
+        return true;
+
+    QByteArray tail = file.read( ID3V1_SIZE );
+    if ( tail.size() != ID3V1_SIZE || !tail.startsWith( "TAG" ) )
+        return true;
+
+    const char* d = tail.constData();
+    QString title = id3v1Field( d + 3, 30 );
+    QString artist = id3v1Field( d + 33, 30 );
+    QString album = id3v1Field( d + 63, 30 );
+
+    // a half filled in tag still beats the guess for the fields it has
+    if ( title.size() ) tags.title = title;
+    if ( artist.size() ) tags.artist = artist;
+    if ( album.size() ) tags.album = album;
+    return true;
+}
+
+
+void
+SimpleTagReader::guessFromPath( const QString& path, Tags& tags )
+{
+    QFileInfo info( path );
+    QDir dir = info.dir();
+
+    // "01 - Title", "01. Title", "01 Title"
+    QString title = info.completeBaseName();
+    title.remove( QRegExp( "^\\d{1,3}\\s*[-.]?\\s+" ) );
+    tags.title = title;
+
+    tags.album = dir.dirName();
+    tags.artist = dir.cdUp() ? dir.dirName() : QString();
+}
@@ -0,0 +1,56 @@
+/*
+   Copyright 2013 Last.fm Ltd.
+
+   This file is part of the Last.fm Desktop Application Suite.
+
+   lastfm-desktop is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   lastfm-desktop is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with lastfm-desktop.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef TAG_READER_H
+#define TAG_READER_H
+
+#include <QString>
+
+
+/** Reads the artist, album and title of a music file.
+  *
+  * LocalCollectionScanner calls read() from several threads at once, so
+  * implementations must not keep state between calls. */
+class TagReader
+{
+public:
+    struct Tags
+    {
+        QString artist;
+        QString album;
+        QString title;
+    };
+
+    virtual ~TagReader() {}
+
+    /** @return false if the file isn't music we can use */
+    virtual bool read( const QString& path, Tags& tags ) const = 0;
+};
+
+
+/** ID3v1 tags where there are any, otherwise guesses from an
+  * Artist/Album/NN Title.ext layout */
+class SimpleTagReader : public TagReader
+{
+public:
+    virtual bool read( const QString& path, Tags& tags ) const;
+
+    static void guessFromPath( const QString& path, Tags& tags );
+};
+
+#endif
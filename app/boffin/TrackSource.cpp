@@ -19,6 +19,15 @@
 */
 #include "TrackSource.h"
 #include "Shuffler.h"
+#include <QFile>
+#include <QNetworkReply>
+#include <QTimer>
+#include <QDebug>
+#include <lastfm/ws.h>
+
+// enough for the decoder to get going, and for playdar to have found
+// and opened the file
+static const int PRIME_BYTES = 64 * 1024;
 
 static Track toTrack(const BoffinPlayableItem& item)
 {
@@ -36,21 +45,27 @@ static Track toTrack(const BoffinPlayableItem& item)
 TrackSource::TrackSource(Shuffler* shuffler, QObject *parent)
 : QObject(parent)
 , m_shuffler(shuffler)
-, m_maxSize(1)
+, m_maxSize(3)
+, m_nam(0)
+, m_refillQueued(false)
 {
 }
 
 Track
 TrackSource::takeNextTrack()
 {
-    fillBuffer();
+    // nothing was sampled ahead, so it has to happen now
+    if (m_buffer.isEmpty())
+        fillBuffer();
     if (m_buffer.isEmpty()) 
         return Track();
 
-    Track result = toTrack(m_buffer.takeFirst());
-    fillBuffer();
+    BoffinPlayableItem item = m_buffer.takeFirst();
+    m_prepared.remove(QUrl(item.url()));
+
+    scheduleRefill();
     emit changed();
-    return result;
+    return toTrack(item);
 }
 
 void
@@ -58,10 +73,105 @@ TrackSource::fillBuffer()
 {
     while (m_buffer.size() < m_maxSize) {
         BoffinPlayableItem item = m_shuffler->sampleOne();
-        if (item.isValid())
-            m_buffer.append(item);
-        else
+        if (!item.isValid())
             break;
+        if (prepare(item))
+            m_buffer.append(item);
+    }
+}
+
+void
+TrackSource::scheduleRefill()
+{
+    if (!m_refillQueued) {
+        m_refillQueued = true;
+        QTimer::singleShot(0, this, SLOT(refill()));
+    }
+}
+
+void
+TrackSource::refill()
+{
+    m_refillQueued = false;
+
+    int const before = m_buffer.size();
+    fillBuffer();
+    if (m_buffer.size() != before)
+        emit changed();
+}
+
+// returns false if the item can't be played at all
+bool
+TrackSource::prepare(const BoffinPlayableItem& item)
+{
+    QUrl const url(item.url());
+
+    if (url.scheme() == "file") {
+        if (!QFile::exists(url.toLocalFile())) {
+            qDebug() << "missing file skipped:" << url;
+            return false;
+        }
+        m_prepared << url;
+        return true;
+    }
+
+    if (url.scheme() != "http" && url.scheme() != "https")
+        return true;
+
+    // Phonon's backend fetches the url itself and nothing here is cached,
+    // so this is only so that playdar resolves the sid and opens the file
+    // before phonon asks
+    QNetworkRequest request(url);
+    request.setRawHeader("Range", "bytes=0-" + QByteArray::number(PRIME_BYTES - 1));
+
+    QNetworkReply* reply = (m_nam ? m_nam : lastfm::nam())->get(request);
+    reply->setReadBufferSize(PRIME_BYTES);
+    connect(reply, SIGNAL(readyRead()), SLOT(onPrimeReadyRead()));
+    connect(reply, SIGNAL(finished()), SLOT(onPrimeFinished()));
+    m_priming[reply] = url;
+    return true;
+}
+
+void
+TrackSource::onPrimeReadyRead()
+{
+    QNetworkReply* reply = (QNetworkReply*) sender();
+    if (reply->bytesAvailable() < PRIME_BYTES || !m_priming.contains(reply))
+        return;
+
+    // that's all we wanted, playdar may be ignoring the range
+    m_prepared << m_priming.take(reply);
+    reply->abort();
+}
+
+void
+TrackSource::onPrimeFinished()
+{
+    QNetworkReply* reply = (QNetworkReply*) sender();
+    reply->deleteLater();
+
+    if (!m_priming.contains(reply))
+        return;
+
+    QUrl const url = m_priming.take(reply);
+    if (reply->error() == QNetworkReply::NoError) {
+        m_prepared << url;
+    } else {
+        qDebug() << "unplayable item dropped:" << url << reply->errorString();
+        drop(url);
+    }
+}
+
+void
+TrackSource::drop(const QUrl& url)
+{
+    for (int i = 0; i < m_buffer.size(); ++i) {
+        if (QUrl(m_buffer[i].url()) == url) {
+            m_buffer.removeAt(i);
+            emit changed();
+            scheduleRefill();
+            return;
+        }
     }
 }
 
@@ -71,6 +181,12 @@ TrackSource::peek(unsigned index)
     return (index >= 0 && index < (unsigned) m_buffer.size()) ? m_buffer[index] : BoffinPlayableItem();
 }
 
+bool
+TrackSource::isPrepared(unsigned index)
+{
+    return index < (unsigned) m_buffer.size() && m_prepared.contains(QUrl(m_buffer[index].url()));
+}
+
 int
 TrackSource::size()
 {
@@ -80,12 +196,21 @@ TrackSource::size()
 void
 TrackSource::setSize(unsigned maxSize)
 {
-    m_maxSize = maxSize;
+    m_maxSize = qMax(1u, maxSize);
+    while (m_buffer.size() > m_maxSize)
+        m_prepared.remove(QUrl(m_buffer.takeLast().url()));
 }
 
 void
 TrackSource::clear()
 {
+    // forget them first, aborting calls onPrimeFinished
+    QList<QNetworkReply*> replies = m_priming.keys();
+    m_priming.clear();
+    foreach (QNetworkReply* reply, replies)
+        reply->abort();
+    m_prepared.clear();
+
     if (!m_buffer.isEmpty()) {
         m_buffer.clear();
         emit changed();
@@ -20,15 +20,26 @@
 #ifndef TRACK_SOURCE_H
 #define TRACK_SOURCE_H
 
+#include <QHash>
 #include <QList>
+#include <QSet>
+#include <QUrl>
 #include <types/Track.h>
 #include "playdar/BoffinPlayableItem.h"
 
 class Shuffler;
+class QNetworkAccessManager;
+class QNetworkReply;
 
 // Tracksource samples BoffinPlayableItem objects from the Shuffler, 
 // maintains a small buffer of them (for upcoming-track feature).
 // MediaPipeline then takes Track objects from us.
+//
+// The buffer is the look-ahead: it's topped up from the event loop after
+// each track is taken, and every item in it is resolved and opened in
+// the background, so by the time a track is needed playdar has already
+// found the file and started reading it. Items that turn out not to be
+// playable are dropped.
 class TrackSource
     : public QObject
 {
@@ -43,15 +54,34 @@ public:
     void setSize(unsigned maxSize);
     void clear();
 
+    // true once the item has been opened successfully
+    bool isPrepared(unsigned index);
+
+    // defaults to lastfm::nam()
+    void setNetworkAccessManager(QNetworkAccessManager* nam) { m_nam = nam; }
+
 signals:
     void changed();     // the buffer has changed somehow.
 
+private slots:
+    void refill();
+    void onPrimeReadyRead();
+    void onPrimeFinished();
+
 private:
     void fillBuffer();
+    void scheduleRefill();
+    bool prepare(const BoffinPlayableItem& item);
+    void drop(const QUrl& url);
 
     Shuffler* m_shuffler;
     QList<BoffinPlayableItem> m_buffer;
     int m_maxSize;
+
+    QNetworkAccessManager* m_nam;
+    QHash<QNetworkReply*, QUrl> m_priming;
+    QSet<QUrl> m_prepared;
+    bool m_refillQueued;
 };
 
 #endif
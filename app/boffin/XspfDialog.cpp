@@ -30,6 +30,7 @@
 XspfDialog::XspfDialog(QString path, PlaydarConnection* playdar, QWidget *parent)
 :QDialog(parent)
 ,m_playdar(playdar)
+,m_count(0)
 {
     QLayout* layout = new QHBoxLayout();
     m_treewidget = new QTreeWidget();
@@ -43,30 +44,29 @@ XspfDialog::XspfDialog(QString path, PlaydarConnection* playdar, QWidget *parent
     setSizeGripEnabled(true);
 
     m_reader = new XspfReader(path);
-    connect(m_reader, SIGNAL(xspf(lastfm::Xspf)), SLOT(onXspf(lastfm::Xspf)));
+    m_reader->setParent(this);
+    connect(m_reader, SIGNAL(title(QString)), SLOT(setWindowTitle(QString)));
+    connect(m_reader, SIGNAL(track(Track)), SLOT(onTrack(Track)));
 }
 
+// resolved as each one arrives, rather than after the whole playlist
 void
-XspfDialog::onXspf(const lastfm::Xspf& xspf)
+XspfDialog::onTrack(const Track& t)
 {
-    setWindowTitle(xspf.title());
-    int i = 0;
-    foreach(const lastfm::Track& t, xspf.tracks()) {
-        TrackResolveRequest* req = m_playdar->trackResolve(t.artist(), t.album(), t.title());
+    int const i = m_count++;
+    TrackResolveRequest* req = m_playdar->trackResolve(t.artist(), t.album(), t.title());
 
-        QTreeWidgetItem* item = new QTreeWidgetItem();
-        m_reqmap[req->qid()] = item;
-        item->setData(0, Qt::DisplayRole, QString::number(i));
-        item->setData(1, Qt::DisplayRole, (QString)t.artist());
-        item->setData(2, Qt::DisplayRole, (QString)t.album());
-        item->setData(3, Qt::DisplayRole, (QString)t.title());
-        item->setData(4, Qt::DisplayRole, t.duration());
-        item->setData(5, Qt::DisplayRole, t.url().toString());
-        m_treewidget->addTopLevelItem(item);
+    QTreeWidgetItem* item = new QTreeWidgetItem();
+    m_reqmap[req->qid()] = item;
+    item->setData(0, Qt::DisplayRole, QString::number(i));
+    item->setData(1, Qt::DisplayRole, (QString)t.artist());
+    item->setData(2, Qt::DisplayRole, (QString)t.album());
+    item->setData(3, Qt::DisplayRole, (QString)t.title());
+    item->setData(4, Qt::DisplayRole, t.duration());
+    item->setData(5, Qt::DisplayRole, t.url().toString());
+    m_treewidget->addTopLevelItem(item);
 
-        connect(req, SIGNAL(result(BoffinPlayableItem)), SLOT(onResolveResult(BoffinPlayableItem)));
-        i++;
-    }
+    connect(req, SIGNAL(result(BoffinPlayableItem)), SLOT(onResolveResult(BoffinPlayableItem)));
 }
 
 void
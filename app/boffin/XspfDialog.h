@@ -21,7 +21,7 @@
 
 #include <QDialog>
 #include <QMap>
-#include <lastfm/Xspf>
+#include <types/Track.h>
 
 class QTreeWidget;
 class QTreeWidgetItem;
@@ -37,7 +37,7 @@ public:
     XspfDialog(QString url, PlaydarConnection* playdar, QWidget *parent = 0);
 
 private slots:
-    void onXspf(const lastfm::Xspf& xspf);
+    void onTrack(const Track& t);
     void onResolveResult(const BoffinPlayableItem& item);
 
 private:
@@ -45,6 +45,7 @@ private:
     QTreeWidget* m_treewidget;
     PlaydarConnection* m_playdar;
     QMap<QString, QTreeWidgetItem*> m_reqmap;    // map request qid to index
+    int m_count;
 };
 
 #endif
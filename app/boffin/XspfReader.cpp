@@ -20,36 +20,213 @@
 #include "XspfReader.h"
 #include <QNetworkReply>
 #include <QNetworkRequest>
+#include <QDebug>
 #include <lastfm/NetworkAccessManager>
 
 
  XspfReader::XspfReader(QUrl url)
 : m_url(url)
+, m_reply(0)
+, m_done(false)
+, m_depth(0)
+, m_lfm(false)
+, m_playlistDepth(0)
+, m_inTrackList(false)
+, m_inTrack(false)
+, m_field(NoField)
+, m_fieldDepth(0)
 {
     m_reply = (new lastfm::NetworkAccessManager(this))->get(QNetworkRequest(m_url));
+    connect(m_reply, SIGNAL(readyRead()), SLOT(onReadyRead()));
     connect(m_reply, SIGNAL(finished()), SLOT(onFinished()));
 }
 
+ XspfReader::XspfReader()
+: m_reply(0)
+, m_done(false)
+, m_depth(0)
+, m_lfm(false)
+, m_playlistDepth(0)
+, m_inTrackList(false)
+, m_inTrack(false)
+, m_field(NoField)
+, m_fieldDepth(0)
+{
+}
+
+void
+XspfReader::onReadyRead()
+{
+    addData(m_reply->readAll());
+}
+
 void
 XspfReader::onFinished()
 {
-    QDomDocument xmldoc;
-    xmldoc.setContent(m_reply);
-    QDomElement docElement(xmldoc.documentElement());
-    if (docElement.tagName() == "playlist") {
-        handleXspf(docElement);
-    } else if (docElement.tagName() == "lfm") {
-        handleXspf(docElement.firstChildElement("playlist"));
-    } else {
-        // todo
-    }
+    addData(m_reply->readAll());
+    finish();
     m_reply->deleteLater();
     m_reply = 0;
 }
 
-void 
-XspfReader::handleXspf(const QDomElement& playlistElement)
+void
+XspfReader::addData(const QByteArray& data)
 {
-    Xspf xspf(playlistElement);
-    emit XspfReader::xspf(xspf);
+    if (m_done)
+        return;
+
+    if (data.isEmpty()) {
+        finish();
+        return;
+    }
+
+    m_xml.addData(data);
+    parse();
+}
+
+void
+XspfReader::finish()
+{
+    if (m_done)
+        return;
+
+    m_done = true;
+    if (!m_xml.atEnd() && m_xml.error() == QXmlStreamReader::PrematureEndOfDocumentError)
+        qWarning() << "xspf ended early:" << m_url;
+    emit finished();
+}
+
+void
+XspfReader::parse()
+{
+    while (!m_done) {
+        switch (m_xml.readNext()) {
+            case QXmlStreamReader::StartElement:
+                ++m_depth;
+                startElement();
+                break;
+
+            case QXmlStreamReader::EndElement:
+                endElement();
+                --m_depth;
+                break;
+
+            case QXmlStreamReader::Characters:
+                if (m_field != NoField)
+                    m_text += m_xml.text();
+                break;
+
+            case QXmlStreamReader::EndDocument:
+                finish();
+                return;
+
+            case QXmlStreamReader::Invalid:
+                // which just means wait for more, if it's cut off mid-way
+                if (m_xml.error() != QXmlStreamReader::PrematureEndOfDocumentError) {
+                    qWarning() << "xspf parse error:" << m_xml.errorString();
+                    finish();
+                }
+                return;
+
+            default:
+                break;
+        }
+    }
+}
+
+void
+XspfReader::startElement()
+{
+    QStringRef const name = m_xml.name();
+
+    // markup inside a field's text is just more text
+    if (m_field != NoField)
+        return;
+
+    if (!m_playlistDepth) {
+        if (m_depth == 1 && name == "lfm")
+            m_lfm = true;
+        else if (name == "playlist" && (m_depth == 1 || (m_depth == 2 && m_lfm)))
+            m_playlistDepth = m_depth;
+        return;
+    }
+
+    const int level = m_depth - m_playlistDepth;
+
+    if (level == 1) {
+        if (name == "title")
+            m_field = PlaylistTitle;
+        else if (name == "trackList")
+            m_inTrackList = true;
+    }
+    else if (level == 2 && m_inTrackList && name == "track") {
+        m_inTrack = true;
+        m_location.clear();
+        m_title.clear();
+        m_creator.clear();
+        m_album.clear();
+        m_duration.clear();
+    }
+    else if (level == 3 && m_inTrack) {
+        if (name == "location")
+            m_field = Location;
+        else if (name == "title")
+            m_field = Title;
+        else if (name == "creator")
+            m_field = Creator;
+        else if (name == "album")
+            m_field = Album;
+        else if (name == "duration")
+            m_field = Duration;
+    }
+
+    if (m_field != NoField) {
+        m_fieldDepth = m_depth;
+        m_text.clear();
+    }
+}
+
+void
+XspfReader::endElement()
+{
+    if (!m_playlistDepth)
+        return;
+
+    const int level = m_depth - m_playlistDepth;
+
+    if (m_field != NoField) {
+        if (m_depth != m_fieldDepth)
+            return;
+
+        switch (m_field) {
+            case PlaylistTitle: emit title(m_text.trimmed()); break;
+            // a track may have several, the first is the one to try first
+            case Location: if (m_location.isEmpty()) m_location = m_text.trimmed(); break;
+            case Title: m_title = m_text.trimmed(); break;
+            case Creator: m_creator = m_text.trimmed(); break;
+            case Album: m_album = m_text.trimmed(); break;
+            case Duration: m_duration = m_text.trimmed(); break;
+            default: break;
+        }
+        m_field = NoField;
+    }
+    else if (level == 2 && m_inTrack) {
+        m_inTrack = false;
+
+        Track t;
+        MutableTrack mt(t);
+        mt.setUrl(QUrl(m_location));
+        mt.setTitle(m_title);
+        mt.setArtist(m_creator);
+        mt.setAlbum(m_album);
+        mt.setDuration(m_duration.toInt() / 1000);    // xspf durations are in ms
+        emit track(t);
+    }
+    else if (level == 1 && m_inTrackList) {
+        m_inTrackList = false;
+    }
+    else if (level == 0) {
+        // there's nothing else in the file we want
+        finish();
+    }
 }
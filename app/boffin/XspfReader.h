@@ -20,28 +20,68 @@
 #ifndef XSPF_READER
 #define XSPF_READER
  
-#include <QList>
-#include <lastfm/Xspf>
+#include <QUrl>
+#include <QXmlStreamReader>
+#include <types/Track.h>
 
 
+/** Reads an XSPF playlist, either <playlist> or <lfm><playlist>, as it
+  * downloads. Each track is emitted as soon as its </track> arrives, so a
+  * big playlist can start playing long before the end of it turns up.
+  *
+  * Construct with a url to fetch it, or with nothing and feed it with
+  * addData(). */
 class XspfReader : public QObject
 {
     Q_OBJECT
 
+    enum Field { NoField, PlaylistTitle, Location, Title, Creator, Album, Duration };
+
     QUrl m_url;
     class QNetworkReply *m_reply;
-    QList<Track> m_queue;
+    QXmlStreamReader m_xml;
+    bool m_done;
+
+    // where we are, by element depth
+    int m_depth;
+    bool m_lfm;
+    int m_playlistDepth;
+    bool m_inTrackList;
+    bool m_inTrack;
+    Field m_field;
+    int m_fieldDepth;
+
+    QString m_text;
+    QString m_location;
+    QString m_title;
+    QString m_creator;
+    QString m_album;
+    QString m_duration;
 
-    void handleXspf(const QDomElement& playlistElement);
+    void parse();
+    void startElement();
+    void endElement();
+    void finish();
 
 signals:
-    void xspf(lastfm::Xspf);
+    void title(QString);
+    void track(Track);
+    /** at the end of the playlist, or on error */
+    void finished();
 
 private slots:
+    void onReadyRead();
     void onFinished();
 
 public:
     XspfReader(QUrl);
+    XspfReader();
+
+    /** parses as much as it can, call with an empty array at the end */
+    void addData(const QByteArray&);
+
+    bool hasError() const { return m_xml.hasError() && m_xml.error() != QXmlStreamReader::PrematureEndOfDocumentError; }
+    QString errorString() const { return m_xml.errorString(); }
 };
 
 #endif
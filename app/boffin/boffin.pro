@@ -19,10 +19,12 @@ SOURCES += \
 	XspfReader.cpp \
 	XspfDialog.cpp \
 	TrackSource.cpp \
+	TagReader.cpp \
 	TagDelegate.cpp \
 	TagCloudView.cpp \
 	TagBrowserWidget.cpp \
 	Shuffler.cpp \
+	EditDistance.cpp \
 	ScrobSocket.cpp \
 	ScanProgressWidget.cpp \
 	PlaylistModel.cpp \
@@ -50,6 +52,7 @@ SOURCES += \
 	json_spirit/json_spirit_value.cpp \
 	json_spirit/json_spirit_reader.cpp \
 	HistoryWidget.cpp \
+	comet/CometResult.cpp \
 	comet/CometParser.cpp \
 	App.cpp
     
@@ -58,10 +61,12 @@ HEADERS += \
 	XspfDialog.h \
 	WordleDialog.h \
 	TrackSource.h \
+	TagReader.h \
 	TagDelegate.h \
 	TagCloudView.h \
 	TagBrowserWidget.h \
 	Shuffler.h \
+	EditDistance.h \
 	ScrobSocket.h \
 	ScanProgressWidget.h \
 	sample/SampleFromDistribution.h \
@@ -93,6 +98,7 @@ HEADERS += \
 	json_spirit/json_spirit_reader.h \
 	json_spirit/json_spirit.h \
 	HistoryWidget.h \
+	comet/CometResult.h \
 	comet/CometParser.h \
 	App.h
     
@@ -21,6 +21,14 @@
 
 CometParser::CometParser(QObject *parent)
 : QObject(parent)
+, m_typed(true)
+, m_undecided(false)
+, m_level(NotTyped)
+, m_messageKey(OtherKey)
+, m_resultField(CometResult::Field(0))
+, m_skipDepth(0)
+, m_haveQid(false)
+, m_haveResult(false)
 {
     yajl_parser_config cfg = { 1 /* allow comments */, 0 /* don't check the incoming utf8 */ };
     m_handle = yajl_alloc(&CometCallbacks::callbacks, &cfg, NULL, (void *) this);
@@ -84,12 +92,73 @@ CometParser::nop()
 {
 }
 
+// the generic path's start of an object
+void
+CometParser::startObject()
+{
+    Object *o = new Object();
+    m_atEndStack.push( boost::bind(&CometParser::postObjectInserter, m_insertStack.top(), m_key, o) );
+    m_insertStack.push( boost::bind(&CometParser::objectInserter, o, _1, _2) );
+}
+
+// an object or array inside a typed message: either the result, or
+// something we skip over
+int
+CometParser::startTypedContainer(bool map)
+{
+    if (map && m_level == InMessage && m_messageKey == ResultKey) {
+        m_level = InResult;
+        m_result.clear();
+        m_resultField = CometResult::Field(0);
+    } else {
+        m_skipDepth = 1;
+    }
+    return 1;
+}
+
+// what QString::toLongLong and then toDouble would make of it, without
+// the QString
+static bool
+parseNumber(const char* s, unsigned int len, qlonglong& i, double& d, bool& integer)
+{
+    const bool negative = len && s[0] == '-';
+    unsigned int digits = negative ? len - 1 : len;
+
+    // anything that can't overflow is done by hand
+    if (digits > 0 && digits <= 18) {
+        qlonglong v = 0;
+        unsigned int n = negative ? 1 : 0;
+        for (; n < len && s[n] >= '0' && s[n] <= '9'; ++n)
+            v = v * 10 + (s[n] - '0');
+        if (n == len) {
+            i = negative ? -v : v;
+            integer = true;
+            return true;
+        }
+    }
+
+    bool ok;
+    QByteArray ba = QByteArray::fromRawData(s, len);
+    if ((i = ba.toLongLong(&ok), ok)) {
+        integer = true;
+        return true;
+    }
+    if ((d = ba.toDouble(&ok), ok)) {
+        integer = false;
+        return true;
+    }
+    return false;
+}
+
 ////////////////////////////////
 
 // yajl callbacks:
 int
 CometParser::json_null()
 {
+    if (m_skipDepth || m_level != NotTyped)
+        return 1;
+
     m_insertStack.top()( m_key, QVariant() );
     return 1;
 }
@@ -97,61 +166,141 @@ CometParser::json_null()
 int
 CometParser::json_boolean(int boolVal)
 {
+    if (m_skipDepth || m_level != NotTyped)
+        return 1;
+
     m_insertStack.top()( m_key, QVariant(boolVal ? true : false) );
     return 1;
 }
 
 int
-CometParser::json_number(const QString& s)
+CometParser::json_number(const RawString& s)
 {
+    if (m_skipDepth)
+        return 1;
+
+    if (m_level == InResult) {
+        qlonglong i;
+        double d;
+        bool integer;
+        if (m_resultField && parseNumber(s.data, s.len, i, d, integer)) {
+            if (integer)
+                m_result.setInteger(m_resultField, i);
+            else
+                m_result.setDouble(m_resultField, d);
+        }
+        return 1;
+    }
+    if (m_level == InMessage)
+        return 1;
+
     bool ok;
     qlonglong l;
     double d;
+    QString str = s.toString();
 
-    if ((l = s.toLongLong(&ok), ok)) {
+    if ((l = str.toLongLong(&ok), ok)) {
         m_insertStack.top()( m_key, QVariant(l) );
-    } else if ((d = s.toDouble(&ok), ok)) {
+    } else if ((d = str.toDouble(&ok), ok)) {
         m_insertStack.top()( m_key, QVariant(d) );
     }
     return 1;
 }
 
 int
-CometParser::json_string(const QString& s)
+CometParser::json_string(const RawString& s)
 {
-    m_insertStack.top()( m_key, QVariant(s) );
+    if (m_skipDepth)
+        return 1;
+
+    if (m_level == InResult) {
+        if (m_resultField & CometResult::StringFields)
+            m_result.setString(m_resultField, s.toString());
+        return 1;
+    }
+    if (m_level == InMessage) {
+        if (m_messageKey == QueryKey) {
+            m_qid = s.toString();
+            m_haveQid = true;
+        }
+        return 1;
+    }
+
+    m_insertStack.top()( m_key, QVariant(s.toString()) );
     return 1;
 }
 
 int
 CometParser::json_start_map()
 {
+    if (m_skipDepth) {
+        ++m_skipDepth;
+        return 1;
+    }
+    if (m_level != NotTyped)
+        return startTypedContainer(true);
+
     if (m_insertStack.size() == 0)
         return 0;       // the comet stream we expect has objects wrapped in an array, thx.
 
-    Object *o = new Object();
-    m_atEndStack.push( boost::bind(&CometParser::postObjectInserter, m_insertStack.top(), m_key, o) );
-    m_insertStack.push( boost::bind(&CometParser::objectInserter, o, _1, _2) );
+    if (m_typed && m_insertStack.size() == 1) {
+        // a new message, its first key says which way it goes
+        m_undecided = true;
+        return 1;
+    }
+
+    startObject();
     return 1;
 }
 
 int
-CometParser::json_map_key(const QString& s)
+CometParser::json_map_key(const RawString& s)
 {
-    m_key = s;
+    if (m_skipDepth)
+        return 1;
+
+    if (m_undecided) {
+        m_undecided = false;
+        if (s == "query" || s == "result") {
+            m_level = InMessage;
+            m_haveQid = false;
+            m_haveResult = false;
+        } else {
+            startObject();
+        }
+    }
+
+    switch (m_level) {
+        case InMessage:
+            m_messageKey = s == "query" ? QueryKey : s == "result" ? ResultKey : OtherKey;
+            break;
+        case InResult:
+            m_resultField = CometResult::field(s.data, s.len);
+            break;
+        case NotTyped:
+            m_key = s.toString();
+            break;
+    }
     return 1;
 }
 
 int
 CometParser::json_start_array()
 {
-    Array *a = new Array();
+    if (m_skipDepth) {
+        ++m_skipDepth;
+        return 1;
+    }
+    if (m_level != NotTyped)
+        return startTypedContainer(false);
+
     if (m_insertStack.size() == 0) {
         // the first enclosing array...
         // has a special inserter to call the function to emit the haveObject signal
         m_atEndStack.push( boost::bind(&CometParser::nop) );
         m_insertStack.push( boost::bind(&CometParser::haveObject, this, _1, _2) );
     } else {
+        Array *a = new Array();
         m_atEndStack.push( boost::bind(&CometParser::postArrayInserter, m_insertStack.top(), m_key, a) );
         m_insertStack.push( boost::bind(&CometParser::arrayInserter, a, _1, _2) );
     }
@@ -161,6 +310,32 @@ CometParser::json_start_array()
 int
 CometParser::json_end_map()
 {
+    if (m_skipDepth) {
+        --m_skipDepth;
+        return 1;
+    }
+
+    if (m_undecided) {
+        // {}
+        m_undecided = false;
+        emit haveObject(QVariantMap());
+        return 1;
+    }
+
+    if (m_level == InResult) {
+        m_level = InMessage;
+        m_haveResult = true;
+        return 1;
+    }
+
+    if (m_level == InMessage) {
+        m_level = NotTyped;
+        // the same shape PlaydarConnection insists on from the generic path
+        if (m_haveQid && m_haveResult)
+            emit haveResult(m_qid, m_result);
+        return 1;
+    }
+
     m_insertStack.pop();
     m_atEndStack.pop()();
     return 1;
@@ -169,8 +344,12 @@ CometParser::json_end_map()
 int
 CometParser::json_end_array()
 {
+    if (m_skipDepth) {
+        --m_skipDepth;
+        return 1;
+    }
+
     m_insertStack.pop();
     m_atEndStack.pop()();
     return 1;
 }
-
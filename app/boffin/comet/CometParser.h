@@ -25,10 +25,12 @@
 #include <QStack>
 #include <QVariant>
 
+#include <cstring>
 #include <boost/function.hpp>
 #include <boost/bind.hpp>
 
 #include "YajlCallbacks.hpp"
+#include "CometResult.h"
 
 // parses a neverending json comet stream like:
 //      "[ {}, {}, ...."
@@ -36,28 +38,43 @@
 // signal emitted for each top-level object
 //
 // yajl does the json (developed using yajl 1.0.5)
-// this class transforms the tokens into QVariantMap types
+//
+// playdar's { "query": qid, "result": { ... } } messages are recognised
+// by their first key and decoded straight into a CometResult, without
+// building any QVariants. Every other message is transformed into
+// QVariantMap types and emitted as haveObject.
 //
 class CometParser : public QObject
 {
     Q_OBJECT;
     Q_DISABLE_COPY(CometParser);
 
-    struct QStringPolicy
+    // the strings are left in yajl's buffer until we know we want them
+    struct RawString
+    {
+        const char* data;
+        unsigned int len;
+
+        QString toString() const { return QString::fromUtf8(data, len); }
+        bool operator==(const char* s) const { return qstrlen(s) == len && memcmp(s, data, len) == 0; }
+    };
+
+    struct RawPolicy
     {
-        static QString stringize(const char* s, unsigned int len)
+        static RawString stringize(const char* s, unsigned int len)
         {
-            return QString::fromUtf8(s, len);
+            RawString r = { s, len };
+            return r;
         }
     };
 
-    typedef TYajlCallbacks<CometParser, QStringPolicy> CometCallbacks;
+    typedef TYajlCallbacks<CometParser, RawPolicy> CometCallbacks;
     typedef QVariantMap Object;
     typedef QVariantList Array;
     typedef boost::function<void(const QString&, const QVariant&)> Inserter;
     typedef boost::function<void()> AtEnd;
 
-    friend class TYajlCallbacks<CometParser, QStringPolicy>;
+    friend class TYajlCallbacks<CometParser, RawPolicy>;
 
 public:
     CometParser(QObject *parent = 0);
@@ -65,8 +82,12 @@ public:
 
     bool push(const QByteArray& ba);        // push data in...
 
+    // when false every message goes the QVariantMap way, default true
+    void setTypedResults(bool b) { m_typed = b; }
+
 signals:
     void haveObject(QVariantMap o);         // ...and objects pop out
+    void haveResult(QString qid, CometResult result);
 
 private:
 
@@ -79,15 +100,18 @@ private:
     void haveObject(const QString&, const QVariant& v);
     static void nop();
 
+    void startObject();
+    int startTypedContainer(bool map);
+
     ////////////////////////////////
     // yajl callbacks
 
     int json_null();
     int json_boolean(int boolVal);
-    int json_number(const QString& s);
-    int json_string(const QString& s);
+    int json_number(const RawString& s);
+    int json_string(const RawString& s);
     int json_start_map();
-    int json_map_key(const QString& s);
+    int json_map_key(const RawString& s);
     int json_start_array();
     int json_end_map();
     int json_end_array();
@@ -98,9 +122,23 @@ private:
     QStack<Inserter> m_insertStack;     // inserters are used to put values into objects and arrays
     QStack<AtEnd> m_atEndStack;         // we call these at the end of an object or array
 
+    // the typed path
+    enum Level { NotTyped, InMessage, InResult };
+    enum MessageKey { QueryKey, ResultKey, OtherKey };
+
+    bool m_typed;
+    bool m_undecided;                   // in a new message, before its first key
+    Level m_level;
+    MessageKey m_messageKey;
+    CometResult::Field m_resultField;
+    int m_skipDepth;                    // inside a value we don't use
+    QString m_qid;
+    bool m_haveQid;
+    bool m_haveResult;
+    CometResult m_result;
+
     yajl_handle m_handle;
 };
 
 
 #endif
-
@@ -0,0 +1,136 @@
+/*
+   Copyright 2009 Last.fm Ltd. 
+      - Primarily authored by Max Howell, Jono Cole and Doug Mansell
+
+   This file is part of the Last.fm Desktop Application Suite.
+
+   lastfm-desktop is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   lastfm-desktop is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with lastfm-desktop.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "CometResult.h"
+
+#include <cstring>
+
+static const struct
+{
+    const char* key;
+    unsigned int len;
+    CometResult::Field field;
+} FIELDS[] = {
+    { "artist", 6, CometResult::Artist },
+    { "album", 5, CometResult::Album },
+    { "track", 5, CometResult::Track },
+    { "source", 6, CometResult::Source },
+    { "mimetype", 8, CometResult::Mimetype },
+    { "url", 3, CometResult::Url },
+    { "name", 4, CometResult::Name },
+    { "size", 4, CometResult::Size },
+    { "bitrate", 7, CometResult::Bitrate },
+    { "duration", 8, CometResult::Duration },
+    { "preference", 10, CometResult::Preference },
+    { "count", 5, CometResult::Count },
+    { "seconds", 7, CometResult::Seconds },
+    { "weight", 6, CometResult::Weight },
+    { "score", 5, CometResult::Score }
+};
+
+CometResult::CometResult()
+    : fields(0)
+    , size(0)
+    , bitrate(0)
+    , duration(0)
+    , preference(0)
+    , count(0)
+    , seconds(0)
+    , weight(0)
+    , score(0)
+{
+}
+
+//static
+CometResult::Field
+CometResult::field(const char* key, unsigned int len)
+{
+    for (unsigned int i = 0; i < sizeof(FIELDS) / sizeof(FIELDS[0]); ++i) {
+        if (FIELDS[i].len == len && memcmp(FIELDS[i].key, key, len) == 0)
+            return FIELDS[i].field;
+    }
+    return Field(0);
+}
+
+void
+CometResult::setString(Field f, const QString& s)
+{
+    switch (f) {
+        case Artist: artist = s; break;
+        case Album: album = s; break;
+        case Track: track = s; break;
+        case Source: source = s; break;
+        case Mimetype: mimetype = s; break;
+        case Url: url = s; break;
+        case Name: name = s; break;
+        default: return;
+    }
+    fields |= f;
+}
+
+void
+CometResult::setInteger(Field f, qlonglong i)
+{
+    switch (f) {
+        case Size: size = i; break;
+        case Bitrate: bitrate = i; break;
+        case Duration: duration = i; break;
+        case Preference: preference = i; break;
+        case Count: count = i; break;
+        case Seconds: seconds = i; break;
+        case Weight:
+        case Score:
+            setDouble(f, i);
+            return;
+        default: return;
+    }
+    fields |= f;
+}
+
+void
+CometResult::setDouble(Field f, double d)
+{
+    switch (f) {
+        case Weight: weight = d; break;
+        case Score: score = d; break;
+        default: return;
+    }
+    fields |= f;
+}
+
+//static
+CometResult
+CometResult::fromVariantMap(const QVariantMap& map)
+{
+    CometResult r;
+    for (QVariantMap::const_iterator i = map.constBegin(); i != map.constEnd(); ++i) {
+        QByteArray key = i.key().toUtf8();
+        Field f = field(key.constData(), key.size());
+        if (!f)
+            continue;
+
+        switch (i->type()) {
+            case QVariant::String: r.setString(f, i->toString()); break;
+            case QVariant::LongLong: r.setInteger(f, i->toLongLong()); break;
+            case QVariant::Double: r.setDouble(f, i->toDouble()); break;
+            default: break;
+        }
+    }
+    return r;
+}
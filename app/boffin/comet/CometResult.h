@@ -0,0 +1,94 @@
+/*
+   Copyright 2009 Last.fm Ltd. 
+      - Primarily authored by Max Howell, Jono Cole and Doug Mansell
+
+   This file is part of the Last.fm Desktop Application Suite.
+
+   lastfm-desktop is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   lastfm-desktop is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with lastfm-desktop.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef COMET_RESULT_H
+#define COMET_RESULT_H
+
+#include <QString>
+#include <QVariant>
+
+// the "result" of a playdar comet message, with just the fields boffin
+// uses, decoded straight from the json by CometParser.
+//
+// fields says which of them were there, with the right json type:
+// strings for strings, integers for ints, any number for floats
+//
+struct CometResult
+{
+    enum Field
+    {
+        Artist      = 1 << 0,
+        Album       = 1 << 1,
+        Track       = 1 << 2,
+        Source      = 1 << 3,
+        Mimetype    = 1 << 4,
+        Url         = 1 << 5,
+        Name        = 1 << 6,
+        Size        = 1 << 7,
+        Bitrate     = 1 << 8,
+        Duration    = 1 << 9,
+        Preference  = 1 << 10,
+        Count       = 1 << 11,
+        Seconds     = 1 << 12,
+        Weight      = 1 << 13,
+        Score       = 1 << 14,
+
+        StringFields = Artist | Album | Track | Source | Mimetype | Url | Name,
+        IntFields = Size | Bitrate | Duration | Preference | Count | Seconds,
+        FloatFields = Weight | Score
+    };
+
+    CometResult();
+
+    // true if all of the fields are there
+    bool has(unsigned int f) const { return (fields & f) == f; }
+
+    // forgets the fields, but keeps the strings' storage for reuse
+    void clear() { fields = 0; }
+
+    void setString(Field f, const QString& s);
+    void setInteger(Field f, qlonglong i);
+    void setDouble(Field f, double d);
+
+    // the field for a json key, or 0 for keys we don't use
+    static Field field(const char* key, unsigned int len);
+
+    // the same thing from the generic parser's QVariantMap
+    static CometResult fromVariantMap(const QVariantMap& map);
+
+    unsigned int fields;
+
+    QString artist;
+    QString album;
+    QString track;
+    QString source;
+    QString mimetype;
+    QString url;
+    QString name;
+    int size;
+    int bitrate;
+    int duration;
+    int preference;
+    int count;
+    int seconds;
+    float weight;
+    float score;
+};
+
+#endif
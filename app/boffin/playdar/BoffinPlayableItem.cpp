@@ -40,37 +40,49 @@ BoffinPlayableItem::BoffinPlayableItem()
 //static
 BoffinPlayableItem 
 BoffinPlayableItem::fromTrackResolveResult(const QVariantMap& map)
+{
+    return fromTrackResolveResult(CometResult::fromVariantMap(map));
+}
+
+//static
+BoffinPlayableItem 
+BoffinPlayableItem::fromBoffinRqlResult(const QVariantMap& map)
+{
+    return fromBoffinRqlResult(CometResult::fromVariantMap(map));
+}
+
+// the fields resolve and rql results have in common
+static void
+copyCommon(const CometResult& r, BoffinPlayableItemData* d)
+{
+    if (r.has(CometResult::Album)) d->album = r.album;
+    if (r.has(CometResult::Artist)) d->artist = r.artist;
+    if (r.has(CometResult::Bitrate)) d->bitrate = r.bitrate;
+    if (r.has(CometResult::Duration)) d->duration = r.duration;
+    if (r.has(CometResult::Mimetype)) d->mimetype = r.mimetype;
+    if (r.has(CometResult::Preference)) d->preference = r.preference;
+    if (r.has(CometResult::Source)) d->source = r.source;
+    if (r.has(CometResult::Size)) d->size = r.size;
+    if (r.has(CometResult::Track)) d->track = r.track;
+    if (r.has(CometResult::Url)) d->url = r.url;
+}
+
+//static
+BoffinPlayableItem 
+BoffinPlayableItem::fromTrackResolveResult(const CometResult& r)
 {
     BoffinPlayableItem result;
-    jsonGetMember(map, "album", result.d->album);
-    jsonGetMember(map, "artist", result.d->artist);
-    jsonGetMember(map, "bitrate", result.d->bitrate);
-    jsonGetMember(map, "duration", result.d->duration);
-    jsonGetMember(map, "mimetype", result.d->mimetype);
-    jsonGetMember(map, "preference", result.d->preference);
-    jsonGetMember(map, "score", result.d->score);
-    jsonGetMember(map, "source", result.d->source);
-    jsonGetMember(map, "size", result.d->size);
-    jsonGetMember(map, "track", result.d->track);
-    jsonGetMember(map, "url", result.d->url);
+    copyCommon(r, result.d.data());
+    if (r.has(CometResult::Score)) result.d->score = r.score;
     return result;
 }
 
 //static
 BoffinPlayableItem 
-BoffinPlayableItem::fromBoffinRqlResult(const QVariantMap& map)
+BoffinPlayableItem::fromBoffinRqlResult(const CometResult& r)
 {
     BoffinPlayableItem result;
-    jsonGetMember(map, "album", result.d->album);
-    jsonGetMember(map, "artist", result.d->artist);
-    jsonGetMember(map, "bitrate", result.d->bitrate);
-    jsonGetMember(map, "duration", result.d->duration);
-    jsonGetMember(map, "mimetype", result.d->mimetype);
-    jsonGetMember(map, "preference", result.d->preference);
-    jsonGetMember(map, "source", result.d->source);
-    jsonGetMember(map, "size", result.d->size);
-    jsonGetMember(map, "track", result.d->track);
-    jsonGetMember(map, "url", result.d->url);
-    jsonGetMember(map, "weight", result.d->weight);
+    copyCommon(r, result.d.data());
+    if (r.has(CometResult::Weight)) result.d->weight = r.weight;
     return result;
 }
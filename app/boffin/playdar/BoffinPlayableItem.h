@@ -23,6 +23,7 @@
 #include <QSharedData>
 #include <QVariant>
 #include <QString>
+#include "../comet/CometResult.h"
 
 struct BoffinPlayableItemData : QSharedData
 {
@@ -75,6 +76,8 @@ public:
 
     static BoffinPlayableItem fromTrackResolveResult(const QVariantMap& map);
     static BoffinPlayableItem fromBoffinRqlResult(const QVariantMap& map);
+    static BoffinPlayableItem fromTrackResolveResult(const CometResult& r);
+    static BoffinPlayableItem fromBoffinRqlResult(const CometResult& r);
 
 protected:
     QExplicitlySharedDataPointer<BoffinPlayableItemData> d;
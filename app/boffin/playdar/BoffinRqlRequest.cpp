@@ -62,6 +62,13 @@ BoffinRqlRequest::receiveResult(const QVariantMap& o)
     emit playableItem( BoffinPlayableItem::fromBoffinRqlResult(o) );
 }
 
+//virtual
+void
+BoffinRqlRequest::receiveResult(const CometResult& r)
+{
+    emit playableItem( BoffinPlayableItem::fromBoffinRqlResult(r) );
+}
+
 void
 BoffinRqlRequest::fail(const char *message)
 {
@@ -33,6 +33,7 @@ class BoffinRqlRequest : public CometRequest
 public:
     void issueRequest(lastfm::NetworkAccessManager* wam, PlaydarApi& api, const QString& rql, const QString& session);
     virtual void receiveResult(const QVariantMap& o);
+    virtual void receiveResult(const CometResult& r);
 
 signals:
     void error();
@@ -64,17 +64,17 @@ BoffinTagRequest::onFinished()
 void
 BoffinTagRequest::receiveResult(const QVariantMap& o)
 {
-    QString tagName, hostName;
-    int count;
-    double weight;
-    int seconds;
-    if (jsonGetMember(o, "name", tagName) &&
-        jsonGetMember(o, "source", hostName) &&
-        jsonGetMember(o, "count", count) &&
-        jsonGetMember(o, "weight", weight) && 
-        jsonGetMember(o, "seconds", seconds))
+    receiveResult(CometResult::fromVariantMap(o));
+}
+
+
+// virtual
+void
+BoffinTagRequest::receiveResult(const CometResult& r)
+{
+    if (r.has(CometResult::Name | CometResult::Source | CometResult::Count | CometResult::Weight | CometResult::Seconds))
     {
-        emit tagItem(BoffinTagItem(tagName, hostName, count, static_cast<float>(weight), seconds));
+        emit tagItem(BoffinTagItem(r.name, r.source, r.count, r.weight, r.seconds));
     }
 }
 
@@ -68,6 +68,7 @@ class BoffinTagRequest : public CometRequest
 public:
     void issueRequest(lastfm::NetworkAccessManager* wam, PlaydarApi& api, const QString& rql, const QString& session);
     virtual void receiveResult(const QVariantMap& o);
+    virtual void receiveResult(const CometResult& r);
 
 signals:
     void error();
@@ -23,6 +23,7 @@
 #include <QString>
 #include <QVariant>
 #include <QByteArray>
+#include "../comet/CometResult.h"
 
 class CometRequest : public QObject
 {
@@ -32,6 +33,7 @@ public:
     CometRequest();
     const QString& qid() const;
     virtual void receiveResult(const QVariantMap& o) = 0;
+    virtual void receiveResult(const CometResult& r) = 0;
 
 protected:
     bool getQueryId(const QByteArray& data, QString& out);
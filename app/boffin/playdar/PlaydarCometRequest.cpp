@@ -42,6 +42,7 @@ PlaydarCometRequest::issueRequest(lastfm::NetworkAccessManager* wam, PlaydarApi&
 
     m_parser = new CometParser(this);
     connect(m_parser, SIGNAL(haveObject(QVariantMap)), SIGNAL(receivedObject(QVariantMap)));
+    connect(m_parser, SIGNAL(haveResult(QString, CometResult)), SIGNAL(receivedResult(QString, CometResult)));
     connect(reply, SIGNAL(readyRead()), SLOT(onFirstReadyRead()));
     connect(reply, SIGNAL(readyRead()), SLOT(onReadyRead()));
     connect(reply, SIGNAL(finished()), SLOT(onFinished()));
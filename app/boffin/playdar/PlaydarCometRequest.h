@@ -24,6 +24,7 @@
 #include "PlaydarApi.h"
 #include <lastfm/global.h>
 #include <QVariant>
+#include "../comet/CometResult.h"
 
 class CometParser;
 
@@ -42,6 +43,7 @@ public:
 
 signals:
     void receivedObject(QVariantMap);
+    void receivedResult(QString qid, CometResult result);
     void connected(QString);
     void finished();
     void error();
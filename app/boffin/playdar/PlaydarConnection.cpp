@@ -128,6 +128,7 @@ PlaydarConnection::makeCometRequest()
         connect(m_comet, SIGNAL(connected(QString)), SLOT(onCometConnected(QString)));
         connect(m_comet, SIGNAL(error()), SLOT(onError()));
         connect(m_comet, SIGNAL(receivedObject(QVariantMap)), SLOT(receivedCometObject(QVariantMap)));
+        connect(m_comet, SIGNAL(receivedResult(QString, CometResult)), SLOT(receivedCometResult(QString, CometResult)));
     }
 }
 
@@ -234,3 +235,13 @@ PlaydarConnection::receivedCometObject(const QVariantMap& obj)
     }
 }
 
+void
+PlaydarConnection::receivedCometResult(const QString& qid, const CometResult& result)
+{
+    QMap<QString, CometRequest*>::const_iterator reqIt = m_cometReqMap.find(qid);
+    if (reqIt != m_cometReqMap.end()) {
+        reqIt.value()->receiveResult(result);
+    } else {
+        qDebug() << "warning: result for unknown query " << qid << " was discarded";
+    }
+}
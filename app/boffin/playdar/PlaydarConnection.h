@@ -24,6 +24,7 @@
 #include "PlaydarApi.h"
 #include <lastfm/global.h>
 #include <QStringListModel>
+#include "../comet/CometResult.h"
 
 class PlaydarCometRequest;
 class CometRequest;
@@ -59,6 +60,7 @@ private slots:
 
     void onCometConnected(const QString& sessionId);
     void receivedCometObject(const QVariantMap&);
+    void receivedCometResult(const QString& qid, const CometResult& result);
     void onRequestMade(const QString& qid);
     void onRequestDestroyed(QObject* o);
 
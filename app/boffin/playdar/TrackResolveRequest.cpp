@@ -43,6 +43,13 @@ TrackResolveRequest::receiveResult(const QVariantMap& o)
     emit result(BoffinPlayableItem::fromTrackResolveResult(o));
 }
 
+//virtual 
+void 
+TrackResolveRequest::receiveResult(const CometResult& r)
+{
+    emit result(BoffinPlayableItem::fromTrackResolveResult(r));
+}
+
 void 
 TrackResolveRequest::onFinished()
 {
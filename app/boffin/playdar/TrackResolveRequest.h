@@ -33,6 +33,7 @@ class TrackResolveRequest : public CometRequest
 public:
     void issueRequest(lastfm::NetworkAccessManager* wam, PlaydarApi& api, const QString& artist, const QString& album, const QString& track, const QString& session);
     virtual void receiveResult(const QVariantMap& o);
+    virtual void receiveResult(const CometResult& r);
 
 signals:
     void error();
@@ -0,0 +1,180 @@
+/*
+   Copyright 2013 Last.fm Ltd.
+
+   This file is part of the Last.fm Desktop Application Suite.
+
+   lastfm-desktop is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   lastfm-desktop is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with lastfm-desktop.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Sample from a distribution whose weights keep changing.
+//
+// The weights live in a Fenwick (binary indexed) tree, so appending,
+// changing a weight and drawing a sample are all O(log n). Remove an
+// element by setting its weight to 0; slots are never reused, call
+// clear() and start again to reclaim them.
+
+#ifndef __FENWICK_SAMPLER_H
+#define __FENWICK_SAMPLER_H
+
+#include <vector>
+#include <ctime>
+
+#include <boost/random.hpp>
+
+namespace fm { namespace last { namespace algo {
+
+// -----------------------------------------------------------------------------
+
+class FenwickSampler
+{
+   // m_tree[i] is the sum of the m_weights (i - lowbit(i), i], 1 based
+   std::vector<double> m_tree;
+   std::vector<double> m_weights;
+
+   // changing weights by difference slowly accumulates rounding error,
+   // so every so often the tree is rebuilt from m_weights
+   size_t m_updates;
+
+   boost::mt19937                            m_randomGenerator;
+   mutable boost::uniform_01<boost::mt19937> m_uniform01Distr;
+
+   static size_t lowbit( size_t i ) { return i & ( ~i + 1 ); }
+
+   double prefix( size_t count ) const
+   {
+      double sum = 0;
+      for ( size_t i = count; i > 0; i -= lowbit(i) )
+         sum += m_tree[i];
+      return sum;
+   }
+
+   void add( size_t index, double delta )
+   {
+      for ( size_t i = index + 1; i < m_tree.size(); i += lowbit(i) )
+         m_tree[i] += delta;
+   }
+
+   void rebuild()
+   {
+      m_tree.assign( m_weights.size() + 1, 0 );
+      for ( size_t i = 1; i < m_tree.size(); ++i )
+      {
+         m_tree[i] += m_weights[i - 1];
+         size_t parent = i + lowbit(i);
+         if ( parent < m_tree.size() )
+            m_tree[parent] += m_tree[i];
+      }
+      m_updates = 0;
+   }
+
+public:
+
+   FenwickSampler() :
+      m_tree( 1, 0 ),
+      m_updates( 0 ),
+      m_randomGenerator(),
+      m_uniform01Distr(m_randomGenerator)
+      {
+         m_uniform01Distr.base().seed( static_cast<boost::uint32_t>( time(0) ) );
+      }
+
+   size_t size() const { return m_weights.size(); }
+
+   double weight( size_t index ) const { return m_weights[index]; }
+
+   double total() const { return prefix( m_weights.size() ); }
+
+   void clear()
+   {
+      m_weights.clear();
+      m_tree.assign( 1, 0 );
+      m_updates = 0;
+   }
+
+   // replaces everything, O(n)
+   void assign( const std::vector<double>& weights )
+   {
+      m_weights = weights;
+      rebuild();
+   }
+
+   // returns the index of the new element
+   size_t push_back( double weight )
+   {
+      size_t i = m_tree.size();
+
+      // the new node covers (i - lowbit(i), i], everything but itself is
+      // already in the tree
+      m_tree.push_back( weight + prefix( i - 1 ) - prefix( i - lowbit(i) ) );
+      m_weights.push_back( weight );
+      return i - 1;
+   }
+
+   void set( size_t index, double weight )
+   {
+      double delta = weight - m_weights[index];
+      if ( delta == 0 )
+         return;
+
+      m_weights[index] = weight;
+
+      if ( ++m_updates > m_weights.size() )
+         rebuild();
+      else
+         add( index, delta );
+   }
+
+   // picks an index with probability proportional to its weight,
+   // or returns size() if every weight is 0
+   size_t sample() const
+   {
+      const size_t n = m_weights.size();
+      const double sum = total();
+      if ( n == 0 || sum <= 0 )
+         return n;
+
+      double remaining = m_uniform01Distr() * sum;
+
+      size_t step = 1;
+      while ( step * 2 <= n )
+         step *= 2;
+
+      // walk down the tree to the last prefix <= remaining
+      size_t pos = 0;
+      for ( ; step > 0; step /= 2 )
+      {
+         if ( pos + step <= n && m_tree[pos + step] <= remaining )
+         {
+            pos += step;
+            remaining -= m_tree[pos];
+         }
+      }
+
+      // rounding can land us past the end or on a removed element
+      if ( pos >= n )
+         pos = n - 1;
+      while ( pos > 0 && m_weights[pos] <= 0 )
+         --pos;
+      while ( pos < n && m_weights[pos] <= 0 )
+         ++pos;
+
+      return pos;
+   }
+};
+
+// -----------------------------------------------------------------------------
+
+}}} // end of namespaces
+
+#endif // __FENWICK_SAMPLER_H
@@ -0,0 +1,235 @@
+/*
+   Copyright 2013 Last.fm Ltd.
+
+   This file is part of the Last.fm Desktop Application Suite.
+
+   lastfm-desktop is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   lastfm-desktop is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with lastfm-desktop.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <QtTest>
+#include <QEventLoop>
+#include "LocalCollectionScanner.h"
+
+
+/** Cold and warm in-process scans of a synthetic collection.
+  * BOFFIN_BENCH_FILES sets how many files, 100000 by default. */
+class BenchCollectionScanner : public QObject
+{
+    Q_OBJECT
+
+    QString m_root;
+    QString m_manifest;
+    int m_fileCount;
+    int m_tracks;
+
+    static void writeFile( const QString& path, const QString& artist, const QString& album, const QString& title );
+    static void removeTree( const QString& path );
+
+    void scan( LocalCollectionScanner& scanner, const QString& root = QString() );
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void testIncremental();
+    void testLinks();
+    void benchmark_data();
+    void benchmark();
+
+    void onTracks( const QList<Track>& tracks ) { m_tracks += tracks.count(); }
+};
+
+
+/** some junk audio and an ID3v1 tag */
+void
+BenchCollectionScanner::writeFile( const QString& path, const QString& artist, const QString& album, const QString& title )
+{
+    QByteArray tag( 128, '\0' );
+    tag.replace( 0, 3, "TAG" );
+    tag.replace( 3, title.size(), title.toLatin1() );
+    tag.replace( 33, artist.size(), artist.toLatin1() );
+    tag.replace( 63, album.size(), album.toLatin1() );
+
+    QFile file( path );
+    file.open( QIODevice::WriteOnly );
+    file.write( QByteArray( 256, 'x' ) );
+    file.write( tag );
+}
+
+
+void
+BenchCollectionScanner::removeTree( const QString& path )
+{
+    QDir dir( path );
+    foreach ( const QFileInfo& info, dir.entryInfoList( QDir::Dirs | QDir::Files | QDir::NoDotAndDotDot ) )
+    {
+        if ( info.isDir() )
+            removeTree( info.absoluteFilePath() );
+        else
+            QFile::remove( info.absoluteFilePath() );
+    }
+    dir.rmdir( path );
+}
+
+
+void
+BenchCollectionScanner::scan( LocalCollectionScanner& scanner, const QString& root )
+{
+    m_tracks = 0;
+    connect( &scanner, SIGNAL(tracks( QList<Track> )), SLOT(onTracks( QList<Track> )) );
+
+    QEventLoop loop;
+    connect( &scanner, SIGNAL(finished()), &loop, SLOT(quit()) );
+    scanner.scan( QStringList() << ( root.isEmpty() ? m_root : root ), m_manifest );
+    loop.exec();
+}
+
+
+void
+BenchCollectionScanner::initTestCase()
+{
+    m_fileCount = qgetenv( "BOFFIN_BENCH_FILES" ).toInt();
+    if ( m_fileCount <= 0 )
+        m_fileCount = 100000;
+
+    m_root = QDir::temp().filePath( QString( "bench_collectionscanner_%1" ).arg( QCoreApplication::applicationPid() ) );
+    m_manifest = m_root + ".manifest";
+
+    // ten tracks an album, ten albums an artist
+    for ( int i = 0; i < m_fileCount; ++i )
+    {
+        QString artist = QString( "Artist %1" ).arg( i / 100 );
+        QString album = QString( "Album %1" ).arg( i / 10 % 10 );
+        QString title = QString( "Title %1" ).arg( i );
+
+        QString dir = m_root + '/' + artist + '/' + album;
+        if ( i % 10 == 0 )
+            QVERIFY( QDir().mkpath( dir ) );
+
+        writeFile( dir + QString( "/%1 %2.mp3" ).arg( i % 10 + 1, 2, 10, QChar( '0' ) ).arg( title ), artist, album, title );
+    }
+}
+
+
+void
+BenchCollectionScanner::cleanupTestCase()
+{
+    removeTree( m_root );
+    QFile::remove( m_manifest );
+}
+
+
+void
+BenchCollectionScanner::testIncremental()
+{
+    QFile::remove( m_manifest );
+
+    {
+        LocalCollectionScanner scanner( 0 );
+        scan( scanner );
+        QCOMPARE( m_tracks, m_fileCount );
+        QCOMPARE( scanner.changedFiles(), m_fileCount );
+        QCOMPARE( scanner.unchangedFiles(), 0 );
+    }
+    {
+        LocalCollectionScanner scanner( 0 );
+        scan( scanner );
+        QCOMPARE( m_tracks, m_fileCount );
+        QCOMPARE( scanner.changedFiles(), 0 );
+        QCOMPARE( scanner.unchangedFiles(), m_fileCount );
+    }
+
+    // a file that grows is read again, a new file is read for the first time
+    QString album = m_root + "/Artist 0/Album 0";
+    QFile file( album + "/01 Title 0.mp3" );
+    QVERIFY( file.open( QIODevice::Append ) );
+    file.write( "more" );
+    file.close();
+    writeFile( album + "/11 Extra.mp3", "Artist 0", "Album 0", "Extra" );
+
+    {
+        LocalCollectionScanner scanner( 0 );
+        scan( scanner );
+        QCOMPARE( m_tracks, m_fileCount + 1 );
+        QCOMPARE( scanner.changedFiles(), 2 );
+        QCOMPARE( scanner.unchangedFiles(), m_fileCount - 1 );
+    }
+
+    QFile::remove( album + "/11 Extra.mp3" );
+}
+
+
+void
+BenchCollectionScanner::testLinks()
+{
+#ifdef Q_OS_WIN
+    QSKIP( "Needs symbolic links", SkipSingle );
+#else
+    QString root = m_root + "_links";
+    QVERIFY( QDir().mkpath( root + "/music/Album" ) );
+    QVERIFY( QDir().mkpath( root + "/scan" ) );
+    writeFile( root + "/music/Album/01 One.mp3", "Artist", "Album", "One" );
+
+    // a link out of the scanned directory is followed, one back to where
+    // we've already been isn't
+    QVERIFY( QFile::link( root + "/music", root + "/scan/music" ) );
+    QVERIFY( QFile::link( root + "/music", root + "/music/Album/loop" ) );
+
+    QFile::remove( m_manifest );
+    LocalCollectionScanner scanner( 0 );
+    scan( scanner, root + "/scan" );
+    QCOMPARE( m_tracks, 1 );
+
+    QFile::remove( root + "/music/Album/loop" );
+    QFile::remove( root + "/scan/music" );
+    removeTree( root );
+    QFile::remove( m_manifest );
+#endif
+}
+
+
+void
+BenchCollectionScanner::benchmark_data()
+{
+    QTest::addColumn<bool>( "warm" );
+    QTest::newRow( "cold" ) << false;
+    QTest::newRow( "warm" ) << true;
+}
+
+
+void
+BenchCollectionScanner::benchmark()
+{
+    QFETCH( bool, warm );
+
+    // leaves a manifest of the whole tree behind for the warm run
+    if ( warm )
+    {
+        LocalCollectionScanner scanner( 0 );
+        scan( scanner );
+    }
+
+    QBENCHMARK
+    {
+        if ( !warm )
+            QFile::remove( m_manifest );
+
+        LocalCollectionScanner scanner( 0 );
+        scan( scanner );
+    }
+
+    QCOMPARE( m_tracks, m_fileCount );
+}
+
+
+QTEST_MAIN( BenchCollectionScanner )
+#include "BenchCollectionScanner.moc"
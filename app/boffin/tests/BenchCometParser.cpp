@@ -0,0 +1,193 @@
+/*
+   Copyright 2013 Last.fm Ltd.
+
+   This file is part of the Last.fm Desktop Application Suite.
+
+   lastfm-desktop is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   lastfm-desktop is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with lastfm-desktop.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <cstdlib>
+#include <QtTest>
+#include <QTime>
+#include "comet/CometParser.h"
+
+// glibc lets us count every allocation, Qt's and ours
+#if defined(__GLIBC__)
+extern "C" void* __libc_malloc( size_t );
+static long mallocs = 0;
+extern "C" void* malloc( size_t size ) { ++mallocs; return __libc_malloc( size ); }
+#define HAVE_MALLOC_COUNT
+#endif
+
+
+/** Compares the typed and QVariantMap paths through CometParser on a
+  * stream shaped like a boffin session with playdar: tag cloud results,
+  * then playable items, with the odd message of some other type. */
+class BenchCometParser : public QObject
+{
+    Q_OBJECT
+
+    QByteArray m_stream;
+    int m_messages;
+
+    QList<QPair<QString, CometResult> > m_results;
+    int m_objects;
+
+    void parse( bool typed );
+
+private slots:
+    void initTestCase();
+    void testTypedMatchesGeneric();
+    void benchmark_data();
+    void benchmark();
+
+    void onResult( const QString& qid, const CometResult& r ) { m_results << qMakePair( qid, r ); }
+    void onObject( const QVariantMap& o );
+};
+
+
+void
+BenchCometParser::onObject( const QVariantMap& o )
+{
+    ++m_objects;
+
+    // what PlaydarConnection does with them
+    if (o.value( "query" ).type() == QVariant::String && o.value( "result" ).type() == QVariant::Map)
+        m_results << qMakePair( o["query"].toString(), CometResult::fromVariantMap( o["result"].toMap() ) );
+}
+
+
+void
+BenchCometParser::initTestCase()
+{
+    const QString tagQid = "0b4f1e8c-7a43-4bfa-a2a7-0b0d62f0b7e1";
+    const QString rqlQid = "6cbcbd4e-8d1b-4a3b-9d45-8a9bdf6b3f10";
+
+    m_stream = "[";
+    m_messages = 0;
+
+    for ( int i = 0; i < 20000; ++i, ++m_messages )
+    {
+        QString json;
+        if ( i % 100 == 99 )
+        {
+            json = QString( "{\"type\":\"status\",\"hosts\":[\"host%1\",\"localhost\"],\"ok\":true,\"load\":null}," ).arg( i );
+        }
+        else if ( i < 2000 )
+        {
+            json = QString( "{\"query\":\"%1\",\"result\":{\"name\":\"tag %2\",\"source\":\"localhost\","
+                            "\"count\":%3,\"weight\":%4,\"seconds\":%5}}," )
+                   .arg( tagQid ).arg( i ).arg( i % 300 + 1 ).arg( ( i % 97 ) / 97.0 ).arg( i * 181 );
+        }
+        else
+        {
+            json = QString( "{\"query\":\"%1\",\"result\":{\"sid\":\"%2\",\"artist\":\"Artist %3\",\"album\":\"Album %4\","
+                            "\"track\":\"Track \\u00e9 %5\",\"source\":\"localhost\",\"mimetype\":\"audio/mpeg\","
+                            "\"url\":\"http://localhost:60210/sid/%2\",\"size\":%6,\"bitrate\":192,\"duration\":%7,"
+                            "\"preference\":100,\"weight\":%8,\"tags\":[\"rock\",\"indie\"],\"extra\":{\"a\":1}}}," )
+                   .arg( rqlQid ).arg( i ).arg( i % 500 ).arg( i % 50 ).arg( i )
+                   .arg( 3000000 + i ).arg( 120 + i % 300 ).arg( i % 3 ? QString::number( 1 + i % 10 ) : QString::number( 0.25 * ( i % 7 ) ) );
+        }
+        m_stream += json.toUtf8();
+    }
+}
+
+
+void
+BenchCometParser::parse( bool typed )
+{
+    m_results.clear();
+    m_objects = 0;
+
+    CometParser parser;
+    parser.setTypedResults( typed );
+    connect( &parser, SIGNAL(haveResult( QString, CometResult )), SLOT(onResult( QString, CometResult )) );
+    connect( &parser, SIGNAL(haveObject( QVariantMap )), SLOT(onObject( QVariantMap )) );
+
+    // about what the network hands us at a time
+    for ( int i = 0; i < m_stream.size(); i += 4096 )
+        QVERIFY( parser.push( m_stream.mid( i, 4096 ) ) );
+}
+
+
+void
+BenchCometParser::testTypedMatchesGeneric()
+{
+    parse( false );
+    QList<QPair<QString, CometResult> > generic = m_results;
+    int genericObjects = m_objects;
+
+    parse( true );
+    int unknown = m_messages / 100;
+    QCOMPARE( genericObjects, m_messages );
+    QCOMPARE( m_objects, unknown );
+    QCOMPARE( m_results.count(), generic.count() );
+    QCOMPARE( m_results.count(), m_messages - unknown );
+
+    for ( int i = 0; i < m_results.count(); ++i )
+    {
+        const CometResult& a = m_results[i].second;
+        const CometResult& b = generic[i].second;
+
+        QCOMPARE( m_results[i].first, generic[i].first );
+        QCOMPARE( a.fields, b.fields );
+        if ( a.has( CometResult::Name ) ) QCOMPARE( a.name, b.name );
+        if ( a.has( CometResult::Artist ) ) QCOMPARE( a.artist, b.artist );
+        if ( a.has( CometResult::Track ) ) QCOMPARE( a.track, b.track );
+        if ( a.has( CometResult::Url ) ) QCOMPARE( a.url, b.url );
+        if ( a.has( CometResult::Count ) ) QCOMPARE( a.count, b.count );
+        if ( a.has( CometResult::Size ) ) QCOMPARE( a.size, b.size );
+        if ( a.has( CometResult::Weight ) ) QCOMPARE( a.weight, b.weight );
+    }
+
+    QVERIFY( m_results[0].second.has( CometResult::Name | CometResult::Source | CometResult::Count | CometResult::Weight | CometResult::Seconds ) );
+    QCOMPARE( m_results.last().second.track, QString::fromUtf8( "Track \xc3\xa9 19998" ) );
+}
+
+
+void
+BenchCometParser::benchmark_data()
+{
+    QTest::addColumn<bool>( "typed" );
+    QTest::newRow( "generic" ) << false;
+    QTest::newRow( "typed" ) << true;
+}
+
+
+void
+BenchCometParser::benchmark()
+{
+    QFETCH( bool, typed );
+
+#ifdef HAVE_MALLOC_COUNT
+    long before = mallocs;
+#endif
+    QTime time;
+    time.start();
+    parse( typed );
+    int ms = qMax( 1, time.elapsed() );
+
+#ifdef HAVE_MALLOC_COUNT
+    qDebug() << ( typed ? "typed:" : "generic:" ) << double( mallocs - before ) / m_messages << "allocations per message";
+#endif
+    qDebug() << ( typed ? "typed:" : "generic:" ) << m_messages * 1000 / ms << "messages per second";
+
+    QBENCHMARK
+    {
+        parse( typed );
+    }
+}
+
+
+QTEST_APPLESS_MAIN( BenchCometParser )
+#include "BenchCometParser.moc"
@@ -0,0 +1,193 @@
+/*
+   Copyright 2013 Last.fm Ltd.
+
+   This file is part of the Last.fm Desktop Application Suite.
+
+   lastfm-desktop is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   lastfm-desktop is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with lastfm-desktop.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <QtTest>
+#include <QSet>
+#include "Shuffler.h"
+
+
+class BenchShuffler : public QObject
+{
+    Q_OBJECT
+
+    static QString word();
+    static void fill( Shuffler& shuffler, int count );
+    static void verifyWeights( Shuffler& shuffler );
+
+private slots:
+    void testEveryItemOnce();
+    void testIncrementalWeights();
+    void benchmark_data();
+    void benchmark();
+};
+
+
+QString
+BenchShuffler::word()
+{
+    QString s;
+    int length = 4 + qrand() % 10;
+    for ( int i = 0; i < length; ++i )
+        s += QChar( 'a' + qrand() % 26 );
+    return s;
+}
+
+
+/** a collection with about ten tracks per artist */
+void
+BenchShuffler::fill( Shuffler& shuffler, int count )
+{
+    qsrand( 1 );
+
+    QStringList artists;
+    for ( int i = 0; i < qMax( 1, count / 10 ); ++i )
+        artists << word();
+
+    for ( int i = 0; i < count; ++i )
+    {
+        QVariantMap map;
+        map["artist"] = artists[qrand() % artists.size()];
+        map["track"] = word() + ' ' + word();
+        map["url"] = QString( "file:///music/%1.mp3" ).arg( i );
+        map["weight"] = 0.1 + ( qrand() % 100 ) / 100.0;
+        shuffler.receivePlayableItem( BoffinPlayableItem::fromBoffinRqlResult( map ) );
+    }
+}
+
+
+void
+BenchShuffler::testEveryItemOnce()
+{
+    // enough to make the shuffler drop the picked items part way through
+    const int count = 3000;
+
+    Shuffler shuffler;
+    fill( shuffler, count );
+
+    QSet<QString> urls;
+    for ( BoffinPlayableItem item = shuffler.sampleOne(); item.isValid(); item = shuffler.sampleOne() )
+    {
+        QVERIFY( !urls.contains( item.url() ) );
+        urls << item.url();
+
+        if ( urls.size() == count / 2 )
+            QCOMPARE( shuffler.items().size(), count - urls.size() );
+    }
+
+    QCOMPARE( urls.size(), count );
+    QVERIFY( shuffler.items().isEmpty() );
+}
+
+
+/** the weights the sampler has been kept up to date with against ones
+  * worked out from scratch */
+void
+BenchShuffler::verifyWeights( Shuffler& shuffler )
+{
+    for ( int i = 0; i < shuffler.m_items.size(); ++i )
+    {
+        if ( shuffler.m_taken[i] )
+            continue;
+
+        const BoffinPlayableItem& item = shuffler.m_items[i];
+        double kept = shuffler.m_sampler.weight( i );
+        QVERIFY( qAbs( item.workingweight() - kept ) <= 1e-6 * qMax( 1.0, kept ) );
+
+        shuffler.m_matches[i].clear();
+        shuffler.matchHistory( i );
+        double recomputed = item.weight() * shuffler.pushdown( i );
+        QVERIFY2( qAbs( recomputed - kept ) <= 1e-6 * qMax( 1.0, recomputed ),
+                  qPrintable( QString( "slot %1: kept %2, recomputed %3" ).arg( i ).arg( kept ).arg( recomputed ) ) );
+    }
+}
+
+
+void
+BenchShuffler::testIncrementalWeights()
+{
+    qsrand( 2 );
+
+    // few artists and titles, so plenty of songs sound like the history
+    QStringList artists, titles;
+    for ( int i = 0; i < 12; ++i )
+        artists << word();
+    for ( int i = 0; i < 30; ++i )
+        titles << word();
+
+    Shuffler shuffler;
+    shuffler.setSongHistorySize( 40 );
+
+    // half before the first pick, the rest a few at a time between picks so
+    // they're matched against the history as they arrive. Keep picking past
+    // the point where every pick shifts the song history along
+    for ( int i = 0, received = 0; i < 150; ++i )
+    {
+        for ( int wanted = i ? received + 4 : 300; received < wanted; ++received )
+        {
+            QVariantMap map;
+            map["artist"] = artists[qrand() % artists.size()];
+            map["track"] = titles[qrand() % titles.size()];
+            map["url"] = QString( "file:///music/%1.mp3" ).arg( received );
+            map["weight"] = 0.1 + ( qrand() % 100 ) / 100.0;
+            shuffler.receivePlayableItem( BoffinPlayableItem::fromBoffinRqlResult( map ) );
+        }
+
+        QVERIFY( shuffler.sampleOne().isValid() );
+        if ( i % 10 == 9 )
+            verifyWeights( shuffler );
+    }
+}
+
+
+void
+BenchShuffler::benchmark_data()
+{
+    QTest::addColumn<int>( "count" );
+
+    QTest::newRow( "1k" ) << 1000;
+    QTest::newRow( "10k" ) << 10000;
+    QTest::newRow( "100k" ) << 100000;
+}
+
+
+void
+BenchShuffler::benchmark()
+{
+    QFETCH( int, count );
+
+    // enough picks to fill the song history, after which every pick
+    // shifts it along
+    const int picks = 250;
+
+    Shuffler shuffler;
+    fill( shuffler, count );
+
+    QTime time;
+    time.start();
+
+    QBENCHMARK_ONCE
+    {
+        for ( int i = 0; i < picks; ++i )
+            shuffler.sampleOne();
+    }
+
+    qDebug() << count << "items:" << time.elapsed() * 1000.0 / picks << "us per pick";
+}
+
+QTEST_APPLESS_MAIN(BenchShuffler)
+#include "BenchShuffler.moc"
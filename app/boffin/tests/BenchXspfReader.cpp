@@ -0,0 +1,225 @@
+/*
+   Copyright 2013 Last.fm Ltd.
+
+   This file is part of the Last.fm Desktop Application Suite.
+
+   lastfm-desktop is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   lastfm-desktop is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with lastfm-desktop.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <QtTest>
+#include <QDomDocument>
+#include <QTime>
+#include <lastfm/Xspf>
+#include "XspfReader.h"
+
+
+/** The streaming XspfReader against building the whole DOM first, on a
+  * 10,000 track playlist file */
+class BenchXspfReader : public QObject
+{
+    Q_OBJECT
+
+    QString m_path;
+    QList<Track> m_tracks;
+    QString m_title;
+    int m_finished;
+
+    static QByteArray playlist( int count, bool lfm );
+    void read( const QByteArray& data, int chunk );
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void testForms_data();
+    void testForms();
+    void testFirstTrackEarly();
+    void benchmark_data();
+    void benchmark();
+
+    void onTitle( const QString& title ) { m_title = title; }
+    void onTrack( const Track& t ) { m_tracks << t; }
+    void onFinished() { ++m_finished; }
+};
+
+
+QByteArray
+BenchXspfReader::playlist( int count, bool lfm )
+{
+    QString xml = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n";
+    if ( lfm )
+        xml += "<lfm status=\"ok\">\n";
+    xml += "<playlist version=\"1\" xmlns=\"http://xspf.org/ns/0/\">\n"
+           "<title>Mix &amp; Match</title>\n"
+           "<trackList>\n";
+
+    for ( int i = 0; i < count; ++i )
+    {
+        xml += QString( "<track>"
+                        "<location>http://localhost:60210/sid/%1</location>"
+                        "<location>http://example.com/mirror/%1.mp3</location>"
+                        "<title>Track %1</title>"
+                        "<creator>Artist %2</creator>"
+                        "<album>Album %3</album>"
+                        "<duration>%4</duration>"
+                        "<extension application=\"http://www.last.fm\"><title>not this</title></extension>"
+                        "</track>\n" ).arg( i ).arg( i % 500 ).arg( i % 50 ).arg( ( 120 + i % 300 ) * 1000 );
+    }
+
+    xml += "</trackList>\n</playlist>\n";
+    if ( lfm )
+        xml += "</lfm>\n";
+    return xml.toUtf8();
+}
+
+
+void
+BenchXspfReader::read( const QByteArray& data, int chunk )
+{
+    m_tracks.clear();
+    m_title.clear();
+    m_finished = 0;
+
+    XspfReader reader;
+    connect( &reader, SIGNAL(title( QString )), SLOT(onTitle( QString )) );
+    connect( &reader, SIGNAL(track( Track )), SLOT(onTrack( Track )) );
+    connect( &reader, SIGNAL(finished()), SLOT(onFinished()) );
+
+    for ( int i = 0; i < data.size(); i += chunk )
+        reader.addData( data.mid( i, chunk ) );
+    reader.addData( QByteArray() );
+
+    QVERIFY( !reader.hasError() );
+}
+
+
+void
+BenchXspfReader::initTestCase()
+{
+    m_path = QDir::temp().filePath( QString( "bench_xspfreader_%1.xspf" ).arg( QCoreApplication::applicationPid() ) );
+
+    QFile file( m_path );
+    QVERIFY( file.open( QIODevice::WriteOnly ) );
+    file.write( playlist( 10000, false ) );
+}
+
+
+void
+BenchXspfReader::cleanupTestCase()
+{
+    QFile::remove( m_path );
+}
+
+
+void
+BenchXspfReader::testForms_data()
+{
+    QTest::addColumn<bool>( "lfm" );
+    QTest::newRow( "playlist" ) << false;
+    QTest::newRow( "lfm" ) << true;
+}
+
+
+void
+BenchXspfReader::testForms()
+{
+    QFETCH( bool, lfm );
+
+    // a byte at a time breaks the stream everywhere it can be broken
+    read( playlist( 3, lfm ), 1 );
+
+    QCOMPARE( m_finished, 1 );
+    QCOMPARE( m_title, QString( "Mix & Match" ) );
+    QCOMPARE( m_tracks.count(), 3 );
+    QCOMPARE( (QString) m_tracks[2].title(), QString( "Track 2" ) );
+    QCOMPARE( (QString) m_tracks[2].artist(), QString( "Artist 2" ) );
+    QCOMPARE( (QString) m_tracks[2].album(), QString( "Album 2" ) );
+    QCOMPARE( m_tracks[2].duration(), 122 );
+    QCOMPARE( m_tracks[2].url(), QUrl( "http://localhost:60210/sid/2" ) );
+}
+
+
+void
+BenchXspfReader::testFirstTrackEarly()
+{
+    QByteArray const data = playlist( 10000, true );
+
+    m_tracks.clear();
+    XspfReader reader;
+    connect( &reader, SIGNAL(track( Track )), SLOT(onTrack( Track )) );
+
+    reader.addData( data.left( 4096 ) );
+    QVERIFY( m_tracks.count() > 0 );
+    QCOMPARE( (QString) m_tracks[0].title(), QString( "Track 0" ) );
+}
+
+
+void
+BenchXspfReader::benchmark_data()
+{
+    QTest::addColumn<bool>( "streaming" );
+    QTest::newRow( "dom" ) << false;
+    QTest::newRow( "streaming" ) << true;
+}
+
+
+void
+BenchXspfReader::benchmark()
+{
+    QFETCH( bool, streaming );
+
+    QFile file( m_path );
+    QVERIFY( file.open( QIODevice::ReadOnly ) );
+    QByteArray const data = file.readAll();
+
+    int count = 0;
+    QBENCHMARK
+    {
+        if ( streaming )
+        {
+            read( data, 16 * 1024 );
+            count = m_tracks.count();
+        }
+        else
+        {
+            // what XspfReader used to do once the download finished
+            QDomDocument xmldoc;
+            xmldoc.setContent( data );
+            lastfm::Xspf xspf( xmldoc.documentElement() );
+            count = xspf.tracks().count();
+        }
+    }
+    QCOMPARE( count, 10000 );
+
+    // how long before playback could start
+    QTime time;
+    time.start();
+    if ( streaming )
+    {
+        m_tracks.clear();
+        XspfReader reader;
+        connect( &reader, SIGNAL(track( Track )), SLOT(onTrack( Track )) );
+        for ( int i = 0; m_tracks.isEmpty() && i < data.size(); i += 16 * 1024 )
+            reader.addData( data.mid( i, 16 * 1024 ) );
+    }
+    else
+    {
+        QDomDocument xmldoc;
+        xmldoc.setContent( data );
+        lastfm::Xspf xspf( xmldoc.documentElement() );
+    }
+    qDebug() << "first track after" << time.elapsed() << "ms";
+}
+
+
+QTEST_APPLESS_MAIN( BenchXspfReader )
+#include "BenchXspfReader.moc"
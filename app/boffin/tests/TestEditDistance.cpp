@@ -0,0 +1,200 @@
+/*
+   Copyright 2013 Last.fm Ltd.
+
+   This file is part of the Last.fm Desktop Application Suite.
+
+   lastfm-desktop is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   lastfm-desktop is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with lastfm-desktop.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <QtTest>
+#include "EditDistance.h"
+
+
+class TestEditDistance : public QObject
+{
+    Q_OBJECT
+
+    static QString randomString( int maxLength, int alphabet, bool wide );
+    static QString mutate( QString s, int edits, int alphabet );
+    static QStringList names();
+
+private slots:
+    void testTranspositions();
+    void testMatchesDP_data();
+    void testMatchesDP();
+    void benchmark_data();
+    void benchmark();
+};
+
+
+QString
+TestEditDistance::randomString( int maxLength, int alphabet, bool wide )
+{
+    QString s;
+    int length = maxLength ? qrand() % maxLength : 0;
+    for ( int i = 0; i < length; ++i )
+        s += QChar( ( wide && qrand() % 3 == 0 ? 0x4e00 : 'a' ) + qrand() % alphabet );
+    return s;
+}
+
+
+/** insertions, deletions, substitutions and swaps */
+QString
+TestEditDistance::mutate( QString s, int edits, int alphabet )
+{
+    for ( int e = 0; e < edits; ++e )
+    {
+        int pos = s.isEmpty() ? 0 : qrand() % s.length();
+        QChar c( 'a' + qrand() % alphabet );
+
+        switch ( qrand() % 4 )
+        {
+            case 0: s.insert( pos, c ); break;
+            case 1: s.remove( pos, 1 ); break;
+            case 2: if ( !s.isEmpty() ) s[pos] = c; break;
+            case 3:
+                if ( pos + 1 < s.length() )
+                {
+                    QChar t = s[pos];
+                    s[pos] = s[pos + 1];
+                    s[pos + 1] = t;
+                }
+                break;
+        }
+    }
+    return s;
+}
+
+
+/** artists and titles as they appear in people's collections */
+QStringList
+TestEditDistance::names()
+{
+    const char* names[] = {
+        "radiohead", "radio head", "paranoid android", "paranoid android (live)",
+        "the beatles", "beatles", "a day in the life", "a day in teh life",
+        "red hot chili peppers", "red hot chilli peppers", "under the bridge",
+        "the smashing pumpkins", "smashing pumpkins", "1979", "tonight, tonight",
+        "queens of the stone age", "no one knows", "go with the flow",
+        "arcade fire", "neighborhood #1 (tunnels)", "neighbourhood #1 (tunnels)",
+        "sigur r\xc3\xb3s", "sigur ros", "hopp\xc3\xadpolla", "hoppipolla",
+        "bj\xc3\xb6rk", "bjork", "all is full of love", "j\xc3\xb3ga",
+        "godspeed you! black emperor", "storm", "sleep",
+        "the national", "fake empire", "bloodbuzz ohio",
+        "yeah yeah yeahs", "maps", "bon iver", "skinny love",
+        "everything in its right place", "everything in it's right place"
+    };
+
+    QStringList list;
+    for ( unsigned i = 0; i < sizeof( names ) / sizeof( names[0] ); ++i )
+        list << QString::fromUtf8( names[i] );
+    return list;
+}
+
+
+void
+TestEditDistance::testTranspositions()
+{
+    // playdar doesn't count a swap involving the first character as one edit
+    QCOMPARE( levenshtein( "ab", "ba" ), 2 );
+    QCOMPARE( levenshtein( "abc", "bac" ), 2 );
+    QCOMPARE( levenshtein( "abc", "acb" ), 1 );
+    QCOMPARE( levenshtein( "the life", "teh life" ), 1 );
+
+    QCOMPARE( levenshtein( "", "abc" ), 3 );
+    QCOMPARE( levenshtein( "abc", "" ), 3 );
+    QCOMPARE( levenshtein( "kitten", "sitting", 1 ), 2 );
+}
+
+
+void
+TestEditDistance::testMatchesDP_data()
+{
+    QTest::addColumn<int>( "maxLength" );
+    QTest::addColumn<bool>( "wide" );
+
+    // over 64 characters takes the multi word path
+    QTest::newRow( "short" ) << 20 << false;
+    QTest::newRow( "short non latin1" ) << 20 << true;
+    QTest::newRow( "long" ) << 200 << false;
+    QTest::newRow( "long non latin1" ) << 200 << true;
+}
+
+
+void
+TestEditDistance::testMatchesDP()
+{
+    QFETCH( int, maxLength );
+    QFETCH( bool, wide );
+
+    qsrand( 1 );
+
+    for ( int i = 0; i < 20000; ++i )
+    {
+        int alphabet = 1 + qrand() % 6;
+        QString a = randomString( maxLength, alphabet, wide );
+        QString b = qrand() % 2 ? mutate( a, qrand() % 6, alphabet ) : randomString( maxLength, alphabet, wide );
+
+        int expected = levenshteinDP( a, b );
+        int max = qrand() % 10;
+
+        if ( levenshtein( a, b ) != expected || levenshtein( a, b, max ) != qMin( expected, max + 1 ) )
+        {
+            QCOMPARE( levenshtein( a, b ), expected );
+            QCOMPARE( levenshtein( a, b, max ), qMin( expected, max + 1 ) );
+        }
+    }
+}
+
+
+void
+TestEditDistance::benchmark_data()
+{
+    QTest::addColumn<int>( "method" );
+
+    QTest::newRow( "dynamic programming" ) << 0;
+    QTest::newRow( "bit parallel" ) << 1;
+    QTest::newRow( "bit parallel, bounded" ) << 2;
+}
+
+
+void
+TestEditDistance::benchmark()
+{
+    QFETCH( int, method );
+
+    QStringList list = names();
+    int sum = 0;
+
+    QBENCHMARK
+    {
+        foreach ( const QString& a, list )
+        {
+            foreach ( const QString& b, list )
+            {
+                if ( method == 0 )
+                    sum += levenshteinDP( a, b );
+                else if ( method == 1 )
+                    sum += levenshtein( a, b );
+                else
+                    // what Shuffler allows for a name this long
+                    sum += levenshtein( a, b, a.length() > 6 ? int( a.length() / 1.5 ) : a.length() - 1 );
+            }
+        }
+    }
+
+    QVERIFY( sum > 0 );
+}
+
+QTEST_APPLESS_MAIN(TestEditDistance)
+#include "TestEditDistance.moc"
@@ -0,0 +1,16 @@
+TEMPLATE = app
+TARGET = bench_collectionscanner
+QT = core testlib
+CONFIG += lastfm
+CONFIG -= app_bundle
+INCLUDEPATH += ..
+include( ../../../admin/include.qmake )
+
+DEFINES += LASTFM_COLLAPSE_NAMESPACE
+
+SOURCES = BenchCollectionScanner.cpp \
+          ../LocalCollectionScanner.cpp \
+          ../TagReader.cpp
+
+HEADERS = ../LocalCollectionScanner.h \
+          ../TagReader.h
@@ -0,0 +1,14 @@
+TEMPLATE = app
+TARGET = bench_cometparser
+QT = core testlib
+CONFIG += boost yajl
+CONFIG -= app_bundle
+INCLUDEPATH += ..
+include( ../../../admin/include.qmake )
+
+SOURCES = BenchCometParser.cpp \
+          ../comet/CometParser.cpp \
+          ../comet/CometResult.cpp
+
+HEADERS = ../comet/CometParser.h \
+          ../comet/CometResult.h
@@ -0,0 +1,17 @@
+TEMPLATE = app
+TARGET = bench_shuffler
+QT = core testlib
+CONFIG += boost
+CONFIG -= app_bundle
+INCLUDEPATH += ..
+include( ../../../admin/include.qmake )
+
+SOURCES = BenchShuffler.cpp \
+          ../Shuffler.cpp \
+          ../EditDistance.cpp \
+          ../playdar/BoffinPlayableItem.cpp \
+          ../playdar/jsonGetMember.cpp \
+          ../comet/CometResult.cpp
+
+HEADERS = ../Shuffler.h \
+          ../sample/FenwickSampler.h
@@ -0,0 +1,14 @@
+TEMPLATE = app
+TARGET = bench_xspfreader
+QT = core network xml testlib
+CONFIG += lastfm
+CONFIG -= app_bundle
+INCLUDEPATH += ..
+include( ../../../admin/include.qmake )
+
+DEFINES += LASTFM_COLLAPSE_NAMESPACE
+
+SOURCES = BenchXspfReader.cpp \
+          ../XspfReader.cpp
+
+HEADERS = ../XspfReader.h
@@ -0,0 +1,11 @@
+TEMPLATE = app
+TARGET = test_editdistance
+QT = core testlib
+CONFIG -= app_bundle
+INCLUDEPATH += ..
+include( ../../../admin/include.qmake )
+
+SOURCES = TestEditDistance.cpp \
+          ../EditDistance.cpp
+
+HEADERS = ../EditDistance.h
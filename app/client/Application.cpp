@@ -67,6 +67,7 @@
 #include "Application.h"
 #include "MainWindow.h"
 #include "AudioscrobblerSettings.h"
+#include "lib/unicorn/SettingsSnapshot.h"
 
 #if !defined(Q_OS_WIN) && !defined(Q_OS_MAC)
 #include "Mpris2/Mpris2.h"
@@ -281,8 +282,7 @@ Application::init()
 
     m_submit_scrobbles_toggle = menu->addAction( tr("Enable Scrobbling") );
     m_submit_scrobbles_toggle->setCheckable( true );
-    bool scrobblingOn = unicorn::UserSettings().value( "scrobblingOn", true ).toBool();
-    m_submit_scrobbles_toggle->setChecked( scrobblingOn );
+    m_submit_scrobbles_toggle->setChecked( unicorn::SettingsStore::snapshot().scrobblingOn );
     ScrobbleService::instance().scrobbleSettingsChanged();
 
     connect( m_submit_scrobbles_toggle, SIGNAL(toggled(bool)), SLOT(onScrobbleToggled(bool)) );
@@ -405,7 +405,7 @@ Application::setTrayIcon()
 {
     if ( m_tray )
     {
-        bool scrobblingOn = unicorn::UserSettings().value( "scrobblingOn", true ).toBool();
+        bool scrobblingOn = unicorn::SettingsStore::snapshot().scrobblingOn;
 
         QIcon trayIcon( scrobblingOn ? AS_TRAY_ICON : AS_TRAY_ICON_OFF );
 #ifdef Q_WS_MAC
@@ -719,9 +719,9 @@ Application::changeLovedState(bool loved)
 void
 Application::onScrobbleToggled( bool scrobblingOn )
 {
-    if ( unicorn::UserSettings().value( "scrobblingOn", true ) != scrobblingOn )
+    if ( unicorn::SettingsStore::snapshot().scrobblingOn != scrobblingOn )
     {
-        unicorn::UserSettings().setValue( "scrobblingOn", scrobblingOn );
+        unicorn::SettingsStore::instance().setUserValue( "scrobblingOn", scrobblingOn );
         AnalyticsService::instance().sendEvent(SETTINGS_CATEGORY, SCROBBLING_SETTINGS, scrobblingOn ? "ScrobbleTurnedOn" : "ScrobbleTurnedOff" );
     }
 
@@ -21,10 +21,12 @@
 */
 #include "AacSource.h"
 #include "AacSource_p.h"
+#include "common/c++/SilenceDetection.h"
 
 #include <QFile>
 #include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <limits>
 #include <iostream>
 #include <stdexcept>
@@ -105,6 +107,8 @@ static int adts_sample_rates[] =
 
 AAC_ADTS_File::AAC_ADTS_File( const QString& fileName, int headerType ) : AAC_File(fileName, headerType)
     , m_file( NULL )
+    , m_indexSamplerate( 0 )
+    , m_indexPayload( 0 )
     , m_adifSamplerate( 0 )
     , m_adifChannels( 0 )
 {
@@ -205,6 +209,55 @@ void AAC_ADTS_File::parse( FILE*& fp, unsigned char*& buf, size_t& bufSize, int
 }
 
 
+/** Records where every frame starts by reading only the frame headers and
+  * seeking over the rest, so the decoder never runs. */
+void AAC_ADTS_File::buildIndex()
+{
+    m_frameOffsets.clear();
+    m_indexSamplerate = 0;
+    m_indexPayload = 0;
+
+    FILE* fp = fopen( QFile::encodeName(m_fileName), "rb" );
+    if ( !fp )
+        return;
+
+    unsigned char header[10];
+    long offset = 0;
+
+    if ( fread( header, 1, 10, fp ) == 10 && !memcmp( header, "ID3", 3 ) )
+    {
+        /* high bit is not used */
+        offset = ( (header[6] << 21) | (header[7] << 14) |
+                   (header[8] <<  7) | (header[9] <<  0) ) + 10;
+    }
+
+    while ( fseek( fp, offset, SEEK_SET ) == 0
+            && fread( header, 1, ADTS_HEADER_SIZE, fp ) == ADTS_HEADER_SIZE )
+    {
+        // stops at trailing TAG, LYRICS or APE tags too
+        if ( !( (header[0] == 0xFF) && ((header[1] & 0xF6) == 0xF0) ) )
+            break;
+
+        int samplerate = adts_sample_rates[ (header[2] & 0x3c) >> 2 ];
+        long frameLength = ( ( header[3] & 0x3 ) << 11 )
+                           | ( header[4] << 3 )
+                           | ( header[5] >> 5 );
+
+        if ( samplerate <= 0 || frameLength < ADTS_HEADER_SIZE )
+            break;
+
+        if ( m_frameOffsets.empty() )
+            m_indexSamplerate = samplerate;
+
+        m_frameOffsets.push_back( offset );
+        m_indexPayload += frameLength - ADTS_HEADER_SIZE;
+        offset += frameLength;
+    }
+
+    fclose( fp );
+}
+
+
 int32_t AAC_ADTS_File::commonSetup( FILE*& fp, NeAACDecHandle& decoder, unsigned char*& buf, size_t& bufSize, unsigned long& samplerate, unsigned char& channels )
 {
     samplerate = 0;
@@ -281,6 +334,9 @@ bool AAC_ADTS_File::init()
         m_adifSamplerate = initSamplerate;
         m_adifChannels = initChannels;
 
+        if ( m_header == AAC_ADTS )
+            buildIndex();
+
         return true;
      }
 
@@ -315,7 +371,15 @@ void AAC_ADTS_File::getInfo( int& lengthSecs, int& samplerate, int& bitrate, int
     fileread = ftell( fp );
     fseek( fp, origpos, SEEK_SET );
 
-    if ( (tempBuf[0] == 0xFF) && ((tempBuf[1] & 0xF6) == 0xF0) )
+    if ( !m_frameOffsets.empty() )
+    {
+        // init() has already been through every header
+        double framesPerSec = m_indexSamplerate / 1024.0;
+        double bytesPerFrame = m_indexPayload / m_frameOffsets.size();
+        bitrate = static_cast<int>(8 * bytesPerFrame * framesPerSec + 0.5);
+        initLength = m_frameOffsets.size() / framesPerSec;
+    }
+    else if ( (tempBuf[0] == 0xFF) && ((tempBuf[1] & 0xF6) == 0xF0) )
     {
         parse( fp, tempBuf, tempBufSize, bitrate, initLength );
     }
@@ -348,7 +412,23 @@ void AAC_ADTS_File::getInfo( int& lengthSecs, int& samplerate, int& bitrate, int
 
 void AAC_ADTS_File::skip( const int mSecs )
 {
-    if ( m_header == AAC_ADTS )
+    if ( m_header == AAC_ADTS && !m_frameOffsets.empty() )
+    {
+        // The first frame we haven't handed to the decoder yet
+        long pos = ftell( m_file ) - static_cast<long>(m_inBufSize);
+        size_t frame = std::lower_bound( m_frameOffsets.begin(), m_frameOffsets.end(), pos ) - m_frameOffsets.begin();
+
+        // the same number of frames the header walk below would pass over
+        frame += static_cast<size_t>( std::ceil( mSecs / 1000.0 * m_indexSamplerate / 1024.0 ) );
+
+        if ( frame < m_frameOffsets.size() )
+            fseek( m_file, m_frameOffsets[frame], SEEK_SET );
+        else
+            fseek( m_file, 0, SEEK_END );
+
+        m_inBufSize = fread( m_inBuf, 1, FAAD_MIN_STREAMSIZE * MAX_CHANNELS, m_file );
+    }
+    else if ( m_header == AAC_ADTS )
     {
         // As AAC is VBR we need to check all ADTS headers to enable seeking...
         // There is no other solution
@@ -461,6 +541,7 @@ AAC_MP4_File::AAC_MP4_File( const QString& fileName, int headerType ) : AAC_File
     , m_mp4SampleId( 0 )
     , m_mp4File ( NULL )
     , m_mp4cb ( NULL )
+    , m_unitsPerMSec( 0 )
 {
 }
 
@@ -670,10 +751,43 @@ bool AAC_MP4_File::init()
     if ( buffer )
         free( buffer );
 
+    buildIndex();
+
     return true;
 }
 
 
+/** Every sample's start time comes from the stts box mp4ff has already
+  * loaded, so this doesn't touch the file. */
+void AAC_MP4_File::buildIndex()
+{
+    int32_t totalSamples = mp4ff_num_samples( m_mp4File, m_mp4AudioTrack );
+
+    m_sampleStart.clear();
+    m_sampleStart.reserve( totalSamples + 1 );
+    m_sampleStart.push_back( 0 );
+
+    for ( int32_t i = 0; i < totalSamples; ++i )
+        m_sampleStart.push_back( m_sampleStart.back() + mp4ff_get_sample_duration( m_mp4File, m_mp4AudioTrack, i ) );
+
+    // I think the f multiplier is needed here.
+    unsigned char *buff = NULL;
+    unsigned int buff_size = 0;
+    mp4AudioSpecificConfig mp4ASC;
+    m_unitsPerMSec = 0;
+
+    mp4ff_get_decoder_config( m_mp4File, m_mp4AudioTrack, &buff, &buff_size );
+
+    if ( buff )
+    {
+        int8_t rc = NeAACDecAudioSpecificConfig( buff, buff_size, &mp4ASC );
+        free( buff );
+        if ( rc >= 0 )
+            m_unitsPerMSec = mp4ASC.samplingFrequency / ( 1000.0 * ( mp4ASC.sbr_present_flag == 1 ? 2 : 1 ) );
+    }
+}
+
+
 void AAC_MP4_File::postDecode(unsigned long)
 {
             free( m_inBuf );
@@ -683,6 +797,15 @@ void AAC_MP4_File::postDecode(unsigned long)
 
 void AAC_MP4_File::skip( const int mSecs )
 {
+    if ( m_unitsPerMSec > 0 && m_mp4SampleId < m_sampleStart.size() )
+    {
+        // the first sample that starts at least mSecs after this one
+        uint64_t target = m_sampleStart[m_mp4SampleId] + static_cast<uint64_t>( std::ceil( mSecs * m_unitsPerMSec ) );
+        m_mp4SampleId = std::lower_bound( m_sampleStart.begin() + m_mp4SampleId, m_sampleStart.end(), target ) - m_sampleStart.begin();
+        m_mp4SampleId = std::min<uint32_t>( m_mp4SampleId, m_sampleStart.size() - 1 );
+        return;
+    }
+
     double dur = 0.0;
     int f = 1;
     unsigned char *buff = NULL;
@@ -841,8 +964,6 @@ void AacSource::skipSilence(double silenceThreshold /* = 0.0001 */)
     if ( !m_aacFile->m_decoder )
         return;
 
-    silenceThreshold *= static_cast<double>( std::numeric_limits<short>::max() );
-
     for (;;)
     {
         if ( m_aacFile->m_header == AAC_File::AAC_MP4 )
@@ -862,20 +983,8 @@ void AacSource::skipSilence(double silenceThreshold /* = 0.0001 */)
         }
         else if ( frameInfo.samples > 0 )
         {
-            double sum = 0;
-            int16_t *buf = static_cast<int16_t*>(sampleBuffer);
-            switch ( frameInfo.channels )
-            {
-                case 1:
-                    for (size_t j = 0; j < frameInfo.samples; ++j)
-                        sum += abs( buf[j] );
-                    break;
-                case 2:
-                    for (size_t j = 0; j < frameInfo.samples; j+=2)
-                        sum += abs( (buf[j] >> 1) + (buf[j+1] >> 1) );
-                    break;
-            }
-            if ( (sum >= silenceThreshold * static_cast<short>(frameInfo.samples/frameInfo.channels) ) )
+            if ( !SilenceDetection::isSilent( static_cast<short*>(sampleBuffer), frameInfo.samples/frameInfo.channels,
+                                              frameInfo.channels, silenceThreshold ) )
                 break;
         }
     }
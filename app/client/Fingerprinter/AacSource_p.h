@@ -20,6 +20,7 @@
 
 #include <faad.h>
 #include <mp4ff.h>
+#include <vector>
 
 class AAC_File
 {
@@ -65,10 +66,16 @@ public:
 private:
     bool commonSetup( NeAACDecHandle& handle, mp4ff_callback_t*& cb, FILE*& fp, mp4ff_t*& mp4, int32_t& audioTrack );
     virtual int32_t getTrack( const mp4ff_t* f );
+    void buildIndex();
     int32_t m_mp4AudioTrack;
     uint32_t m_mp4SampleId;
     mp4ff_t *m_mp4File;
     mp4ff_callback_t *m_mp4cb;
+
+    // m_sampleStart[i] is when sample i starts, in the track's time units.
+    // It has one more entry than there are samples: the end of the track
+    std::vector<uint64_t> m_sampleStart;
+    double m_unitsPerMSec;
 };
 
 
@@ -87,8 +94,16 @@ private:
     int32_t commonSetup( FILE*& fp, NeAACDecHandle& decoder, unsigned char*& buf, size_t& bufSize, unsigned long& samplerate, unsigned char& channels );
     void parse( FILE*& fp, unsigned char*& buf, size_t& bufSize, int &bitrate, double &length );
     void fillBuffer( FILE*& fp, unsigned char*& buf, size_t& bufSize, const size_t m_bytesConsumed );
+    void buildIndex();
 
     FILE* m_file;
+
+    // Where each ADTS frame starts in the file. Every frame holds 1024
+    // samples, so frame n starts n * 1024 / m_indexSamplerate seconds in
+    std::vector<long> m_frameOffsets;
+    int m_indexSamplerate;
+    long m_indexPayload;
+
     // These two only needed for skipping AAC ADIF files
     uint32_t m_adifSamplerate;
     int m_adifChannels;
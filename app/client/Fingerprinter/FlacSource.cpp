@@ -18,6 +18,8 @@
    along with liblastfm.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "FlacSource.h"
+#include "common/c++/PcmConversion.h"
+#include "common/c++/SilenceDetection.h"
 #include <algorithm>
 #include <cassert>
 #include <errno.h>
@@ -40,28 +42,37 @@ FLAC__StreamDecoderWriteStatus FlacSource::_write_callback(const FLAC__StreamDec
 FLAC__StreamDecoderWriteStatus FlacSource::write_callback(const FLAC__Frame *frame, const FLAC__int32 * const buffer[])
 {
     m_outBufLen = 0;
+    m_outBufPos = 0;
 
-    if ( m_outBuf )
+    const unsigned channels = frame->header.channels;
+    const size_t nSamples = frame->header.blocksize * PcmConversion::outputChannels( channels );
+
+    // Convert the whole frame at once, straight into updateBuffer's caller
+    // if there's room, otherwise into m_outBuf for the next calls
+    short* out = m_direct;
+
+    if ( !m_direct || nSamples > m_directRoom )
     {
-        size_t i;
-        for(i = 0; i < frame->header.blocksize; i++)
+        if ( nSamples > m_outBufSize )
         {
-            switch ( m_channels )
-            {
-                case 1:
-                    m_outBuf[m_outBufLen] = (FLAC__int16)buffer[0][i]; // mono
-                    m_outBufLen++;
-                    break;
-                case 2:
-                    m_outBuf[m_outBufLen] = (FLAC__int16)buffer[0][i]; // left channel
-                    m_outBuf[m_outBufLen+1] = (FLAC__int16)buffer[1][i]; // right channel
-                    m_outBufLen += 2;
-                    break;
-            }
+            // the STREAMINFO block size was wrong or missing
+            m_outBuf = static_cast<short*>(realloc( m_outBuf, sizeof(short) * nSamples ));
+            m_outBufSize = m_outBuf ? nSamples : 0;
+            if ( !m_outBuf )
+                return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
         }
-        m_samplePos += frame->header.blocksize;
+        out = m_outBuf;
     }
 
+    PcmConversion::toInterleaved16( buffer, channels, frame->header.bits_per_sample, frame->header.blocksize, out );
+
+    if ( out == m_direct )
+        m_directLen = nSamples;
+    else
+        m_outBufLen = nSamples;
+
+    m_samplePos += frame->header.blocksize;
+
     return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
 }
 
@@ -84,7 +95,7 @@ void FlacSource::metadata_callback( const FLAC__StreamMetadata *metadata )
             m_totalSamples = metadata->data.stream_info.total_samples;
             m_samplerate = metadata->data.stream_info.sample_rate;
             m_bps = metadata->data.stream_info.bits_per_sample;
-            m_maxFrameSize = metadata->data.stream_info.max_framesize;
+            m_maxBlockSize = metadata->data.stream_info.max_blocksize;
             break;
         case FLAC__METADATA_TYPE_VORBIS_COMMENT:
             m_commentData = FLAC__metadata_object_clone(metadata);
@@ -115,10 +126,14 @@ FlacSource::FlacSource()
     : m_decoder( 0 )
     , m_fileSize( 0 )
     , m_outBuf( 0 )
+    , m_outBufSize( 0 )
     , m_outBufLen( 0 )
     , m_outBufPos( 0 )
+    , m_direct( 0 )
+    , m_directRoom( 0 )
+    , m_directLen( 0 )
     , m_samplePos( 0 )
-    , m_maxFrameSize( 0 )
+    , m_maxBlockSize( 0 )
     , m_commentData( 0 )
     , m_bps( 0 )
     , m_channels( 0 )
@@ -182,16 +197,19 @@ void FlacSource::init(const QString& fileName)
                 return;
 
             FLAC__stream_decoder_process_until_end_of_metadata( m_decoder );
-            m_outBuf = static_cast<signed short*>(malloc( sizeof(signed short)*m_maxFrameSize));
 
-            if ( m_bps != 16 )
+            // big enough for any frame once it's mixed down to stereo
+            m_outBufSize = m_maxBlockSize * PcmConversion::outputChannels( m_channels );
+            m_outBuf = static_cast<signed short*>(malloc( sizeof(signed short)*m_outBufSize));
+
+            if ( m_bps < 4 || m_bps > 32 )
             {
                 FLAC__stream_decoder_finish( m_decoder );
                 FLAC__stream_decoder_delete( m_decoder );
                 FLAC__metadata_object_delete( m_commentData );
                 m_decoder = 0;
                 m_commentData = 0;
-                throw std::runtime_error( "ERROR: only 16 bit FLAC files are currently supported!" );
+                throw std::runtime_error( "ERROR: unsupported FLAC sample size!" );
             }
         }
         else
@@ -233,7 +251,8 @@ void FlacSource::getInfo(int& lengthSecs, int& samplerate, int& bitrate, int& nc
     if ( m_decoder )
     {
         samplerate = m_samplerate;
-        nchannels = m_channels;
+        // we mix anything over two channels down to stereo
+        nchannels = PcmConversion::outputChannels( m_channels );
         if ( samplerate > 0 )
             lengthSecs = static_cast<int>( static_cast<double>(m_totalSamples)/m_samplerate + 0.5);
 
@@ -262,34 +281,25 @@ void FlacSource::skip( const int mSecs )
     if ( !FLAC__stream_decoder_seek_absolute(m_decoder, absSample) )
         FLAC__stream_decoder_reset( m_decoder );
     m_outBufLen = 0;
+    m_outBufPos = 0;
 }
 
 // ---------------------------------------------------------------------
 
 void FlacSource::skipSilence(double silenceThreshold /* = 0.0001 */)
 {
-    silenceThreshold *= static_cast<double>( std::numeric_limits<short>::max() );
     for ( ;; )
     {
-        double sum = 0;
         bool result = FLAC__stream_decoder_process_single( m_decoder );
         // there was a fatal read
-        if ( !result )
+        if ( !result || m_channels == 0 )
             break;
 
-        switch ( m_channels )
-        {
-            case 1:
-                for (size_t j = 0; j < m_outBufLen; ++j)
-                    sum += abs( m_outBuf[j] );
-                break;
-            case 2:
-                for ( size_t j = 0; j < m_outBufLen; j+=2 )
-                    sum += abs( (m_outBuf[j] >> 1)
-                                + (m_outBuf[j+1] >> 1) );
-                break;
-        }
-        if ( (sum >= silenceThreshold * static_cast<double>(m_outBufLen) ) )
+        const int channels = PcmConversion::outputChannels( m_channels );
+        if ( m_outBufLen > 0 && !SilenceDetection::isSilent( m_outBuf, m_outBufLen / channels, channels, silenceThreshold ) )
+            break;
+
+        if ( FLAC__stream_decoder_get_state( m_decoder ) == FLAC__STREAM_DECODER_END_OF_STREAM )
             break;
     }
     m_outBufLen = 0;
@@ -301,37 +311,41 @@ int FlacSource::updateBuffer( signed short *pBuffer, size_t bufferSize )
 {
     size_t nwrit = 0;
 
-    for ( ;; )
+    while ( nwrit < bufferSize )
     {
-        size_t samples_to_use = std::min (bufferSize - nwrit, m_outBufLen - m_outBufPos);
-        signed short* pBufferIt = pBuffer + nwrit;
+        // whatever is left of the last frame first
+        if ( m_outBufPos < m_outBufLen )
+        {
+            size_t samples_to_use = std::min( bufferSize - nwrit, m_outBufLen - m_outBufPos );
+            memcpy( pBuffer + nwrit, m_outBuf + m_outBufPos, sizeof(signed short)*samples_to_use );
+            nwrit += samples_to_use;
+            m_outBufPos += samples_to_use;
+            continue;
+        }
+
+        m_direct = pBuffer + nwrit;
+        m_directRoom = bufferSize - nwrit;
+        m_directLen = 0;
+
+        bool result = FLAC__stream_decoder_process_single( m_decoder );
 
-        nwrit += samples_to_use;
+        m_direct = 0;
+        nwrit += m_directLen;
         assert( nwrit <= bufferSize );
-        memcpy( pBufferIt, m_outBuf + m_outBufPos, sizeof(signed short)*samples_to_use );
 
-        if ( samples_to_use < m_outBufLen - m_outBufPos )
-            m_outBufPos = samples_to_use;
-        else
+        // there was a fatal read
+        if ( !result )
         {
-            m_outBufPos = 0;
-            bool result = FLAC__stream_decoder_process_single( m_decoder );
-            // there was a fatal read
-            if ( !result )
-            {
-                std::cerr << "Fatal error decoding FLAC" << std::endl;
-                return 0;
-            }
-            else if ( FLAC__stream_decoder_get_state( m_decoder ) == FLAC__STREAM_DECODER_END_OF_STREAM )
-            {
-                m_eof = true;
-                break;
-            }
+            std::cerr << "Fatal error decoding FLAC" << std::endl;
+            return 0;
+        }
+        else if ( FLAC__stream_decoder_get_state( m_decoder ) == FLAC__STREAM_DECODER_END_OF_STREAM )
+        {
+            m_eof = true;
+            break;
         }
-
-        if ( nwrit == bufferSize )
-            return static_cast<int>(nwrit);
     }
+
     return static_cast<int>(nwrit);
 }
 
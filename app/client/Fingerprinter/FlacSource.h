@@ -57,10 +57,18 @@ private:
     QString m_fileName;
     size_t m_fileSize;
     short *m_outBuf;
+    size_t m_outBufSize;
     size_t m_outBufLen;
     size_t m_outBufPos;
+
+    // While updateBuffer is decoding, the room left in its caller's
+    // buffer. write_callback converts frames that fit straight into it.
+    short *m_direct;
+    size_t m_directRoom;
+    size_t m_directLen;
+
     FLAC__uint64 m_samplePos;
-    unsigned m_maxFrameSize;
+    unsigned m_maxBlockSize;
     FLAC__StreamMetadata* m_commentData;
     unsigned m_bps;
     unsigned m_channels;
@@ -28,7 +28,9 @@
 #include <sstream>
 #include <cassert>
 #include <stdexcept>
+#include <algorithm>
 #include "MadSource.h"
+#include "common/c++/SilenceDetection.h"
 
 #undef max // was definded in mad
 
@@ -39,6 +41,9 @@ using namespace std;
 
 MadSource::MadSource()
           : m_pMP3_Buffer ( new unsigned char[m_MP3_BufferSize+MAD_BUFFER_GUARD] )
+          , m_pMapped( NULL )
+          , m_mappedSize( 0 )
+          , m_mappedEof( false )
 {}
 
 // -----------------------------------------------------------
@@ -47,6 +52,8 @@ MadSource::~MadSource()
 {
    if ( m_inputFile.isOpen() )
    {
+      if ( m_pMapped )
+         m_inputFile.unmap( m_pMapped );
       m_inputFile.close();
       mad_synth_finish(&m_mad_synth);
       mad_frame_finish(&m_mad_frame);
@@ -200,6 +207,14 @@ void MadSource::init(const QString& fileName)
       throw std::runtime_error ("Cannot load mp3 file!");
    }
 
+   // Mapping the file saves copying it through m_pMP3_Buffer. Not every
+   // file can be mapped (pipes, some network filesystems, files too big for
+   // the address space) so keep the buffered path for those.
+   m_mappedSize = m_inputFile.size();
+   m_pMapped = m_mappedSize > 0 ? m_inputFile.map( 0, m_mappedSize ) : NULL;
+   m_mappedEof = false;
+   m_frames.clear();
+
    mad_stream_init(&m_mad_stream);
    mad_frame_init (&m_mad_frame);
    mad_synth_init (&m_mad_synth);
@@ -223,9 +238,8 @@ void MadSource::getInfo(int& lengthSecs, int& samplerate, int& bitrate, int& nch
 {
    // get the header plus some other stuff..
    QFile inputFile(m_fileName);
-   bool fine = inputFile.open( QIODevice::ReadOnly );
 
-   if ( !fine )
+   if ( !m_pMapped && !inputFile.open( QIODevice::ReadOnly ) )
    {
       throw std::runtime_error ("ERROR: Cannot load file for getInfo!");
       return;
@@ -245,8 +259,16 @@ void MadSource::getInfo(int& lengthSecs, int& samplerate, int& bitrate, int& nch
    double avgNChannels = 0;
    int nFrames = 0;
 
-   while ( fetchData( inputFile, pMP3_Buffer, m_MP3_BufferSize, madStream) )
+   m_frames.clear();
+
+   for (;;)
    {
+      bool more = m_pMapped
+                ? fetchMapped( m_pMapped, m_mappedSize, pMP3_Buffer, m_MP3_BufferSize, madStream )
+                : fetchData( inputFile, pMP3_Buffer, m_MP3_BufferSize, madStream );
+      if ( !more )
+         break;
+
       if ( mad_header_decode(&madHeader, &madStream) != 0 )
       {
          if ( isRecoverable(madStream.error) )
@@ -257,6 +279,15 @@ void MadSource::getInfo(int& lengthSecs, int& samplerate, int& bitrate, int& nch
 
       mad_timer_add(&madTimer, madHeader.duration);
 
+      // the last frame or so is read from the tail buffer, leave it out
+      if ( m_pMapped && madStream.this_frame >= m_pMapped && madStream.this_frame < m_pMapped + m_mappedSize )
+      {
+         FrameInfo frame;
+         frame.offset = madStream.this_frame - m_pMapped;
+         frame.duration = madHeader.duration;
+         m_frames.append( frame );
+      }
+
       avgSamplerate += madHeader.samplerate;
       avgBitrate += madHeader.bitrate;
 
@@ -354,6 +385,68 @@ bool MadSource::fetchData( QFile& mp3File,
    return true;
 }
 
+// -----------------------------------------------------------
+
+
+bool MadSource::fetchMapped( const uchar* pMapped,
+                             qint64 mappedSize,
+                             unsigned char* pTail_Buffer,
+                             const int tail_BufferSize,
+                             mad_stream& madStream )
+{
+   // The whole file goes to libmad in one go
+   if ( madStream.buffer == NULL )
+   {
+      mad_stream_buffer( &madStream, pMapped, static_cast<unsigned long>(mappedSize) );
+      madStream.error = MAD_ERROR_NONE;
+      return true;
+   }
+
+   if ( madStream.error != MAD_ERROR_BUFLEN )
+      return true;
+
+   // We're already decoding the tail, so that's everything
+   if ( madStream.buffer == pTail_Buffer )
+      return false;
+
+   /* libmad needs MAD_BUFFER_GUARD zeroed bytes after the last frame to
+   * decode it, and we can't write past the end of the mapping. So copy
+   * the incomplete frame left at the end into our own buffer and pad that
+   * instead. See {2} in the buffered fetchData.
+   */
+   size_t remaining = 0;
+   if ( madStream.next_frame != NULL )
+      remaining = min( static_cast<size_t>(madStream.bufend - madStream.next_frame),
+                       static_cast<size_t>(tail_BufferSize) );
+
+   if ( remaining == 0 )
+      return false;
+
+   memcpy( pTail_Buffer, madStream.bufend - remaining, remaining );
+   memset( pTail_Buffer + remaining, 0, MAD_BUFFER_GUARD );
+
+   mad_stream_buffer( &madStream, pTail_Buffer,
+                      static_cast<unsigned long>(remaining + MAD_BUFFER_GUARD) );
+
+   madStream.error = MAD_ERROR_NONE;
+
+   return true;
+}
+
+// -----------------------------------------------------------
+
+bool MadSource::fetchData()
+{
+   if ( !m_pMapped )
+      return fetchData( m_inputFile, m_pMP3_Buffer, m_MP3_BufferSize, m_mad_stream );
+
+   if ( fetchMapped( m_pMapped, m_mappedSize, m_pMP3_Buffer, m_MP3_BufferSize, m_mad_stream ) )
+      return true;
+
+   m_mappedEof = true;
+   return false;
+}
+
 // -----------------------------------------------------------------------------
 
 void MadSource::skipSilence(double silenceThreshold /* = 0.0001 */)
@@ -364,11 +457,12 @@ void MadSource::skipSilence(double silenceThreshold /* = 0.0001 */)
    mad_frame_init(&madFrame);
    mad_synth_init (&madSynth);
 
-   silenceThreshold *= static_cast<double>( numeric_limits<short>::max() );
+   // one synthesised frame, mixed down to mono
+   short pcm[1152];
 
    for (;;)
    {
-      if ( !fetchData( m_inputFile, m_pMP3_Buffer, m_MP3_BufferSize, m_mad_stream) )
+      if ( !fetchData() )
          break;
 
       if ( mad_frame_decode(&madFrame, &m_mad_stream) != 0 )
@@ -381,23 +475,17 @@ void MadSource::skipSilence(double silenceThreshold /* = 0.0001 */)
 
       mad_synth_frame (&madSynth, &madFrame);
 
-      double sum = 0;
-
-      switch (madSynth.pcm.channels)
-      {
-      case 1:
+      // mix in fixed point and convert once, so frames near the threshold
+      // land on the same side of it as they always have
+      if ( madSynth.pcm.channels == 2 )
          for (size_t j = 0; j < madSynth.pcm.length; ++j)
-            sum += abs(f2s(madSynth.pcm.samples[0][j]));
-         break;
-      case 2:
+            pcm[j] = f2s( (madSynth.pcm.samples[0][j] >> 1)
+                        + (madSynth.pcm.samples[1][j] >> 1) );
+      else
          for (size_t j = 0; j < madSynth.pcm.length; ++j)
-            sum += abs(f2s(
-                     (madSynth.pcm.samples[0][j] >> 1)
-                   + (madSynth.pcm.samples[1][j] >> 1)));
-         break;
-      }
+            pcm[j] = f2s(madSynth.pcm.samples[0][j]);
 
-      if ( (sum >= silenceThreshold * madSynth.pcm.length) )
+      if ( !SilenceDetection::isSilent( pcm, madSynth.pcm.length, 1, silenceThreshold ) )
          break;
    }
 
@@ -406,17 +494,63 @@ void MadSource::skipSilence(double silenceThreshold /* = 0.0001 */)
 
 // -----------------------------------------------------------------------------
 
+bool MadSource::frameOffsetLess( const FrameInfo& a, const FrameInfo& b )
+{
+   return a.offset < b.offset;
+}
+
+// -----------------------------------------------------------------------------
+
+bool MadSource::skipMapped(const int mSecs)
+{
+   // We can only use the frames getInfo found if we're still decoding
+   // from the mapping
+   const uchar* pos = m_mad_stream.next_frame;
+   if ( m_frames.isEmpty() || pos == NULL || pos < m_pMapped || pos >= m_pMapped + m_mappedSize )
+      return false;
+
+   FrameInfo here;
+   here.offset = pos - m_pMapped;
+
+   const FrameInfo* it = std::lower_bound( m_frames.constBegin(), m_frames.constEnd(), here, frameOffsetLess );
+   mad_timer_t timer = m_mad_timer;
+
+   for ( ; it != m_frames.constEnd(); ++it )
+   {
+      mad_timer_add( &timer, it->duration );
+
+      if ( mad_timer_count( timer, MAD_UNITS_MILLISECONDS ) >= mSecs )
+      {
+         // carry on from the frame after this one, as the header walk would
+         qint64 offset = ( it + 1 != m_frames.constEnd() ) ? ( it + 1 )->offset : m_mappedSize;
+         mad_stream_buffer( &m_mad_stream, m_pMapped + offset,
+                            static_cast<unsigned long>(m_mappedSize - offset) );
+         m_mad_stream.error = MAD_ERROR_NONE;
+         m_mad_timer = timer;
+         return true;
+      }
+   }
+
+   // the target is in the tail, let the header walk deal with it
+   return false;
+}
+
+// -----------------------------------------------------------------------------
+
 void MadSource::skip(const int mSecs)
 {
    if ( mSecs <= 0 )
       return;
 
+   if ( m_pMapped && skipMapped( mSecs ) )
+      return;
+
    mad_header  madHeader;
    mad_header_init(&madHeader);
 
    for (;;)
    {
-      if (!fetchData( m_inputFile, m_pMP3_Buffer, m_MP3_BufferSize, m_mad_stream))
+      if ( !fetchData() )
          break;
 
       if ( mad_header_decode(&madHeader, &m_mad_stream) != 0 )
@@ -452,7 +586,7 @@ int MadSource::updateBuffer(signed short* pBuffer, size_t bufferSize)
       // - we are starting a stream
       if ( m_pcmpos == m_mad_synth.pcm.length )
       {
-         if ( !fetchData( m_inputFile, m_pMP3_Buffer, m_MP3_BufferSize, m_mad_stream) )
+         if ( !fetchData() )
          {
             break; // nothing else to read
          }
@@ -23,6 +23,7 @@
 
 #include <lastfm/FingerprintableSource.h>
 #include <QFile>
+#include <QVector>
 #include <string>
 #include <vector>
 #include <fstream>
@@ -40,14 +41,32 @@ public:
     virtual int updateBuffer(signed short* pBuffer, size_t bufferSize);
     virtual void skip(const int mSecs);
     virtual void skipSilence(double silenceThreshold = 0.0001);
-    virtual bool eof() const { return m_inputFile.atEnd(); }
+    virtual bool eof() const { return m_pMapped ? m_mappedEof : m_inputFile.atEnd(); }
 
 private:
+    struct FrameInfo
+    {
+        qint64 offset;
+        mad_timer_t duration;
+    };
+
+    // feeds m_mad_stream from whichever input we're using
+    bool fetchData();
+
     static bool fetchData( QFile& mp3File,
                            unsigned char* pMP3_Buffer,
                            const int MP3_BufferSize,
                            mad_stream& madStream );
 
+    static bool fetchMapped( const uchar* pMapped,
+                             qint64 mappedSize,
+                             unsigned char* pTail_Buffer,
+                             const int tail_BufferSize,
+                             mad_stream& madStream );
+
+    static bool frameOffsetLess( const FrameInfo& a, const FrameInfo& b );
+    bool skipMapped(const int mSecs);
+
     static bool isRecoverable(const mad_error& error, bool log = false);
 
     static std::string MadErrorString(const mad_error& error);
@@ -63,6 +82,16 @@ private:
     static const int     m_MP3_BufferSize = (5*8192);
     QString              m_fileName;
 
+    // the whole file, if it could be mapped. Otherwise we read it into
+    // m_pMP3_Buffer a chunk at a time
+    uchar*               m_pMapped;
+    qint64               m_mappedSize;
+    bool                 m_mappedEof;
+
+    // every frame header getInfo saw in the mapped file, so skip() needn't
+    // parse them again
+    QVector<FrameInfo>   m_frames;
+
     size_t               m_pcmpos;
 };
 
@@ -18,6 +18,7 @@
    along with liblastfm.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "VorbisSource.h"
+#include "common/c++/SilenceDetection.h"
 #include <QFile>
 #include <cassert>
 #include <cstdlib>
@@ -111,13 +112,11 @@ void VorbisSource::skip( const int mSecs )
 
 void VorbisSource::skipSilence(double silenceThreshold /* = 0.0001 */)
 {
-    silenceThreshold *= static_cast<double>( std::numeric_limits<short>::max() );
-
-    char sampleBuffer[4096];
+    short sampleBuffer[2048];
     int bs = 0;
     for (;;)
     {
-        long charReadBytes = ov_read( &m_vf, sampleBuffer, 4096, isBigEndian, wordSize, isSigned, &bs );
+        long charReadBytes = ov_read( &m_vf, reinterpret_cast<char*>(sampleBuffer), sizeof(sampleBuffer), isBigEndian, wordSize, isSigned, &bs );
 
         // eof
         if ( !charReadBytes )
@@ -132,20 +131,7 @@ void VorbisSource::skipSilence(double silenceThreshold /* = 0.0001 */)
         }
         else if ( charReadBytes > 0 )
         {
-            double sum = 0;
-            char *buf = sampleBuffer;
-            switch ( m_channels )
-            {
-                case 1:
-                    for (long j = 0; j < charReadBytes/wordSize; j++)
-                        sum += abs( buf[j] );
-                    break;
-                case 2:
-                    for (long j = 0; j < charReadBytes/wordSize; j+=2)
-                        sum += abs( (buf[j] >> 1) + (buf[j+1] >> 1) );
-                    break;
-            }
-            if ( sum >= silenceThreshold * static_cast<double>(charReadBytes/wordSize/m_channels) )
+            if ( !SilenceDetection::isSilent( sampleBuffer, charReadBytes/wordSize/m_channels, m_channels, silenceThreshold ) )
                 break;
         }
     }
@@ -18,6 +18,7 @@
    along with lastfm-desktop.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "MediaDevice.h"
+#include "lib/unicorn/SettingsSnapshot.h"
 #include "lib/unicorn/UnicornSettings.h"
 
 #include <lastfm/misc.h>
@@ -69,27 +70,17 @@ MediaDevice::associateDevice( QString username )
 #endif
 
     us.endArray();
+
+    if ( username == unicorn::SettingsStore::snapshot().user )
+        unicorn::SettingsStore::instance().reload();
+
     return true;
 }
 
 bool
 MediaDevice::isDeviceKnown() const
 {
-    unicorn::UserSettings us;
-    int count = us.beginReadArray( "associatedDevices" );
-    QString devId;
-    bool isKnown = false;
-    for ( int i = 0; i < count; i++ )
-    {
-        us.setArrayIndex( i );
-        devId = us.value( "deviceId", "" ).toString();
-        if ( devId == deviceId() )
-        {
-            isKnown = true;
-        }
-    }
-    us.endArray();
-    return isKnown;
+    return unicorn::SettingsStore::snapshot().associatedDevices.contains( deviceId() );
 }
 
 lastfm::User
@@ -28,6 +28,7 @@
 
 #include <lastfm/RadioTuner.h>
 
+#include "lib/unicorn/SettingsSnapshot.h"
 #include "lib/unicorn/UnicornSettings.h"
 
 #include "../../Application.h"
@@ -118,22 +119,7 @@ RadioService::play( const RadioStation& station )
     }
 
     m_station = station;
-
-    if ( m_station.url() == "" )
-    {
-        unicorn::UserSettings us;
-        QString stationUrl = us.value( "lastStationUrl", "" ).toString();
-        QString stationTitle = us.value( "lastStationTitle", tr( "A Radio Station" ) ).toString();
-
-        m_station.setUrl( stationUrl );
-        m_station.setTitle( stationTitle );
-    }
-
-    // Make sure the radio station has the radio options from the settings
-    bool ok;
-    m_station.setRep( unicorn::AppSettings().value( "rep", 0.5 ).toDouble( &ok ) );
-    m_station.setMainstr( unicorn::AppSettings().value( "mainstr", 0.5 ).toDouble( &ok ) );
-    m_station.setDisco( unicorn::AppSettings().value( "disco", false ).toBool() );
+    setStationSettings();
 
     m_tuner = new lastfm::RadioTuner( m_station );
 
@@ -145,6 +131,23 @@ RadioService::play( const RadioStation& station )
     changeState( TuningIn );
 }
 
+void
+RadioService::setStationSettings()
+{
+    const unicorn::SettingsSnapshot& settings = unicorn::SettingsStore::snapshot();
+
+    if ( m_station.url() == "" )
+    {
+        m_station.setUrl( settings.lastStationUrl );
+        m_station.setTitle( settings.lastStationTitle.isNull() ? tr( "A Radio Station" ) : settings.lastStationTitle );
+    }
+
+    // Make sure the radio station has the radio options from the settings
+    m_station.setRep( settings.rep );
+    m_station.setMainstr( settings.mainstr );
+    m_station.setDisco( settings.disco );
+}
+
 // play this radio station after the current track has finished
 void
 RadioService::playNext( const RadioStation& station )
@@ -152,22 +155,7 @@ RadioService::playNext( const RadioStation& station )
     if (m_state == Playing)
     {
         m_station = station;
-
-        if ( m_station.url() == "" )
-        {
-            unicorn::UserSettings us;
-            QString stationUrl = us.value( "lastStationUrl", "" ).toString();
-            QString stationTitle = us.value( "lastStationTitle", tr( "A Radio Station" ) ).toString();
-
-            m_station.setUrl( stationUrl );
-            m_station.setTitle( stationTitle );
-        }
-
-        // Make sure the radio station has the radio options from the settings
-        bool ok;
-        m_station.setRep( unicorn::AppSettings().value( "rep", 0.5 ).toDouble( &ok ) );
-        m_station.setMainstr( unicorn::AppSettings().value( "mainstr", 0.5 ).toDouble( &ok ) );
-        m_station.setDisco( unicorn::AppSettings().value( "disco", false ).toBool() );
+        setStationSettings();
 
         m_tuner->retune( m_station );
     }
@@ -486,9 +474,9 @@ RadioService::setStationName( const QString& s )
 {
     m_station.setTitle( s );
 
-    unicorn::UserSettings us;
-    us.setValue( "lastStationUrl", m_station.url() );
-    us.setValue( "lastStationTitle", m_station.title() );
+    unicorn::SettingsStore& store = unicorn::SettingsStore::instance();
+    store.setUserValue( "lastStationUrl", m_station.url() );
+    store.setUserValue( "lastStationTitle", m_station.title() );
 }
 
 void
@@ -118,6 +118,9 @@ private:
     bool initRadio();
     void deInitRadio();
 
+    /** the last station if m_station has no url, and the radio options */
+    void setStationSettings();
+
     void restoreVolume();
     
     /** emits signals if appropriate */
@@ -0,0 +1,128 @@
+/*
+   Copyright 2005-2009 Last.fm Ltd. 
+      - Primarily authored by Max Howell, Jono Cole and Doug Mansell
+
+   This file is part of the Last.fm Desktop Application Suite.
+
+   lastfm-desktop is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   lastfm-desktop is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with lastfm-desktop.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "ExclusionTrie.h"
+
+#include <QDir>
+
+
+ExclusionTrie::ExclusionTrie()
+    : m_nodes( 1 )
+{
+}
+
+
+ExclusionTrie::ExclusionTrie( const QStringList& dirs )
+{
+    setDirs( dirs );
+}
+
+
+void
+ExclusionTrie::setDirs( const QStringList& dirs )
+{
+    m_nodes.clear();
+    m_nodes.resize( 1 );
+
+    foreach ( const QString& dir, dirs )
+        if ( !dir.isEmpty() )
+            add( dir );
+}
+
+
+void
+ExclusionTrie::add( const QString& dir )
+{
+    QString path = QDir::cleanPath( QDir( dir ).absolutePath() );
+#ifdef Q_OS_WIN
+    path = path.toLower();
+#endif
+
+    int node = 0;
+
+    foreach ( const QString& component, path.split( '/', QString::SkipEmptyParts ) )
+    {
+        // everything below here is excluded already
+        if ( m_nodes[node].excluded )
+            return;
+
+        int child = m_nodes[node].children.value( component, -1 );
+        if ( child == -1 )
+        {
+            child = m_nodes.count();
+            m_nodes[node].children.insert( component, child );
+            m_nodes.append( Node() );
+        }
+        node = child;
+    }
+
+    // forget about any folders we've already seen below this one
+    m_nodes[node].children.clear();
+    m_nodes[node].excluded = true;
+}
+
+
+bool
+ExclusionTrie::isEmpty() const
+{
+    return !m_nodes[0].excluded && m_nodes[0].children.isEmpty();
+}
+
+
+bool
+ExclusionTrie::contains( const QString& pathToTest ) const
+{
+    if ( pathToTest.isEmpty() || isEmpty() )
+        return false;
+
+#ifdef Q_OS_WIN
+    const QString path = pathToTest.toLower();
+#else
+    const QString& path = pathToTest;
+#endif
+
+    const QChar* const data = path.constData();
+    const int length = path.length();
+
+    int node = 0;
+    int start = 0;
+
+    while ( !m_nodes[node].excluded )
+    {
+        while ( start < length && data[start] == '/' )
+            ++start;
+
+        if ( start == length )
+            return false;
+
+        int end = start;
+        while ( end < length && data[end] != '/' )
+            ++end;
+
+        // fromRawData doesn't copy the component out of the path
+        QHash<QString, int>::const_iterator i = m_nodes[node].children.find( QString::fromRawData( data + start, end - start ) );
+        if ( i == m_nodes[node].children.end() )
+            return false;
+
+        node = i.value();
+        start = end;
+    }
+
+    return true;
+}
@@ -0,0 +1,59 @@
+/*
+   Copyright 2005-2009 Last.fm Ltd. 
+      - Primarily authored by Max Howell, Jono Cole and Doug Mansell
+
+   This file is part of the Last.fm Desktop Application Suite.
+
+   lastfm-desktop is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   lastfm-desktop is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with lastfm-desktop.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef EXCLUSION_TRIE_H
+#define EXCLUSION_TRIE_H
+
+#include <QHash>
+#include <QStringList>
+#include <QVector>
+
+/** The folders the user doesn't want scrobbled, one node per path
+  * component.
+  *
+  * A path is excluded if one of the folders is an ancestor of it or the
+  * path itself, compared a whole component at a time, so /music2 isn't in
+  * /music. Looking a path up is one hash lookup per component however many
+  * folders there are. */
+class ExclusionTrie
+{
+public:
+    ExclusionTrie();
+    explicit ExclusionTrie( const QStringList& dirs );
+
+    /** replaces the folders, relative ones are made absolute */
+    void setDirs( const QStringList& dirs );
+
+    bool isEmpty() const;
+    bool contains( const QString& path ) const;
+
+private:
+    struct Node
+    {
+        Node() : excluded( false ) {}
+
+        QHash<QString, int> children;
+        bool excluded;
+    };
+
+    void add( const QString& dir );
+
+    QVector<Node> m_nodes;
+};
+
+#endif
@@ -0,0 +1,351 @@
+/*
+   Copyright 2013 Last.fm Ltd.
+
+   This file is part of the Last.fm Desktop Application Suite.
+
+   lastfm-desktop is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   lastfm-desktop is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with lastfm-desktop.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <QDataStream>
+#include <QDomDocument>
+#include <QDebug>
+
+#include <lastfm/misc.h>
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "ScrobbleJournal.h"
+
+// a length and a CRC-32 before each record's payload
+static const int HEADER_SIZE = 8;
+
+// don't bother compacting for less than this
+static const int COMPACT_MIN = 1000;
+
+
+static quint32
+crc32( const QByteArray& bytes )
+{
+    static quint32 table[256];
+    static bool haveTable = false;
+
+    if ( !haveTable )
+    {
+        for ( quint32 i = 0; i < 256; ++i )
+        {
+            quint32 c = i;
+            for ( int k = 0; k < 8; ++k )
+                c = c & 1 ? 0xedb88320 ^ ( c >> 1 ) : c >> 1;
+            table[i] = c;
+        }
+        haveTable = true;
+    }
+
+    quint32 crc = 0xffffffff;
+    const uchar* p = reinterpret_cast<const uchar*>( bytes.constData() );
+    for ( int i = 0; i < bytes.size(); ++i )
+        crc = table[( crc ^ p[i] ) & 0xff] ^ ( crc >> 8 );
+
+    return crc ^ 0xffffffff;
+}
+
+
+static bool
+syncFile( QFile& file )
+{
+    if ( !file.flush() )
+        return false;
+
+#ifdef Q_OS_WIN
+    return _commit( file.handle() ) == 0;
+#else
+    return ::fsync( file.handle() ) == 0;
+#endif
+}
+
+
+ScrobbleJournal::ScrobbleJournal( const QString& path )
+    : m_nextId( 1 )
+    , m_dead( 0 )
+{
+    QString journalPath = path.isEmpty() ? lastfm::dir::runtimeData().filePath( "scrobbles.journal" ) : path;
+
+    // compact() removes the old journal before it renames the new one
+    QString newPath = journalPath + ".new";
+    if ( QFile::exists( newPath ) )
+    {
+        if ( QFile::exists( journalPath ) )
+            QFile::remove( newPath );
+        else
+            QFile::rename( newPath, journalPath );
+    }
+
+    m_file.setFileName( journalPath );
+
+    if ( !m_file.open( QIODevice::ReadWrite ) )
+    {
+        qWarning() << "Could not open scrobble journal" << journalPath << m_file.errorString();
+        return;
+    }
+
+    load();
+}
+
+
+QString
+ScrobbleJournal::key( const lastfm::Track& track )
+{
+    return QString::number( track.timestamp().toTime_t() ) + '\t' + track.artist().name() + '\t' + track.title();
+}
+
+
+void
+ScrobbleJournal::addRecord( QByteArray& out, const QByteArray& payload )
+{
+    QDataStream stream( &out, QIODevice::WriteOnly | QIODevice::Append );
+    stream << quint32( payload.size() ) << crc32( payload );
+    stream.writeRawData( payload.constData(), payload.size() );
+}
+
+
+void
+ScrobbleJournal::load()
+{
+    QByteArray data = m_file.readAll();
+    int offset = 0;
+
+    while ( data.size() - offset >= HEADER_SIZE )
+    {
+        QDataStream header( data.mid( offset, HEADER_SIZE ) );
+        quint32 length, crc;
+        header >> length >> crc;
+
+        if ( length > quint32( data.size() - offset - HEADER_SIZE ) )
+            break;
+
+        QByteArray payload = data.mid( offset + HEADER_SIZE, length );
+        if ( crc32( payload ) != crc )
+            break;
+
+        QDataStream in( payload );
+        quint8 type;
+        in >> type;
+
+        if ( type == ScrobbleRecord )
+        {
+            quint64 id;
+            QByteArray xml;
+            in >> id >> xml;
+
+            QDomDocument doc;
+            doc.setContent( xml );
+            lastfm::Track track( doc.documentElement() );
+
+            m_pending.insert( id, track );
+            m_ids.insert( key( track ), id );
+            m_nextId = qMax( m_nextId, id + 1 );
+        }
+        else if ( type == AckRecord )
+        {
+            QList<quint64> ids;
+            in >> ids;
+
+            foreach ( quint64 id, ids )
+            {
+                if ( m_pending.contains( id ) )
+                {
+                    m_ids.remove( key( m_pending[id] ), id );
+                    m_pending.remove( id );
+                    ++m_dead;
+                }
+            }
+            ++m_dead;
+        }
+
+        offset += HEADER_SIZE + length;
+    }
+
+    // Throw away anything we didn't finish writing last time
+    if ( offset < data.size() )
+    {
+        qWarning() << "Dropping" << data.size() - offset << "bytes from the end of the scrobble journal";
+        m_file.resize( offset );
+    }
+
+    m_file.seek( offset );
+}
+
+
+bool
+ScrobbleJournal::write( const QByteArray& records, bool sync )
+{
+    if ( !m_file.isOpen() )
+        return false;
+
+    qint64 offset = m_file.size();
+    m_file.seek( offset );
+
+    if ( m_file.write( records ) != records.size() || ( sync ? !syncFile( m_file ) : !m_file.flush() ) )
+    {
+        qWarning() << "Could not write to the scrobble journal" << m_file.errorString();
+        m_file.resize( offset );
+        return false;
+    }
+
+    return true;
+}
+
+
+bool
+ScrobbleJournal::append( const QList<lastfm::Track>& tracks )
+{
+    if ( tracks.isEmpty() )
+        return true;
+
+    QByteArray records;
+    quint64 id = m_nextId;
+
+    foreach ( const lastfm::Track& track, tracks )
+    {
+        QDomDocument doc;
+        doc.appendChild( track.toDomElement( doc ) );
+
+        QByteArray payload;
+        QDataStream out( &payload, QIODevice::WriteOnly );
+        out << quint8( ScrobbleRecord ) << id++ << doc.toByteArray( -1 );
+
+        addRecord( records, payload );
+    }
+
+    // one sync for the whole batch
+    if ( !write( records, true ) )
+        return false;
+
+    foreach ( const lastfm::Track& track, tracks )
+    {
+        m_pending.insert( m_nextId, track );
+        m_ids.insert( key( track ), m_nextId );
+        ++m_nextId;
+    }
+
+    return true;
+}
+
+
+void
+ScrobbleJournal::acknowledge( const QList<lastfm::Track>& tracks )
+{
+    QList<quint64> ids;
+
+    foreach ( const lastfm::Track& track, tracks )
+    {
+        QString k = key( track );
+        QMultiHash<QString, quint64>::iterator i = m_ids.find( k );
+
+        if ( i != m_ids.end() )
+        {
+            ids << i.value();
+            m_pending.remove( i.value() );
+            m_ids.erase( i );
+        }
+    }
+
+    if ( ids.isEmpty() )
+        return;
+
+    m_dead += ids.count() + 1;
+
+    if ( m_pending.isEmpty() )
+    {
+        // nothing left to keep, so there's nothing to write either
+        m_file.resize( 0 );
+        m_file.seek( 0 );
+        syncFile( m_file );
+        m_dead = 0;
+        return;
+    }
+
+    if ( m_dead >= COMPACT_MIN && m_dead > m_pending.count() )
+    {
+        compact();
+        return;
+    }
+
+    QByteArray payload;
+    QDataStream out( &payload, QIODevice::WriteOnly );
+    out << quint8( AckRecord ) << ids;
+
+    QByteArray records;
+    addRecord( records, payload );
+
+    // if this is lost we just send them again, so it can wait for the
+    // next sync
+    write( records, false );
+}
+
+
+void
+ScrobbleJournal::compact()
+{
+    QFile compacted( m_file.fileName() + ".new" );
+
+    if ( !compacted.open( QIODevice::WriteOnly | QIODevice::Truncate ) )
+    {
+        qWarning() << "Could not compact the scrobble journal" << compacted.errorString();
+        return;
+    }
+
+    QByteArray records;
+
+    QMap<quint64, lastfm::Track>::const_iterator i = m_pending.constBegin();
+    for ( ; i != m_pending.constEnd(); ++i )
+    {
+        QDomDocument doc;
+        doc.appendChild( i.value().toDomElement( doc ) );
+
+        QByteArray payload;
+        QDataStream out( &payload, QIODevice::WriteOnly );
+        out << quint8( ScrobbleRecord ) << i.key() << doc.toByteArray( -1 );
+
+        addRecord( records, payload );
+    }
+
+    if ( compacted.write( records ) != records.size() || !syncFile( compacted ) )
+    {
+        qWarning() << "Could not compact the scrobble journal" << compacted.errorString();
+        compacted.close();
+        compacted.remove();
+        return;
+    }
+
+    compacted.close();
+
+    // QFile::rename won't overwrite, the constructor copes if we die
+    // in between
+    QString path = m_file.fileName();
+    m_file.close();
+    QFile::remove( path );
+    QFile::rename( compacted.fileName(), path );
+
+    m_file.setFileName( path );
+    if ( !m_file.open( QIODevice::ReadWrite ) )
+        qWarning() << "Could not open scrobble journal" << path << m_file.errorString();
+
+    m_file.seek( m_file.size() );
+    m_dead = 0;
+}
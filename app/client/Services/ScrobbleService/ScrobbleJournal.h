@@ -0,0 +1,78 @@
+/*
+   Copyright 2013 Last.fm Ltd.
+
+   This file is part of the Last.fm Desktop Application Suite.
+
+   lastfm-desktop is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   lastfm-desktop is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with lastfm-desktop.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef SCROBBLE_JOURNAL_H
+#define SCROBBLE_JOURNAL_H
+
+#include <QFile>
+#include <QMap>
+#include <QMultiHash>
+
+#include <lastfm/Track.h>
+
+
+/** Scrobbles we've taken on that the server hasn't acknowledged yet.
+  *
+  * Records are appended as a length, a CRC-32 and the payload. append()
+  * syncs once for however many scrobbles it's given, so caching a big iPod
+  * dump costs one write and one fsync rather than rewriting a whole cache.
+  * When the server takes scrobbles an acknowledgement is appended, and
+  * once the file is mostly acknowledgements the scrobbles still waiting
+  * are copied to a new file that replaces it.
+  *
+  * When the journal is opened, a record with a bad length or checksum
+  * marks where we were killed mid-write, and everything from there on is
+  * dropped.
+  *
+  * Only use this from the thread that created it. */
+class ScrobbleJournal
+{
+public:
+    /** defaults to scrobbles.journal in lastfm::dir::runtimeData() */
+    ScrobbleJournal( const QString& path = QString() );
+
+    /** written and synced to disk before this returns */
+    bool append( const QList<lastfm::Track>& tracks );
+
+    /** the server has these, matched on timestamp, artist and title */
+    void acknowledge( const QList<lastfm::Track>& tracks );
+
+    /** the scrobbles still waiting, oldest first */
+    QList<lastfm::Track> pending() const { return m_pending.values(); }
+
+    int count() const { return m_pending.count(); }
+
+private:
+    enum RecordType { ScrobbleRecord = 1, AckRecord = 2 };
+
+    static QString key( const lastfm::Track& track );
+    static void addRecord( QByteArray& out, const QByteArray& payload );
+
+    void load();
+    bool write( const QByteArray& records, bool sync );
+    void compact();
+
+    QFile m_file;
+    quint64 m_nextId;
+    int m_dead; // records in the file that we don't need any more
+
+    QMap<quint64, lastfm::Track> m_pending;
+    QMultiHash<QString, quint64> m_ids;
+};
+
+#endif
@@ -0,0 +1,238 @@
+/*
+   Copyright 2013 Last.fm Ltd.
+
+   This file is part of the Last.fm Desktop Application Suite.
+
+   lastfm-desktop is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   lastfm-desktop is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with lastfm-desktop.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QTimer>
+#include <QDebug>
+
+#include <lastfm/ws.h>
+#include <lastfm/XmlQuery.h>
+
+#include "ScrobbleScheduler.h"
+
+// the web service errors that mean try again later: operation failed,
+// service offline, temporarily unavailable and rate limit exceeded
+static bool
+isTemporary( int error )
+{
+    return error == 8 || error == 11 || error == 16 || error == 29;
+}
+
+
+ScrobbleScheduler::ScrobbleScheduler( QNetworkAccessManager* nam, QObject* parent )
+    :QObject( parent )
+    ,m_nam( nam ? nam : lastfm::nam() )
+    ,m_maxInFlight( 4 )
+    ,m_targetLatency( 5000 )
+    ,m_firstDelay( 1000 )
+    ,m_maxDelay( 5 * 60 * 1000 )
+    ,m_batchSize( MAX_BATCH )
+    ,m_delay( 1000 )
+    ,m_done( 0 )
+    ,m_total( 0 )
+{
+    m_retryTimer = new QTimer( this );
+    m_retryTimer->setSingleShot( true );
+    connect( m_retryTimer, SIGNAL(timeout()), SLOT(sendMore()) );
+}
+
+
+void
+ScrobbleScheduler::setRetry( int firstDelayMs, int maxDelayMs )
+{
+    m_firstDelay = firstDelayMs;
+    m_maxDelay = maxDelayMs;
+    m_delay = m_firstDelay;
+}
+
+
+void
+ScrobbleScheduler::submit( const QList<lastfm::Track>& tracks )
+{
+    if ( tracks.isEmpty() )
+        return;
+
+    m_queue += tracks;
+    m_total += tracks.count();
+    emit progress( m_done, m_total );
+
+    sendMore();
+}
+
+
+QByteArray
+ScrobbleScheduler::body( const QList<lastfm::Track>& tracks, QUrl& url ) const
+{
+    QMap<QString, QString> params;
+    params["method"] = "track.scrobble";
+
+    for ( int i = 0; i < tracks.count(); ++i )
+    {
+        const lastfm::Track& t = tracks[i];
+        QString n = QString( "[%1]" ).arg( i );
+
+        params["artist" + n] = t.artist();
+        params["track" + n] = t.title();
+        params["timestamp" + n] = QString::number( t.timestamp().toTime_t() );
+        params["duration" + n] = QString::number( t.duration() );
+        params["chosenByUser" + n] = t.source() == lastfm::Track::LastFmRadio ? "0" : "1";
+
+        QString album = t.album();
+        if ( !album.isEmpty() )
+            params["album" + n] = album;
+        if ( t.trackNumber() > 0 )
+            params["trackNumber" + n] = QString::number( t.trackNumber() );
+        QString mbid = t.mbid();
+        if ( !mbid.isEmpty() )
+            params["mbid" + n] = mbid;
+    }
+
+    // the same signed parameters lastfm::ws::post() would send, moved from
+    // the query to the body
+    url = lastfm::ws::url( params );
+#if QT_VERSION >= 0x050000
+    QByteArray query = url.query( QUrl::FullyEncoded ).toUtf8();
+    url.setQuery( QString() );
+#else
+    QByteArray query = url.encodedQuery();
+    url.setEncodedQuery( QByteArray() );
+#endif
+
+    if ( m_baseUrl.isValid() )
+        url = m_baseUrl;
+
+    return query;
+}
+
+
+void
+ScrobbleScheduler::sendMore()
+{
+    // backing off
+    if ( m_retryTimer->isActive() )
+        return;
+
+    while ( !m_queue.isEmpty() && m_replies.count() < m_maxInFlight )
+    {
+        Batch batch;
+        batch.tracks = m_queue.mid( 0, m_batchSize );
+        m_queue.erase( m_queue.begin(), m_queue.begin() + batch.tracks.count() );
+
+        QUrl url;
+        QByteArray data = body( batch.tracks, url );
+
+        QNetworkRequest request( url );
+        request.setHeader( QNetworkRequest::ContentTypeHeader, "application/x-www-form-urlencoded" );
+
+        QNetworkReply* reply = m_nam->post( request, data );
+        connect( reply, SIGNAL(finished()), SLOT(onReplyFinished()) );
+
+        batch.sent.start();
+        m_replies[reply] = batch;
+    }
+}
+
+
+void
+ScrobbleScheduler::onReplyFinished()
+{
+    QNetworkReply* reply = static_cast<QNetworkReply*>( sender() );
+    reply->deleteLater();
+
+    if ( !m_replies.contains( reply ) )
+        return;
+
+    Batch batch = m_replies.take( reply );
+    int latency = int( batch.sent.elapsed() );
+    int status = reply->attribute( QNetworkRequest::HttpStatusCodeAttribute ).toInt();
+
+    if ( reply->error() != QNetworkReply::NoError
+         && ( status == 0 || status >= 500 || status == 408 || status == 429 ) )
+    {
+        adapt( false, latency );
+        retry( batch );
+        return;
+    }
+
+    lastfm::XmlQuery lfm;
+    int error = 0;
+
+    if ( !lfm.parse( reply ) )
+        error = lfm.parseError().enumValue();
+
+    if ( error && isTemporary( error ) )
+    {
+        adapt( false, latency );
+        retry( batch );
+        return;
+    }
+
+    adapt( true, latency );
+    m_delay = m_firstDelay;
+    m_done += batch.tracks.count();
+
+    if ( error )
+    {
+        qWarning() << "The server won't take" << batch.tracks.count() << "scrobbles:" << lfm.parseError().message();
+        emit failed( batch.tracks, error );
+    }
+    else
+    {
+        foreach ( lastfm::Track track, batch.tracks )
+            lastfm::MutableTrack( track ).setScrobbleStatus( lastfm::Track::Submitted );
+
+        emit submitted( batch.tracks );
+    }
+
+    emit progress( m_done, m_total );
+
+    sendMore();
+
+    if ( m_queue.isEmpty() && m_replies.isEmpty() )
+    {
+        m_done = m_total = 0;
+        emit finished();
+    }
+}
+
+
+void
+ScrobbleScheduler::retry( const Batch& batch )
+{
+    // back to the front, they're the oldest
+    m_queue = batch.tracks + m_queue;
+
+    if ( !m_retryTimer->isActive() )
+    {
+        qDebug() << "Retrying scrobble submission in" << m_delay << "ms";
+        m_retryTimer->start( m_delay );
+        m_delay = qMin( m_delay * 2, m_maxDelay );
+    }
+}
+
+
+void
+ScrobbleScheduler::adapt( bool ok, int latency )
+{
+    if ( !ok || latency > m_targetLatency )
+        m_batchSize = qMax( 1, m_batchSize / 2 );
+    else if ( latency < m_targetLatency / 2 )
+        m_batchSize = qMin( MAX_BATCH, m_batchSize + qMax( 1, m_batchSize / 4 ) );
+}
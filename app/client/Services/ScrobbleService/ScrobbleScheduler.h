@@ -0,0 +1,127 @@
+/*
+   Copyright 2013 Last.fm Ltd.
+
+   This file is part of the Last.fm Desktop Application Suite.
+
+   lastfm-desktop is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   lastfm-desktop is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with lastfm-desktop.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef SCROBBLE_SCHEDULER_H
+#define SCROBBLE_SCHEDULER_H
+
+#include <QMap>
+#include <QObject>
+#if QT_VERSION >= 0x040700
+#include <QElapsedTimer>
+typedef QElapsedTimer ScrobbleSchedulerClock;
+#else
+#include <QTime>
+typedef QTime ScrobbleSchedulerClock;
+#endif
+#include <QUrl>
+
+#include <lastfm/Track.h>
+
+class QNetworkAccessManager;
+class QNetworkReply;
+class QTimer;
+
+
+/** Sends a backlog of scrobbles, usually from a device, straight to
+  * track.scrobble.
+  *
+  * The backlog is split into batches of up to 50, the most the API takes,
+  * and a few requests are kept in flight over the same connections. The
+  * batch size adapts: it halves when a request fails or takes longer than
+  * the target latency, and grows again while requests come back quickly.
+  *
+  * Network errors, 5xx, 408 and 429 responses and the API's "try again"
+  * errors put the batch back at the front of the queue, and nothing more
+  * is sent until a delay has passed that doubles each time. Anything else
+  * means the server won't take the batch, so it is given up on with
+  * failed(). */
+class ScrobbleScheduler : public QObject
+{
+    Q_OBJECT
+public:
+    /** nam defaults to lastfm::nam() */
+    ScrobbleScheduler( QNetworkAccessManager* nam = 0, QObject* parent = 0 );
+
+    /** send to this url rather than the web service */
+    void setBaseUrl( const QUrl& url ) { m_baseUrl = url; }
+
+    void setMaxInFlight( int requests ) { m_maxInFlight = qMax( 1, requests ); }
+
+    /** shrink batches that take longer than this */
+    void setTargetLatency( int ms ) { m_targetLatency = ms; }
+
+    /** first and longest delay between retries */
+    void setRetry( int firstDelayMs, int maxDelayMs );
+
+    /** after anything already waiting */
+    void submit( const QList<lastfm::Track>& tracks );
+
+    int batchSize() const { return m_batchSize; }
+    int inFlight() const { return m_replies.count(); }
+    int waiting() const { return m_queue.count(); }
+
+    static const int MAX_BATCH = 50;
+
+signals:
+    /** the server has answered for these, whether it accepted them or not */
+    void submitted( const QList<lastfm::Track>& tracks );
+
+    /** the server won't take these */
+    void failed( const QList<lastfm::Track>& tracks, int error );
+
+    /** done and total count since the queue was last empty */
+    void progress( int done, int total );
+
+    void finished();
+
+private slots:
+    void sendMore();
+    void onReplyFinished();
+
+private:
+    struct Batch
+    {
+        QList<lastfm::Track> tracks;
+        ScrobbleSchedulerClock sent; // not the wall clock, that can jump
+    };
+
+    /** the signed request, and where to send it */
+    QByteArray body( const QList<lastfm::Track>& tracks, QUrl& url ) const;
+    void retry( const Batch& batch );
+    void adapt( bool ok, int latency );
+
+    QNetworkAccessManager* m_nam;
+    QUrl m_baseUrl;
+
+    int m_maxInFlight;
+    int m_targetLatency;
+    int m_firstDelay;
+    int m_maxDelay;
+
+    int m_batchSize;
+    int m_delay;
+    QTimer* m_retryTimer;
+
+    QList<lastfm::Track> m_queue;
+    QMap<QNetworkReply*, Batch> m_replies;
+
+    int m_done;
+    int m_total;
+};
+
+#endif
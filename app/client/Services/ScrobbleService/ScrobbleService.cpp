@@ -19,9 +19,11 @@
 */
 
 #include "ScrobbleService.h"
+#include <lastfm/misc.h>
 #include <lastfm/ws.h>
 
 #include "../../Application.h"
+#include "lib/unicorn/SettingsSnapshot.h"
 #if defined(Q_OS_WIN) || defined(Q_OS_MAC)
 #include "lib/listener/legacy/LegacyPlayerListener.h"
 #else
@@ -34,6 +36,9 @@
 #include "../RadioService/RadioService.h"
 #include "../RadioService/RadioConnection.h"
 #include "StopWatch.h"
+#include "ExclusionTrie.h"
+#include "ScrobbleJournal.h"
+#include "ScrobbleScheduler.h"
 #ifdef Q_WS_MAC
 #include "lib/listener/mac/SpotifyListener.h"
 #include "lib/listener/mac/ITunesListener.h"
@@ -43,6 +48,8 @@
 #endif
 
 ScrobbleService::ScrobbleService()
+    : m_journal( 0 )
+    , m_scheduler( 0 )
 {
     qRegisterMetaType<Track>("Track");
 
@@ -84,6 +91,8 @@ ScrobbleService::ScrobbleService()
 
 
     connect( aApp, SIGNAL(sessionChanged(unicorn::Session)), SLOT(onSessionChanged(unicorn::Session)) );
+    // includes changes other processes made, which reach us through reload()
+    connect( &unicorn::SettingsStore::instance(), SIGNAL(changed()), SLOT(onSettingsChanged()) );
     resetScrobbler();
 }
 
@@ -95,54 +104,32 @@ ScrobbleService::instance()
 }
 
 
+ExclusionTrie&
+ScrobbleService::exclusions()
+{
+    static ExclusionTrie trie( unicorn::SettingsStore::snapshot().exclusionDirs );
+    return trie;
+}
+
+
 bool
 ScrobbleService::isDirExcluded( const lastfm::Track& track )
 {
     if ( track.source() == lastfm::Track::LastFmRadio )
         return false;
 
-    QString pathToTest = track.url().toLocalFile();
-
-#ifdef Q_OS_WIN
-    pathToTest = pathToTest.toLower();
-#endif
-
-    if ( pathToTest.isEmpty() )
-        return false;
-
-    unicorn::UserSettings us;
-    QStringList exculsionDirs = us.value( "ExclusionDirs" ).toStringList();
-
-    foreach ( QString bannedPath, exculsionDirs )
-    {
-        bannedPath = QDir( bannedPath ).absolutePath();
-#ifdef Q_OS_WIN
-        bannedPath = bannedPath.toLower();
-#endif
-
-        qDebug() << pathToTest << bannedPath;
-
-        // Try and match start of given path with banned dir
-        if ( pathToTest.startsWith( bannedPath ) )
-        {
-            // Found, this path is from a banned dir
-            return true;
-        }
-    }
-
-    // The path wasn't found in exclusions list
-    return false;
+    return exclusions().contains( track.url().toLocalFile() );
 }
 
 bool
 ScrobbleService::scrobblableTrack( const lastfm::Track& track ) const
 {
-    unicorn::UserSettings userSettings;
+    const unicorn::SettingsSnapshot& settings = unicorn::SettingsStore::snapshot();
 
-    return userSettings.scrobblingOn()
+    return settings.scrobblingOn
             && ( track.extra( "playerId" ) != "spt" && track.extra( "playerId" ) != "mpris2" )
             && !track.artist().isNull()
-            && ( userSettings.podcasts() || !track.isPodcast() )
+            && ( settings.podcasts || !track.isPodcast() )
             && !track.isVideo()
             && !isDirExcluded( track );
 }
@@ -156,10 +143,12 @@ ScrobbleService::scrobblingOn() const
 void
 ScrobbleService::scrobbleSettingsChanged()
 {
+    // onSettingsChanged() has already rebuilt the exclusions
     if ( m_watch )
     {
-        ScrobblePoint timeout( ( m_currentTrack.duration() * unicorn::UserSettings().scrobblePoint() ) / 100.0 );
-        timeout.setEnforceScrobbleTimeMax( unicorn::UserSettings().enforceScrobbleTimeMax() );
+        const unicorn::SettingsSnapshot& settings = unicorn::SettingsStore::snapshot();
+        ScrobblePoint timeout( ( m_currentTrack.duration() * settings.scrobblePoint ) / 100.0 );
+        timeout.setEnforceScrobbleTimeMax( settings.enforceScrobbleTimeMax );
         m_watch->setScrobblePoint( timeout );
     }
 
@@ -172,11 +161,17 @@ ScrobbleService::scrobbleSettingsChanged()
          && m_watch->elapsed() >= (m_watch->scrobblePoint() * 1000)
          && m_currentTrack.scrobbleStatus() == Track::Null
          && scrobblingOn )
-        m_as->cache( m_currentTrack );
+        cache( QList<lastfm::Track>() << m_currentTrack, true );
 
     emit scrobblingOnChanged( scrobblingOn );
 }
 
+void
+ScrobbleService::onSettingsChanged()
+{
+    exclusions().setDirs( unicorn::SettingsStore::snapshot().exclusionDirs );
+}
+
 void
 ScrobbleService::submitCache()
 {
@@ -186,6 +181,9 @@ ScrobbleService::submitCache()
 void 
 ScrobbleService::onSessionChanged( const unicorn::Session& )
 {
+    // the exclusions are per user
+    exclusions().setDirs( unicorn::SettingsStore::snapshot().exclusionDirs );
+
     resetScrobbler();
 }
 
@@ -206,6 +204,25 @@ ScrobbleService::resetScrobbler()
         connect( m_as, SIGNAL(scrobblesCached(QList<lastfm::Track>)), SIGNAL(scrobblesCached(QList<lastfm::Track>)));
         connect( m_as, SIGNAL(scrobblesSubmitted(QList<lastfm::Track>)), SIGNAL(scrobblesSubmitted(QList<lastfm::Track>)));
 
+        /// journal, anything still in it didn't make it to the server or the
+        /// library's cache last time
+        delete m_journal;
+        m_journal = new ScrobbleJournal( lastfm::dir::runtimeData().filePath( m_currentUsername + "_scrobbles.journal" ) );
+
+        /// scheduler, for backlogs too big to hand to the library in one go
+        delete m_scheduler;
+        m_scheduler = new ScrobbleScheduler( 0, this );
+        connect( m_scheduler, SIGNAL(submitted(QList<lastfm::Track>)), SIGNAL(scrobblesSubmitted(QList<lastfm::Track>)));
+        connect( m_scheduler, SIGNAL(submitted(QList<lastfm::Track>)), SLOT(onScrobblesSubmitted(QList<lastfm::Track>)));
+        connect( m_scheduler, SIGNAL(failed(QList<lastfm::Track>,int)), SLOT(onSchedulerFailed(QList<lastfm::Track>)));
+        connect( m_scheduler, SIGNAL(progress(int,int)), SIGNAL(submissionProgress(int,int)));
+
+        if ( m_journal->count() )
+        {
+            qDebug() << "Recovering" << m_journal->count() << "scrobbles from the journal";
+            m_scheduler->submit( m_journal->pending() );
+        }
+
         /// DeviceScrobbler
         delete m_deviceScrobbler;
         m_deviceScrobbler = new DeviceScrobbler( this );
@@ -221,10 +238,54 @@ ScrobbleService::resetScrobbler()
 void
 ScrobbleService::onFoundScrobbles( QList<lastfm::Track> tracks )
 {
-    m_as->cacheBatch( tracks );
+    // the journal is the only thing a dump is written to, so it costs one
+    // append and one sync however big the library's cache has got
+    if ( m_journal )
+        m_journal->append( tracks );
+
+    foreach ( lastfm::Track track, tracks )
+        MutableTrack( track ).setScrobbleStatus( Track::Cached );
+
+    emit scrobblesCached( tracks );
+    m_scheduler->submit( tracks );
+}
+
+void
+ScrobbleService::onSchedulerFailed( const QList<lastfm::Track>& tracks )
+{
+    // leave them to the library, it knows what to do about a bad session
+    // and keeps them until it can send them
+    cache( tracks, false );
     m_as->submit();
 }
 
+void
+ScrobbleService::cache( const QList<lastfm::Track>& tracks, bool journal )
+{
+    // the journal has to have them before the library does, or a crash
+    // before it has rewritten its cache could lose them
+    if ( journal && m_journal )
+        m_journal->append( tracks );
+
+    if ( tracks.count() == 1 )
+        m_as->cache( tracks.first() );
+    else
+        m_as->cacheBatch( tracks );
+
+    // The library has written them to its own cache and sends them from
+    // there, after a restart too, so the journal mustn't recover them as
+    // well. The ones it refused it won't ever send, so they go as well
+    if ( m_journal )
+        m_journal->acknowledge( tracks );
+}
+
+void
+ScrobbleService::onScrobblesSubmitted( const QList<lastfm::Track>& tracks )
+{
+    if ( m_journal )
+        m_journal->acknowledge( tracks );
+}
+
 
 void
 ScrobbleService::setConnection(PlayerConnection*c)
@@ -267,7 +328,7 @@ ScrobbleService::onTrackStarted( const lastfm::Track& t, const lastfm::Track& ot
 
     Track oldtrack = ot.isNull() ? m_currentTrack : ot;
 
-    if ( unicorn::UserSettings().scrobblePoint() == 100.0 && !oldtrack.isNull() )
+    if ( unicorn::SettingsStore::snapshot().scrobblePoint == 100.0 && !oldtrack.isNull() )
     {
         // was the last track at 100%? Should we scrobble it?
 
@@ -297,8 +358,9 @@ ScrobbleService::onTrackStarted( const lastfm::Track& t, const lastfm::Track& ot
     m_state = Playing;
     m_currentTrack = t;
 
-    ScrobblePoint timeout( ( m_currentTrack.duration() * unicorn::UserSettings().scrobblePoint() ) / 100.0 );
-    timeout.setEnforceScrobbleTimeMax( unicorn::UserSettings().enforceScrobbleTimeMax() );
+    const unicorn::SettingsSnapshot& settings = unicorn::SettingsStore::snapshot();
+    ScrobblePoint timeout( ( m_currentTrack.duration() * settings.scrobblePoint ) / 100.0 );
+    timeout.setEnforceScrobbleTimeMax( settings.enforceScrobbleTimeMax );
     delete m_watch;
     m_watch = new StopWatch(m_currentTrack.duration(), timeout);
     m_watch->start();
@@ -388,7 +450,7 @@ ScrobbleService::onScrobble()
     if( m_as
             && scrobblableTrack( m_currentTrack )
             && m_currentTrack.scrobbleStatus() == Track::Null )
-        m_as->cache( m_currentTrack );
+        cache( QList<lastfm::Track>() << m_currentTrack, true );
 }
 
 void 
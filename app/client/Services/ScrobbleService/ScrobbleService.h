@@ -33,6 +33,9 @@ class PlayerMediator;
 class PlayerConnection;
 class StopWatch;
 class DeviceScrobbler;
+class ExclusionTrie;
+class ScrobbleJournal;
+class ScrobbleScheduler;
 
 class ScrobbleService : public QObject
 {
@@ -67,6 +70,8 @@ signals:
     void scrobblingOnChanged( bool scrobblingOn );
     void scrobblesCached( const QList<lastfm::Track>& tracks );
     void scrobblesSubmitted( const QList<lastfm::Track>& tracks );
+    /** while a device backlog is being sent */
+    void submissionProgress( int done, int total );
 
     void foundIPodScrobbles( const QList<lastfm::Track>& tracks );
     void bootstrapReady( const QString& playerId );
@@ -86,9 +91,22 @@ protected slots:
     void onStopped();
 
     void onFoundScrobbles( QList<lastfm::Track> tracks );
+    void onScrobblesSubmitted( const QList<lastfm::Track>& tracks );
+    void onSchedulerFailed( const QList<lastfm::Track>& tracks );
+
+    void onSettingsChanged();
 
 private:
+    /** built from the settings the first time, then whenever they change */
+    static ExclusionTrie& exclusions();
+
     void resetScrobbler();
+
+    /** journal them first unless they came from the journal, and let the
+      * journal forget them once the library's cache has them, so they are
+      * only ever resubmitted from one place. This rewrites the library's
+      * whole cache, so device dumps don't come through here */
+    void cache( const QList<lastfm::Track>& tracks, bool journal );
     bool scrobblingOn() const;
 
 protected:
@@ -99,6 +117,8 @@ protected:
     QPointer <PlayerConnection> m_connection;
     QPointer <Audioscrobbler> m_as;
     QPointer <DeviceScrobbler> m_deviceScrobbler;
+    ScrobbleJournal* m_journal;
+    ScrobbleScheduler* m_scheduler;
     Track m_currentTrack;
     QString m_currentUsername;
 };
@@ -18,20 +18,30 @@
    along with lastfm-desktop.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "StopWatch.h"
-#include <QTimeLine>
+#include <QTimer>
 
 
 StopWatch::StopWatch( uint duration, ScrobblePoint timeout )
-    : m_duration( duration ), m_point( timeout ), m_scrobbled(false)
+    : m_state( NotRunning )
+    , m_banked( 0 )
+    , m_duration( duration )
+    , m_point( timeout )
+    , m_scrobbleTime( timeout * 1000 )
+    , m_scrobbled( false )
 {    
-    m_timeline = new QTimeLine( duration * 1000, this );
-    m_timeline->setFrameRange( 0, duration * 2 );
-    m_timeline->setEasingCurve( QEasingCurve::Linear );
-    m_timeline->setUpdateInterval( 50 );
-    m_timeline->setCurrentTime( 0 );
-
-    connect( m_timeline, SIGNAL(finished()), SIGNAL(timeout()) );
-    connect( m_timeline, SIGNAL(frameChanged(int)), SLOT(onFrameChanged(int)));
+    m_scrobbleTimer = new QTimer( this );
+    m_scrobbleTimer->setSingleShot( true );
+    connect( m_scrobbleTimer, SIGNAL(timeout()), SLOT(onScrobbleTimer()) );
+
+    m_endTimer = new QTimer( this );
+    m_endTimer->setSingleShot( true );
+    connect( m_endTimer, SIGNAL(timeout()), SLOT(onEndTimer()) );
+
+#if QT_VERSION >= 0x050000
+    // coarse timers can be a few percent out
+    m_scrobbleTimer->setTimerType( Qt::PreciseTimer );
+    m_endTimer->setTimerType( Qt::PreciseTimer );
+#endif
 }
 
 ScrobblePoint
@@ -44,6 +54,14 @@ void
 StopWatch::setScrobblePoint( const ScrobblePoint& timeout_in_seconds )
 {
     m_point = timeout_in_seconds;
+    setScrobbleTime( m_point * 1000 );
+}
+
+void
+StopWatch::setScrobbleTime( uint ms )
+{
+    m_scrobbleTime = ms;
+    schedule();
 }
 
 uint
@@ -58,35 +76,89 @@ StopWatch::scrobbled() const
     return m_scrobbled;
 }
 
+/** (re)arms the timers for however long is left, if we're running */
 void
-StopWatch::onFrameChanged( int /*frame*/ )
+StopWatch::schedule()
 {
-    emit frameChanged( m_timeline->currentTime() );
+    m_scrobbleTimer->stop();
+    m_endTimer->stop();
 
-    if ( !m_scrobbled && elapsed() >= (m_point * 1000) )
+    if ( m_state != Running )
+        return;
+
+    uint const now = elapsed();
+    uint const end = m_duration * 1000;
+
+    if ( !m_scrobbled && m_scrobbleTime <= end )
+        m_scrobbleTimer->start( m_scrobbleTime > now ? m_scrobbleTime - now : 0 );
+
+    m_endTimer->start( end > now ? end - now : 0 );
+}
+
+void
+StopWatch::onScrobbleTimer()
+{
+    // timers can go off a little early, so check
+    if ( elapsed() < m_scrobbleTime )
+    {
+        schedule();
+        return;
+    }
+
+    if ( !m_scrobbled )
     {
-        emit scrobble();
         m_scrobbled = true;
+        emit frameChanged( elapsed() );
+        emit scrobble();
     }
 }
 
+void
+StopWatch::onEndTimer()
+{
+    if ( elapsed() < m_duration * 1000 )
+    {
+        schedule();
+        return;
+    }
+
+    // stop the clock at the end, like the QTimeLine this used to be
+    m_banked = m_duration * 1000;
+    m_state = NotRunning;
+    m_scrobbleTimer->stop();
+
+    emit frameChanged( elapsed() );
+    emit timeout();
+}
+
 bool
 StopWatch::paused()
 {
-    return (m_timeline->state() == QTimeLine::Paused);
+    return m_state == Paused;
 }
 
 void
 StopWatch::start()
 {
-    m_timeline->start();
+    m_banked = 0;
+    m_clock.start();
+    m_state = Running;
+    schedule();
+
+    emit frameChanged( 0 );
     emit paused( false );
 }
 
 void
 StopWatch::pause()
 {
-    m_timeline->setPaused( true );
+    if ( m_state == Running )
+    {
+        m_banked = elapsed();
+        m_state = Paused;
+        schedule();
+        emit frameChanged( m_banked );
+    }
     emit paused( true );
 }
 
@@ -94,13 +166,21 @@ void
 StopWatch::resume()
 {
     // Only resume if we are already running
-    if ( m_timeline->state() == QTimeLine::Paused )
-        m_timeline->resume();
+    if ( m_state == Paused )
+    {
+        m_clock.start();
+        m_state = Running;
+        schedule();
+        emit frameChanged( m_banked );
+    }
     emit paused( false );
 }
 
 uint
 StopWatch::elapsed() const
 {
-    return m_timeline->currentTime();
+    if ( m_state != Running )
+        return m_banked;
+
+    return qMin<qint64>( m_banked + qint64( m_clock.elapsed() ), m_duration * 1000 );
 }
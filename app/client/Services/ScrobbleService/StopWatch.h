@@ -24,10 +24,23 @@
 #include <QDateTime>
 #include <QObject>
 
+#if QT_VERSION >= 0x040700
+#include <QElapsedTimer>
+typedef QElapsedTimer StopWatchClock;
+#else
+typedef QTime StopWatchClock;
+#endif
+
 namespace audioscrobbler { class Application; }
 
-/** Emits timeout() after seconds specified to start. 
-  * Continues to measure time after that point until object death.
+/** Emits scrobble() at the scrobble point and timeout() at the end of the
+  * track.
+  *
+  * Nothing ticks while the watch runs: elapsed() is worked out from a
+  * monotonic clock when it's asked for, and the scrobble point and the end
+  * of the track are single shot timers that pause() and resume() move.
+  * Anything that shows progress should poll elapsed() for as long as it's
+  * on screen.
   */
 class StopWatch : public QObject
 {
@@ -49,7 +62,7 @@ public:
 
     bool paused();
     
-    /** in milliseconds */
+    /** in milliseconds, it stops at the duration */
     uint elapsed() const;
 
     ScrobblePoint scrobblePoint() const;
@@ -59,20 +72,34 @@ public:
     
 signals:
     void paused( bool );
+    /** only when the watch starts, pauses, resumes, scrobbles or ends,
+      * not as it runs */
     void frameChanged( int millisecs );
     void scrobble();
     void timeout();
 
 private slots:
-    void onFrameChanged( int frame );
+    void onScrobbleTimer();
+    void onEndTimer();
 
 private:
     bool scrobbled() const;
+    void setScrobbleTime( uint ms );
+    void schedule();
 
 private: 
-    class QTimeLine* m_timeline;
+    enum State { NotRunning, Running, Paused };
+
+    State m_state;
+    StopWatchClock m_clock;     // since we last started or resumed
+    uint m_banked;              // ms elapsed before that
+
+    class QTimer* m_scrobbleTimer;
+    class QTimer* m_endTimer;
+
     uint m_duration;
     ScrobblePoint m_point;
+    uint m_scrobbleTime;        // ms
     bool m_scrobbled;
 };
 
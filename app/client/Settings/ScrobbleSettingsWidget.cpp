@@ -27,6 +27,7 @@
 #include <QSlider>
 #include <QVBoxLayout>
 
+#include "lib/unicorn/SettingsSnapshot.h"
 #include "lib/unicorn/UnicornSettings.h"
 
 #include "../Application.h"
@@ -43,8 +44,9 @@ ScrobbleSettingsWidget::ScrobbleSettingsWidget( QWidget* parent )
     ui->setupUi( this );
 
     unicorn::UserSettings userSettings;
+    const unicorn::SettingsSnapshot& settings = unicorn::SettingsStore::snapshot();
 
-    double scrobblePointValue = userSettings.scrobblePoint();
+    double scrobblePointValue = settings.scrobblePoint;
     ui->scrobblePoint->setValue( scrobblePointValue );
     ui->percentText->setText( QString::number(scrobblePointValue) );
     ui->percentText->setFixedWidth( ui->percentText->fontMetrics().width( "100" ) );
@@ -52,11 +54,11 @@ ScrobbleSettingsWidget::ScrobbleSettingsWidget( QWidget* parent )
 
     ui->allowFingerprint->setChecked( userSettings.fingerprinting() );
 
-    ui->enfocreScrobbleTimeMax->setChecked( userSettings.enforceScrobbleTimeMax() );
-    ui->scrobblingOn->setChecked( userSettings.scrobblingOn() );
-    ui->podcasts->setChecked( userSettings.podcasts() );
+    ui->enfocreScrobbleTimeMax->setChecked( settings.enforceScrobbleTimeMax );
+    ui->scrobblingOn->setChecked( settings.scrobblingOn );
+    ui->podcasts->setChecked( settings.podcasts );
 
-    QStringList exclusionDirs = userSettings.exclusionDirs();
+    QStringList exclusionDirs = settings.exclusionDirs;
     exclusionDirs.removeAll( "" );
     ui->exclusionDirs->setExclusions( exclusionDirs );
 
@@ -75,7 +77,7 @@ ScrobbleSettingsWidget::ScrobbleSettingsWidget( QWidget* parent )
 
 ScrobbleSettingsWidget::~ScrobbleSettingsWidget()
 {
-    if ( unicorn::UserSettings().scrobblePoint() != m_initialScrobblePercentage )
+    if ( unicorn::SettingsStore::snapshot().scrobblePoint != m_initialScrobblePercentage )
         AnalyticsService::instance().sendEvent(SETTINGS_CATEGORY, SCROBBLING_SETTINGS, "ScrobblePercentageChanged", QString::number( ui->scrobblePoint->value() ) );
 }
 
@@ -95,17 +97,19 @@ ScrobbleSettingsWidget::saveSettings()
         aApp->onScrobbleToggled( ui->scrobblingOn->isChecked() );
 
         unicorn::UserSettings userSettings;
-        userSettings.setScrobblePoint( ui->scrobblePoint->value() );
         userSettings.setFingerprinting( ui->allowFingerprint->isChecked() );
-        userSettings.setPodcasts( ui->podcasts->isChecked() );
-        userSettings.setEnforceScrobbleTimeMax( ui->enfocreScrobbleTimeMax->isChecked() );
+        userSettings.sync();
+
+        // these go through the store so ScrobbleService sees them straight away
+        unicorn::SettingsStore& store = unicorn::SettingsStore::instance();
+        store.setUserValue( "scrobblePoint", ui->scrobblePoint->value() );
+        store.setUserValue( "podcasts", ui->podcasts->isChecked() );
+        store.setUserValue( "enforceScrobbleTimeMax", ui->enfocreScrobbleTimeMax->isChecked() );
 
         QStringList exclusionDirs = ui->exclusionDirs->getExclusions();
         exclusionDirs.removeAll( "" );
         qDebug() << exclusionDirs;
-        userSettings.setExclusionDirs( exclusionDirs );
-
-        userSettings.sync();
+        store.setUserValue( "ExclusionDirs", exclusionDirs );
 
         ScrobbleService::instance().scrobbleSettingsChanged();
 
@@ -116,6 +116,12 @@ PlaybackControlsWidget::PlaybackControlsWidget(QWidget *parent) :
     connect( ui->volume, SIGNAL(clicked()), SLOT(mute()));
 
     connect( &ScrobbleService::instance(), SIGNAL(frameChanged(int)), SLOT(onFrameChanged(int)) );
+    connect( &ScrobbleService::instance(), SIGNAL(paused(bool)), SLOT(updateRefresh()) );
+    connect( &ScrobbleService::instance(), SIGNAL(timeout()), SLOT(updateRefresh()) );
+
+    m_refreshTimer = new QTimer( this );
+    m_refreshTimer->setInterval( 500 );
+    connect( m_refreshTimer, SIGNAL(timeout()), SLOT(onRefresh()) );
 }
 
 void
@@ -329,6 +335,7 @@ void
 PlaybackControlsWidget::onTrackStarted( const lastfm::Track& track, const lastfm::Track& /*oldTrack*/ )
 {
     setTrack( track );
+    updateRefresh();
 }
 
 void
@@ -346,6 +353,8 @@ PlaybackControlsWidget::onStopped()
     aApp->skipAction()->setEnabled( false );
     aApp->tagAction()->setEnabled( false );
     aApp->shareAction()->setEnabled( false );
+
+    updateRefresh();
 }
 
 void
@@ -509,6 +518,18 @@ PlaybackControlsWidget::onVolumeChanged( qreal volume )
 bool
 PlaybackControlsWidget::eventFilter( QObject *obj, QEvent *event )
 {
+    if ( obj == window() && obj != this )
+    {
+        // we stay visible while the window is minimised
+        if ( event->type() == QEvent::WindowStateChange )
+        {
+            onRefresh();
+            updateRefresh();
+        }
+
+        return QFrame::eventFilter( obj, event );
+    }
+
     if ( !m_volumeHideTimer )
     {
         m_volumeHideTimer = new QTimer( this );
@@ -540,6 +561,49 @@ PlaybackControlsWidget::eventFilter( QObject *obj, QEvent *event )
     return QFrame::eventFilter( obj, event );
 }
 
+void
+PlaybackControlsWidget::showEvent( QShowEvent* event )
+{
+    QFrame::showEvent( event );
+
+    // we're in our window by now, and installing twice only filters once
+    if ( window() != this )
+        window()->installEventFilter( this );
+
+    onRefresh();
+    updateRefresh();
+}
+
+void
+PlaybackControlsWidget::hideEvent( QHideEvent* event )
+{
+    QFrame::hideEvent( event );
+    updateRefresh();
+}
+
+void
+PlaybackControlsWidget::updateRefresh()
+{
+    StopWatch* watch = ScrobbleService::instance().stopWatch();
+
+    if ( isVisible()
+         && !window()->isMinimized()
+         && watch
+         && !watch->paused()
+         && watch->elapsed() < watch->duration() * 1000
+         && ScrobbleService::instance().currentTrack() != Track() )
+        m_refreshTimer->start();
+    else
+        m_refreshTimer->stop();
+}
+
+void
+PlaybackControlsWidget::onRefresh()
+{
+    if ( StopWatch* watch = ScrobbleService::instance().stopWatch() )
+        onFrameChanged( watch->elapsed() );
+}
+
 void
 PlaybackControlsWidget::mute()
 {
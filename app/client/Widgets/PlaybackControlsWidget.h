@@ -52,6 +52,8 @@ public:
 
 private:
     bool eventFilter( QObject *obj, QEvent *event );
+    void showEvent( QShowEvent* event );
+    void hideEvent( QHideEvent* event );
 
 private slots:
     void onActionsChanged();
@@ -69,6 +71,8 @@ private slots:
     void onStopped();
 
     void onFrameChanged( int frame );
+    void onRefresh();
+    void updateRefresh();
     void onScrobbleStatusChanged( short scrobbleStatus );
 
     void onVolumeChanged( qreal volume );
@@ -90,6 +94,9 @@ private:
     class VolumeSlider* m_volumeSlider;
 
     QPointer<QTimer> m_volumeHideTimer;
+
+    // the stop watch doesn't tick, so we ask it the time while we're shown
+    QTimer* m_refreshTimer;
 };
 
 #endif // PLAYBACKCONTROLS_H
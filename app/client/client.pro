@@ -52,6 +52,9 @@ SOURCES += \
     Settings/GeneralSettingsWidget.cpp \
     Services/ScrobbleService/StopWatch.cpp \
     Services/ScrobbleService/ScrobbleService.cpp \
+    Services/ScrobbleService/ExclusionTrie.cpp \
+    Services/ScrobbleService/ScrobbleJournal.cpp \
+    Services/ScrobbleService/ScrobbleScheduler.cpp \
     Services/RadioService/RadioService.cpp \
     Services/RadioService/RadioConnection.cpp \
     Dialogs/DiagnosticsDialog.cpp \
@@ -118,6 +121,9 @@ HEADERS += \
     Services/ScrobbleService.h \
     Services/ScrobbleService/StopWatch.h \
     Services/ScrobbleService/ScrobbleService.h \
+    Services/ScrobbleService/ExclusionTrie.h \
+    Services/ScrobbleService/ScrobbleJournal.h \
+    Services/ScrobbleService/ScrobbleScheduler.h \
     Services/RadioService.h \
     Services/RadioService/RadioService.h \
     MediaDevices/MediaDevice.h \
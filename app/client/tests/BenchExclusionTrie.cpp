@@ -0,0 +1,114 @@
+/*
+   Copyright 2005-2009 Last.fm Ltd. 
+      - Primarily authored by Max Howell, Jono Cole and Doug Mansell
+
+   This file is part of the Last.fm Desktop Application Suite.
+
+   lastfm-desktop is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   lastfm-desktop is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with lastfm-desktop.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <QtTest>
+#include <QDir>
+
+#include "Services/ScrobbleService/ExclusionTrie.h"
+
+
+/** The trie against the startsWith loop ScrobbleService used to run over
+  * every exclusion for every track. */
+class BenchExclusionTrie : public QObject
+{
+    Q_OBJECT
+
+    QStringList m_dirs;
+    QStringList m_paths;
+
+    static bool
+    linear( const QStringList& dirs, const QString& path )
+    {
+        foreach ( QString bannedPath, dirs )
+        {
+            bannedPath = QDir( bannedPath ).absolutePath();
+            if ( path.startsWith( bannedPath ) )
+                return true;
+        }
+        return false;
+    }
+
+private slots:
+    void initTestCase()
+    {
+        for ( int i = 0; i < 5000; ++i )
+            m_dirs << QString( "/home/user/Music/Artist %1/Album %2" ).arg( i ).arg( i % 7 );
+
+        for ( int i = 0; i < 1000; ++i )
+            m_paths << QString( "/home/user/Music/Artist %1/Album %2/%3 - Track.mp3" ).arg( i * 13 ).arg( i % 5 ).arg( i % 20 );
+    }
+
+    void testComponentBoundaries()
+    {
+        ExclusionTrie trie( QStringList() << "/music" << "/home/user/podcasts/" << "/a/b/../c" );
+
+        QVERIFY( trie.contains( "/music/track.mp3" ) );
+        QVERIFY( trie.contains( "/music" ) );
+        QVERIFY( !trie.contains( "/music2/track.mp3" ) );
+        QVERIFY( !trie.contains( "/mus" ) );
+        QVERIFY( trie.contains( "/home/user/podcasts/show/1.mp3" ) );
+        QVERIFY( !trie.contains( "/home/user/podcast.mp3" ) );
+        QVERIFY( trie.contains( "/a/c/track.mp3" ) );
+        QVERIFY( !trie.contains( "/a/b/track.mp3" ) );
+        QVERIFY( !trie.contains( "" ) );
+        QVERIFY( ExclusionTrie( QStringList() << "/" ).contains( "/anything.mp3" ) );
+        QVERIFY( ExclusionTrie( QStringList() << "" ).isEmpty() );
+    }
+
+    void testMatchesLinear()
+    {
+        ExclusionTrie trie( m_dirs );
+        foreach ( const QString& path, m_paths )
+            QCOMPARE( trie.contains( path ), linear( m_dirs, path ) );
+    }
+
+    void benchmark_data()
+    {
+        QTest::addColumn<bool>( "useTrie" );
+        QTest::newRow( "linear" ) << false;
+        QTest::newRow( "trie" ) << true;
+    }
+
+    void benchmark()
+    {
+        QFETCH( bool, useTrie );
+
+        ExclusionTrie trie( m_dirs );
+        int excluded = 0;
+
+        QBENCHMARK
+        {
+            excluded = 0;
+            foreach ( const QString& path, m_paths )
+                if ( useTrie ? trie.contains( path ) : linear( m_dirs, path ) )
+                    ++excluded;
+        }
+
+        QVERIFY( excluded > 0 );
+    }
+
+    void benchmarkBuild()
+    {
+        ExclusionTrie trie;
+        QBENCHMARK { trie.setDirs( m_dirs ); }
+    }
+};
+
+QTEST_MAIN(BenchExclusionTrie)
+#include "BenchExclusionTrie.moc"
@@ -0,0 +1,310 @@
+/*
+   Copyright 2013 Last.fm Ltd.
+
+   This file is part of the Last.fm Desktop Application Suite.
+
+   lastfm-desktop is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   lastfm-desktop is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with lastfm-desktop.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <QtTest>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QNetworkAccessManager>
+#include <QPointer>
+
+#include <lastfm/Track.h>
+#include <lastfm/ws.h>
+
+#include "Services/ScrobbleService/ScrobbleScheduler.h"
+
+
+/** Stands in for track.scrobble. Accepts every scrobble it is sent, keeps
+  * connections open, and can answer late or with a 503 */
+class FakeScrobbleServer : public QTcpServer
+{
+    Q_OBJECT
+public:
+    FakeScrobbleServer() : delay( 0 ), failEvery( 0 ), requests( 0 ), accepted( 0 ), open( 0 ), maxOpen( 0 )
+    {
+        connect( this, SIGNAL(newConnection()), SLOT(onNewConnection()) );
+        listen( QHostAddress::LocalHost );
+    }
+
+    int delay;
+    int failEvery;
+
+    int requests;
+    int accepted;
+    int open;
+    int maxOpen;
+
+private slots:
+    void onNewConnection()
+    {
+        while ( hasPendingConnections() )
+        {
+            QTcpSocket* socket = nextPendingConnection();
+            connect( socket, SIGNAL(readyRead()), SLOT(onReadyRead()) );
+            connect( socket, SIGNAL(disconnected()), socket, SLOT(deleteLater()) );
+        }
+    }
+
+    void onReadyRead()
+    {
+        QTcpSocket* socket = static_cast<QTcpSocket*>( sender() );
+        QByteArray& buffer = m_buffers[socket];
+        buffer += socket->readAll();
+
+        // the connection is kept alive, so there may be more than one
+        forever
+        {
+            int headerEnd = buffer.indexOf( "\r\n\r\n" );
+            if ( headerEnd == -1 )
+                return;
+
+            QRegExp contentLength( "Content-Length: *(\\d+)", Qt::CaseInsensitive );
+            int length = contentLength.indexIn( buffer.left( headerEnd ) ) != -1 ? contentLength.cap( 1 ).toInt() : 0;
+            if ( buffer.size() < headerEnd + 4 + length )
+                return;
+
+            QByteArray body = buffer.mid( headerEnd + 4, length );
+            buffer.remove( 0, headerEnd + 4 + length );
+
+            ++requests;
+            ++open;
+            maxOpen = qMax( maxOpen, open );
+
+            QByteArray status = "200 OK";
+            QByteArray xml;
+
+            if ( failEvery && requests % failEvery == 0 )
+            {
+                status = "503 Service Unavailable";
+            }
+            else
+            {
+                int count = body.count( "timestamp%5B" ) + body.count( "timestamp[" );
+                accepted += count;
+                xml = "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+                      "<lfm status=\"ok\"><scrobbles accepted=\"" + QByteArray::number( count ) + "\" ignored=\"0\"></scrobbles></lfm>";
+            }
+
+            m_answers << qMakePair( QPointer<QTcpSocket>( socket ),
+                                    "HTTP/1.1 " + status + "\r\n"
+                                    "Content-Type: text/xml\r\n"
+                                    "Content-Length: " + QByteArray::number( xml.size() ) + "\r\n\r\n" + xml );
+
+            // every answer waits as long, so they come due in order
+            if ( delay )
+                QTimer::singleShot( delay, this, SLOT(answer()) );
+            else
+                answer();
+        }
+    }
+
+    void answer()
+    {
+        QPair<QPointer<QTcpSocket>, QByteArray> next = m_answers.takeFirst();
+        --open;
+
+        if ( next.first )
+            next.first->write( next.second );
+    }
+
+private:
+    QMap<QTcpSocket*, QByteArray> m_buffers;
+    QList<QPair<QPointer<QTcpSocket>, QByteArray> > m_answers;
+};
+
+
+/** Sends synthetic device backlogs to a FakeScrobbleServer */
+class BenchScrobbleScheduler : public QObject
+{
+    Q_OBJECT
+
+    QNetworkAccessManager* m_nam;
+    int m_submitted;
+    int m_failed;
+    int m_finished;
+    int m_done;
+    int m_total;
+
+    static QList<lastfm::Track> backlog( int count );
+    bool run( FakeScrobbleServer& server, ScrobbleScheduler& scheduler, const QList<lastfm::Track>& tracks, int timeoutMs );
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void testRetries();
+    void testSlowShrinks();
+    void benchmark_data();
+    void benchmark();
+
+    void onSubmitted( const QList<lastfm::Track>& tracks ) { m_submitted += tracks.count(); }
+    void onFailed( const QList<lastfm::Track>& tracks ) { m_failed += tracks.count(); }
+    void onProgress( int done, int total ) { m_done = done; m_total = total; }
+    void onFinished() { ++m_finished; }
+};
+
+
+QList<lastfm::Track>
+BenchScrobbleScheduler::backlog( int count )
+{
+    QList<lastfm::Track> list;
+
+    for ( int i = 0; i < count; ++i )
+    {
+        lastfm::MutableTrack t;
+        t.setArtist( QString( "Artist %1" ).arg( i % 500 ) );
+        t.setTitle( QString( "Title %1" ).arg( i ) );
+        t.setAlbum( QString( "Album %1" ).arg( i % 50 ) );
+        t.setDuration( 120 + i % 300 );
+        t.setTimeStamp( QDateTime::fromTime_t( 1300000000 + i * 200 ) );
+        list << t;
+    }
+
+    return list;
+}
+
+
+bool
+BenchScrobbleScheduler::run( FakeScrobbleServer& server, ScrobbleScheduler& scheduler, const QList<lastfm::Track>& tracks, int timeoutMs )
+{
+    m_submitted = m_failed = m_finished = m_done = m_total = 0;
+
+    scheduler.setBaseUrl( QUrl( QString( "http://127.0.0.1:%1/2.0/" ).arg( server.serverPort() ) ) );
+    connect( &scheduler, SIGNAL(submitted(QList<lastfm::Track>)), SLOT(onSubmitted(QList<lastfm::Track>)) );
+    connect( &scheduler, SIGNAL(failed(QList<lastfm::Track>,int)), SLOT(onFailed(QList<lastfm::Track>)) );
+    connect( &scheduler, SIGNAL(progress(int,int)), SLOT(onProgress(int,int)) );
+    connect( &scheduler, SIGNAL(finished()), SLOT(onFinished()) );
+
+    scheduler.submit( tracks );
+
+    QTime timeout;
+    timeout.start();
+    while ( !m_finished && timeout.elapsed() < timeoutMs )
+        QTest::qWait( 10 );
+
+    return m_finished == 1;
+}
+
+
+void
+BenchScrobbleScheduler::initTestCase()
+{
+    lastfm::ws::ApiKey = "apikey";
+    lastfm::ws::SharedSecret = "secret";
+    lastfm::ws::SessionKey = "sessionkey";
+
+    m_nam = new QNetworkAccessManager( this );
+}
+
+
+void
+BenchScrobbleScheduler::cleanupTestCase()
+{
+    delete m_nam;
+}
+
+
+void
+BenchScrobbleScheduler::testRetries()
+{
+    FakeScrobbleServer server;
+    QVERIFY( server.isListening() );
+    server.failEvery = 3;
+
+    ScrobbleScheduler scheduler( m_nam );
+    scheduler.setRetry( 10, 100 );
+
+    QVERIFY( run( server, scheduler, backlog( 500 ), 30000 ) );
+
+    QCOMPARE( m_submitted, 500 );
+    QCOMPARE( m_failed, 0 );
+    QCOMPARE( server.accepted, 500 );
+    // the last progress before finished() counts everything
+    QCOMPARE( m_done, 500 );
+    QCOMPARE( m_total, 500 );
+    QVERIFY( server.maxOpen <= 4 );
+    QVERIFY( scheduler.waiting() == 0 && scheduler.inFlight() == 0 );
+}
+
+
+void
+BenchScrobbleScheduler::testSlowShrinks()
+{
+    FakeScrobbleServer server;
+    QVERIFY( server.isListening() );
+    server.delay = 100;
+
+    ScrobbleScheduler scheduler( m_nam );
+    scheduler.setMaxInFlight( 2 );
+    scheduler.setTargetLatency( 50 );
+
+    QVERIFY( run( server, scheduler, backlog( 200 ), 30000 ) );
+
+    QCOMPARE( server.accepted, 200 );
+    QVERIFY( server.maxOpen <= 2 );
+    QVERIFY( scheduler.batchSize() < ScrobbleScheduler::MAX_BATCH );
+}
+
+
+void
+BenchScrobbleScheduler::benchmark_data()
+{
+    QTest::addColumn<int>( "maxInFlight" );
+    QTest::addColumn<int>( "delay" );
+    QTest::addColumn<int>( "failEvery" );
+
+    QTest::newRow( "one at a time" ) << 1 << 0 << 0;
+    QTest::newRow( "four in flight" ) << 4 << 0 << 0;
+    QTest::newRow( "four in flight, 5ms latency" ) << 4 << 5 << 0;
+    QTest::newRow( "four in flight, 1 in 20 fail" ) << 4 << 0 << 20;
+}
+
+
+void
+BenchScrobbleScheduler::benchmark()
+{
+    QFETCH( int, maxInFlight );
+    QFETCH( int, delay );
+    QFETCH( int, failEvery );
+
+    QList<lastfm::Track> tracks = backlog( 100000 );
+
+    FakeScrobbleServer server;
+    QVERIFY( server.isListening() );
+    server.delay = delay;
+    server.failEvery = failEvery;
+
+    ScrobbleScheduler scheduler( m_nam );
+    scheduler.setMaxInFlight( maxInFlight );
+    scheduler.setRetry( 1, 10 );
+
+    bool finished = false;
+    QBENCHMARK_ONCE {
+        finished = run( server, scheduler, tracks, 10 * 60 * 1000 );
+    }
+
+    QVERIFY( finished );
+    QCOMPARE( server.accepted, 100000 );
+    QCOMPARE( m_submitted, 100000 );
+    QVERIFY( server.maxOpen <= maxInFlight );
+
+    qDebug() << server.requests << "requests, finishing with batches of" << scheduler.batchSize();
+}
+
+QTEST_MAIN(BenchScrobbleScheduler)
+#include "BenchScrobbleScheduler.moc"
@@ -0,0 +1,182 @@
+/*
+   Copyright 2013 Last.fm Ltd.
+
+   This file is part of the Last.fm Desktop Application Suite.
+
+   lastfm-desktop is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   lastfm-desktop is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with lastfm-desktop.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <QtTest>
+
+#include <lastfm/Track.h>
+
+#include "Services/ScrobbleService/ScrobbleJournal.h"
+
+
+class TestScrobbleJournal : public QObject
+{
+    Q_OBJECT
+
+    QString m_path;
+
+    static QList<lastfm::Track>
+    tracks( int first, int count )
+    {
+        QList<lastfm::Track> list;
+
+        for ( int i = first; i < first + count; ++i )
+        {
+            lastfm::MutableTrack t;
+            t.setArtist( QString( "Artist %1" ).arg( i ) );
+            t.setTitle( QString( "Title %1" ).arg( i ) );
+            t.setDuration( 200 );
+            t.setTimeStamp( QDateTime::fromTime_t( 1300000000 + i * 200 ) );
+            list << t;
+        }
+
+        return list;
+    }
+
+private slots:
+    void init()
+    {
+        m_path = QDir::temp().filePath( "test_scrobble.journal" );
+        QFile::remove( m_path );
+        QFile::remove( m_path + ".new" );
+    }
+
+    void cleanup()
+    {
+        QFile::remove( m_path );
+        QFile::remove( m_path + ".new" );
+    }
+
+    void testReopen()
+    {
+        {
+            ScrobbleJournal journal( m_path );
+            QVERIFY( journal.append( tracks( 0, 3 ) ) );
+            QVERIFY( journal.append( tracks( 3, 2 ) ) );
+        }
+
+        ScrobbleJournal journal( m_path );
+        QList<lastfm::Track> pending = journal.pending();
+
+        QCOMPARE( pending.count(), 5 );
+        QCOMPARE( pending[0].title(), QString( "Title 0" ) );
+        QCOMPARE( pending[4].artist().name(), QString( "Artist 4" ) );
+        QCOMPARE( pending[4].timestamp().toTime_t(), uint( 1300000800 ) );
+    }
+
+    void testAcknowledge()
+    {
+        {
+            ScrobbleJournal journal( m_path );
+            journal.append( tracks( 0, 5 ) );
+            journal.acknowledge( tracks( 1, 2 ) );
+            QCOMPARE( journal.count(), 3 );
+        }
+
+        ScrobbleJournal journal( m_path );
+        QCOMPARE( journal.count(), 3 );
+        QCOMPARE( journal.pending()[1].title(), QString( "Title 3" ) );
+
+        // all done means an empty file
+        journal.acknowledge( journal.pending() );
+        QCOMPARE( journal.count(), 0 );
+        QCOMPARE( QFileInfo( m_path ).size(), qint64( 0 ) );
+    }
+
+    void testTornWrite()
+    {
+        {
+            ScrobbleJournal journal( m_path );
+            journal.append( tracks( 0, 4 ) );
+        }
+
+        // killed half way through the last record
+        QFile file( m_path );
+        QVERIFY( file.open( QIODevice::ReadWrite ) );
+        file.resize( file.size() - 10 );
+        file.close();
+
+        {
+            ScrobbleJournal journal( m_path );
+            QCOMPARE( journal.count(), 3 );
+            QVERIFY( journal.append( tracks( 4, 1 ) ) );
+        }
+
+        // and the next append goes after the good records
+        ScrobbleJournal journal( m_path );
+        QCOMPARE( journal.count(), 4 );
+        QCOMPARE( journal.pending().last().title(), QString( "Title 4" ) );
+    }
+
+    void testCorruptRecord()
+    {
+        {
+            ScrobbleJournal journal( m_path );
+            journal.append( tracks( 0, 2 ) );
+        }
+
+        QFile file( m_path );
+        QVERIFY( file.open( QIODevice::ReadWrite ) );
+        file.seek( file.size() - 5 );
+        file.write( "xxxxx" );
+        file.close();
+
+        ScrobbleJournal journal( m_path );
+        QCOMPARE( journal.count(), 1 );
+    }
+
+    void testCompaction()
+    {
+        qint64 full;
+        {
+            ScrobbleJournal journal( m_path );
+            journal.append( tracks( 0, 3000 ) );
+            full = QFileInfo( m_path ).size();
+
+            for ( int i = 0; i < 2990; i += 10 )
+                journal.acknowledge( tracks( i, 10 ) );
+
+            QCOMPARE( journal.count(), 10 );
+        }
+
+        QVERIFY( QFileInfo( m_path ).size() < full / 2 );
+        QVERIFY( !QFile::exists( m_path + ".new" ) );
+
+        ScrobbleJournal journal( m_path );
+        QCOMPARE( journal.count(), 10 );
+        QCOMPARE( journal.pending().first().title(), QString( "Title 2990" ) );
+    }
+
+    void testInterruptedCompaction()
+    {
+        {
+            ScrobbleJournal journal( m_path );
+            journal.append( tracks( 0, 2 ) );
+        }
+
+        // died between removing the old journal and renaming the new one
+        QFile::rename( m_path, m_path + ".new" );
+
+        ScrobbleJournal journal( m_path );
+        QCOMPARE( journal.count(), 2 );
+        QVERIFY( !QFile::exists( m_path + ".new" ) );
+    }
+};
+
+QTEST_MAIN(TestScrobbleJournal)
+#include "TestScrobbleJournal.moc"
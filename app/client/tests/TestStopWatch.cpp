@@ -0,0 +1,137 @@
+/*
+   Copyright 2013 Last.fm Ltd.
+
+   This file is part of the Last.fm Desktop Application Suite.
+
+   lastfm-desktop is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   lastfm-desktop is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with lastfm-desktop.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <QtTest>
+
+#include "Services/ScrobbleService/StopWatch.h"
+
+
+static const uint LATE_SLACK_MS = 50;
+
+
+class TestStopWatch : public QObject
+{
+    Q_OBJECT
+
+    StopWatch* m_watch;
+    QList<uint> m_scrobbledAt;
+
+    void waitFor( QSignalSpy& spy, int ms )
+    {
+        for ( int i = 0; i < ms / 10 && spy.isEmpty(); ++i )
+            QTest::qWait( 10 );
+    }
+
+    /** Never early, that's what StopWatch promises, and no later than a
+      * busy machine and the coarsest timers (about 16ms on Windows) make
+      * it. A watch that ticked its way there would be a lot later. */
+    void verifyOnTime( uint at, uint due )
+    {
+        QVERIFY( at >= due );
+        QVERIFY2( at <= due + LATE_SLACK_MS, qPrintable( QString( "%1ms late" ).arg( at - due ) ) );
+    }
+
+private slots:
+    void init()
+    {
+        m_watch = 0;
+        m_scrobbledAt.clear();
+    }
+
+    void cleanup()
+    {
+        delete m_watch;
+    }
+
+    void onScrobble()
+    {
+        m_scrobbledAt << m_watch->elapsed();
+    }
+
+    void scrobblesOnTime()
+    {
+        // the ScrobblePoint won't go below 31 seconds
+        m_watch = new StopWatch( 2, ScrobblePoint( 31 ) );
+        m_watch->setScrobbleTime( 300 );
+        connect( m_watch, SIGNAL(scrobble()), SLOT(onScrobble()) );
+
+        QSignalSpy spy( m_watch, SIGNAL(scrobble()) );
+        m_watch->start();
+        waitFor( spy, 1000 );
+
+        QCOMPARE( spy.count(), 1 );
+        verifyOnTime( m_scrobbledAt[0], 300 );
+    }
+
+    void pauseMovesTheScrobble()
+    {
+        m_watch = new StopWatch( 2, ScrobblePoint( 31 ) );
+        m_watch->setScrobbleTime( 300 );
+        connect( m_watch, SIGNAL(scrobble()), SLOT(onScrobble()) );
+
+        QSignalSpy spy( m_watch, SIGNAL(scrobble()) );
+        m_watch->start();
+        QTest::qWait( 100 );
+
+        m_watch->pause();
+        QVERIFY( m_watch->paused() );
+        uint pausedAt = m_watch->elapsed();
+        QTest::qWait( 400 );
+        QCOMPARE( spy.count(), 0 );
+        QCOMPARE( m_watch->elapsed(), pausedAt );
+
+        m_watch->resume();
+        QVERIFY( !m_watch->paused() );
+        waitFor( spy, 1000 );
+
+        QCOMPARE( spy.count(), 1 );
+        verifyOnTime( m_scrobbledAt[0], 300 );
+    }
+
+    void timesOutAtTheEnd()
+    {
+        m_watch = new StopWatch( 1, ScrobblePoint( 31 ) );
+
+        QSignalSpy scrobbles( m_watch, SIGNAL(scrobble()) );
+        QSignalSpy timeouts( m_watch, SIGNAL(timeout()) );
+        m_watch->start();
+        waitFor( timeouts, 2000 );
+
+        QCOMPARE( timeouts.count(), 1 );
+        QCOMPARE( m_watch->elapsed(), 1000u );
+        // the scrobble point is past the end of the track
+        QCOMPARE( scrobbles.count(), 0 );
+    }
+
+    void doesNotTick()
+    {
+        m_watch = new StopWatch( 60, ScrobblePoint( 31 ) );
+
+        QSignalSpy frames( m_watch, SIGNAL(frameChanged(int)) );
+        m_watch->start();
+        QTest::qWait( 500 );
+
+        // just the one for starting
+        QCOMPARE( frames.count(), 1 );
+        QVERIFY( m_watch->elapsed() >= 500 );
+    }
+};
+
+QTEST_MAIN(TestStopWatch)
+#include "TestStopWatch.moc"
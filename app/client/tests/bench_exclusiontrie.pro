@@ -0,0 +1,11 @@
+TEMPLATE = app
+TARGET = bench_exclusiontrie
+QT = core testlib
+CONFIG -= app_bundle
+INCLUDEPATH += ..
+include( ../../../admin/include.qmake )
+
+SOURCES = BenchExclusionTrie.cpp \
+          ../Services/ScrobbleService/ExclusionTrie.cpp
+
+HEADERS = ../Services/ScrobbleService/ExclusionTrie.h
@@ -0,0 +1,14 @@
+TEMPLATE = app
+TARGET = bench_scrobblescheduler
+QT = core xml network testlib
+CONFIG += lastfm
+CONFIG -= app_bundle
+INCLUDEPATH += ..
+include( ../../../admin/include.qmake )
+
+DEFINES += LASTFM_COLLAPSE_NAMESPACE
+
+SOURCES = BenchScrobbleScheduler.cpp \
+          ../Services/ScrobbleService/ScrobbleScheduler.cpp
+
+HEADERS = ../Services/ScrobbleService/ScrobbleScheduler.h
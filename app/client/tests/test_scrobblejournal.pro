@@ -0,0 +1,14 @@
+TEMPLATE = app
+TARGET = test_scrobblejournal
+QT = core xml network testlib
+CONFIG += lastfm
+CONFIG -= app_bundle
+INCLUDEPATH += ..
+include( ../../../admin/include.qmake )
+
+DEFINES += LASTFM_COLLAPSE_NAMESPACE
+
+SOURCES = TestScrobbleJournal.cpp \
+          ../Services/ScrobbleService/ScrobbleJournal.cpp
+
+HEADERS = ../Services/ScrobbleService/ScrobbleJournal.h
@@ -0,0 +1,14 @@
+TEMPLATE = app
+TARGET = test_stopwatch
+QT = core testlib
+CONFIG += lastfm
+CONFIG -= app_bundle
+INCLUDEPATH += ..
+include( ../../../admin/include.qmake )
+
+DEFINES += LASTFM_COLLAPSE_NAMESPACE
+
+SOURCES = TestStopWatch.cpp \
+          ../Services/ScrobbleService/StopWatch.cpp
+
+HEADERS = ../Services/ScrobbleService/StopWatch.h
@@ -0,0 +1,471 @@
+/*
+   Copyright 2013 Last.fm Ltd.
+
+   This file is part of liblastfm.
+
+   liblastfm is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   liblastfm is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with liblastfm.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <QCoreApplication>
+#include <QNetworkReply>
+#include <QStringList>
+#include <QDebug>
+
+#include <stdexcept>
+#include <cstdio>
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+// Needed by libavutil/common.h
+#ifndef __STDC_CONSTANT_MACROS
+#define __STDC_CONSTANT_MACROS 1
+#endif
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+#include <lastfm/Fingerprint.h>
+#include <lastfm/FingerprintableSource.h>
+
+#include "LAV_Source.h"
+#include "FingerprintCache.h"
+#include "FingerprintQueue.h"
+#include "FingerprintBatch.h"
+
+
+/** avcodec_open2 and friends are not thread safe unless libav is given a
+  * lock manager. */
+static int
+lavLockManager( void** mutex, enum AVLockOp op )
+{
+    switch ( op )
+    {
+        case AV_LOCK_CREATE:
+            *mutex = new QMutex;
+            return *mutex ? 0 : 1;
+        case AV_LOCK_OBTAIN:
+            static_cast<QMutex*>( *mutex )->lock();
+            return 0;
+        case AV_LOCK_RELEASE:
+            static_cast<QMutex*>( *mutex )->unlock();
+            return 0;
+        case AV_LOCK_DESTROY:
+            delete static_cast<QMutex*>( *mutex );
+            *mutex = 0;
+            return 0;
+    }
+    return 1;
+}
+
+
+FingerprintWorker::FingerprintWorker( FingerprintBatch* batch )
+    :m_batch( batch )
+    // LAV_Source initialises libav globally, so create it on the main thread
+    ,m_source( new LAV_Source() )
+{
+}
+
+
+FingerprintWorker::~FingerprintWorker()
+{
+    wait();
+    delete m_source;
+}
+
+
+void
+FingerprintWorker::run()
+{
+    while ( FingerprintJob* job = m_batch->takeJob() )
+    {
+        double decodedBefore = m_source->decodedSeconds();
+        quint64 copiedBefore = m_source->bytesCopied();
+
+        try
+        {
+            job->fp->generate( m_source );
+        }
+        catch ( const lastfm::Fingerprint::Error& error )
+        {
+            job->error = QString( "Fingerprint error %1" ).arg( static_cast<int>( error ) );
+        }
+        catch ( const std::exception& e )
+        {
+            job->error = QString::fromLocal8Bit( e.what() );
+        }
+
+        // close the file now rather than when the next job starts
+        m_source->release();
+
+        job->decodedSeconds = m_source->decodedSeconds() - decodedBefore;
+        job->bytesCopied = m_source->bytesCopied() - copiedBefore;
+        emit generated( job );
+    }
+}
+
+
+FingerprintBatch::FingerprintBatch( const QString& manifest, FingerprintCache* cache, FingerprintQueue* queue, int threadCount, QObject* parent )
+    :QObject( parent )
+    ,m_manifestPath( manifest )
+    ,m_cache( cache )
+    ,m_offline( queue )
+    ,m_threadCount( threadCount > 0 ? threadCount : QThread::idealThreadCount() )
+    ,m_runningWorkers( 0 )
+    ,m_exhausted( false )
+    ,m_out( stdout )
+    ,m_fileCount( 0 )
+    ,m_errorCount( 0 )
+    ,m_queuedCount( 0 )
+    ,m_decodedSeconds( 0 )
+    ,m_bytesCopied( 0 )
+{
+    if ( m_threadCount < 1 )
+        m_threadCount = 1;
+
+    qRegisterMetaType<FingerprintJob*>( "FingerprintJob*" );
+}
+
+
+FingerprintBatch::~FingerprintBatch()
+{
+    {
+        QMutexLocker locker( &m_mutex );
+        m_exhausted = true;
+        m_jobAvailable.wakeAll();
+    }
+
+    qDeleteAll( m_workers );
+
+    foreach ( FingerprintJob* job, m_queue )
+    {
+        delete job->fp;
+        delete job;
+    }
+}
+
+
+bool
+FingerprintBatch::start()
+{
+    bool opened;
+
+    if ( m_manifestPath == "-" )
+    {
+        opened = m_manifestFile.open( stdin, QIODevice::ReadOnly | QIODevice::Text );
+    }
+    else
+    {
+        m_manifestFile.setFileName( m_manifestPath );
+        opened = m_manifestFile.open( QIODevice::ReadOnly | QIODevice::Text );
+    }
+
+    if ( !opened )
+    {
+        qWarning() << "Cannot open manifest" << m_manifestPath;
+        return false;
+    }
+
+    m_manifest.setDevice( &m_manifestFile );
+    m_manifest.setCodec( "UTF-8" );
+
+    av_lockmgr_register( lavLockManager );
+
+    m_time.start();
+    fillQueue();
+
+    for ( int i = 0 ; i < m_threadCount ; ++i )
+    {
+        FingerprintWorker* worker = new FingerprintWorker( this );
+        connect( worker, SIGNAL(generated(FingerprintJob*)), SLOT(onGenerated(FingerprintJob*)) );
+        connect( worker, SIGNAL(finished()), SLOT(onWorkerFinished()) );
+        m_workers << worker;
+        ++m_runningWorkers;
+        worker->start();
+    }
+
+    return true;
+}
+
+
+FingerprintJob*
+FingerprintBatch::takeJob()
+{
+    QMutexLocker locker( &m_mutex );
+
+    while ( m_queue.isEmpty() && !m_exhausted )
+        m_jobAvailable.wait( &m_mutex );
+
+    return m_queue.isEmpty() ? 0 : m_queue.dequeue();
+}
+
+
+lastfm::Track
+FingerprintBatch::parseLine( const QString& line )
+{
+    QStringList columns = line.split( '\t' );
+
+    lastfm::MutableTrack track;
+    track.setUrl( QUrl::fromLocalFile( columns.value( 0 ) ) );
+    if ( columns.value( 1 ).size() ) track.setArtist( columns.value( 1 ) );
+    if ( columns.value( 2 ).size() ) track.setAlbum( columns.value( 2 ) );
+    if ( columns.value( 3 ).size() ) track.setTitle( columns.value( 3 ) );
+    return track;
+}
+
+
+/** The high water mark of the process' resident memory, or -1 */
+qint64
+FingerprintBatch::peakMemoryKb()
+{
+#ifdef Q_OS_WIN
+    PROCESS_MEMORY_COUNTERS counters;
+    if ( GetProcessMemoryInfo( GetCurrentProcess(), &counters, sizeof( counters ) ) )
+        return counters.PeakWorkingSetSize / 1024;
+    return -1;
+#else
+    struct rusage usage;
+    if ( getrusage( RUSAGE_SELF, &usage ) != 0 )
+        return -1;
+#ifdef Q_OS_MAC
+    // bytes on Mac, kilobytes everywhere else
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+#endif
+}
+
+
+void
+FingerprintBatch::fillQueue()
+{
+    int wanted;
+    {
+        QMutexLocker locker( &m_mutex );
+        wanted = m_exhausted ? 0 : m_threadCount * 2 - m_queue.count();
+    }
+
+    // Read the manifest without holding the lock; stdin may block
+    QList<FingerprintJob*> jobs;
+    bool exhausted = false;
+
+    while ( jobs.count() < wanted )
+    {
+        QString line = m_manifest.readLine();
+
+        if ( line.isNull() )
+        {
+            exhausted = true;
+            break;
+        }
+
+        if ( line.trimmed().isEmpty() || line.startsWith( '#' ) )
+            continue;
+
+        FingerprintJob* job = new FingerprintJob;
+        job->track = parseLine( line );
+        ++m_fileCount;
+
+        if ( m_cache )
+        {
+            FingerprintCache::Entry cached = m_cache->lookup( job->track.url().toLocalFile() );
+            job->id = cached.id;
+            job->submission = cached.submission;
+
+            if ( job->id )
+            {
+                finishJob( job );
+                continue;
+            }
+        }
+
+        // Fingerprint's constructor queries the local collection database,
+        // which only works from the thread that created it
+        job->fp = new lastfm::Fingerprint( job->track );
+
+        if ( !job->fp->id().isNull() )
+        {
+            job->id = job->fp->id();
+            finishJob( job );
+        }
+        else if ( !job->submission.url.isEmpty() )
+        {
+            // generated before, but the server hasn't taken it yet
+            submit( job );
+        }
+        else
+        {
+            jobs << job;
+        }
+    }
+
+    QMutexLocker locker( &m_mutex );
+    foreach ( FingerprintJob* job, jobs )
+        m_queue.enqueue( job );
+    if ( exhausted )
+        m_exhausted = true;
+    m_jobAvailable.wakeAll();
+}
+
+
+void
+FingerprintBatch::onGenerated( FingerprintJob* job )
+{
+    m_decodedSeconds += job->decodedSeconds;
+    m_bytesCopied += job->bytesCopied;
+
+    if ( job->error.isEmpty() )
+    {
+        QString path = job->track.url().toLocalFile();
+
+        // only records the request, see FingerprintRecorder
+        QNetworkReply* reply = job->fp->submit();
+        job->submission = FingerprintQueue::recorded( reply, path, job->fp->data() );
+        reply->deleteLater();
+
+        if ( job->submission.url.isEmpty() )
+            job->error = "lastfm::nam() is not a FingerprintRecorder";
+        else if ( m_cache )
+            m_cache->store( path, 0, job->submission );
+    }
+
+    if ( job->error.isEmpty() )
+        submit( job );
+    else
+        finishJob( job );
+
+    fillQueue();
+}
+
+
+void
+FingerprintBatch::submit( FingerprintJob* job )
+{
+    if ( m_offline )
+    {
+        job->queued = m_offline->append( job->submission );
+        if ( !job->queued )
+            job->error = "Could not queue the fingerprint";
+
+        finishJob( job );
+        return;
+    }
+
+    QNetworkReply* reply = FingerprintRecorder::send( job->submission );
+    m_submitting[reply] = job;
+    connect( reply, SIGNAL(finished()), SLOT(onSubmitted()) );
+}
+
+
+void
+FingerprintBatch::onSubmitted()
+{
+    QNetworkReply* reply = static_cast<QNetworkReply*>( sender() );
+    FingerprintJob* job = m_submitting.take( reply );
+
+    if ( !job )
+        return;
+
+    try
+    {
+        job->fp->decode( reply );
+        job->id = job->fp->id();
+    }
+    catch ( const lastfm::Fingerprint::Error& error )
+    {
+        job->error = QString( "Fingerprint error %1" ).arg( static_cast<int>( error ) );
+    }
+
+    // the submission is already there from before we sent it
+    if ( m_cache && job->id )
+        m_cache->store( job->track.url().toLocalFile(), job->id, job->submission );
+
+    reply->deleteLater();
+    finishJob( job );
+}
+
+
+void
+FingerprintBatch::finishJob( FingerprintJob* job )
+{
+    QString path = job->track.url().toLocalFile();
+
+    if ( job->queued )
+    {
+        ++m_queuedCount;
+        m_out << "QUEUED\t-\t" << path << endl;
+    }
+    else if ( job->error.isEmpty() )
+    {
+        m_out << "OK\t" << job->id << '\t' << path << endl;
+    }
+    else
+    {
+        ++m_errorCount;
+        m_out << "ERROR\t" << job->error << '\t' << path << endl;
+    }
+
+    delete job->fp;
+    delete job;
+
+    checkFinished();
+}
+
+
+void
+FingerprintBatch::onWorkerFinished()
+{
+    --m_runningWorkers;
+    checkFinished();
+}
+
+
+void
+FingerprintBatch::checkFinished()
+{
+    if ( m_runningWorkers > 0 || !m_submitting.isEmpty() )
+        return;
+
+    {
+        QMutexLocker locker( &m_mutex );
+        if ( !m_exhausted || !m_queue.isEmpty() )
+            return;
+    }
+
+    double elapsed = m_time.elapsed() / 1000.0;
+    if ( elapsed <= 0 )
+        elapsed = 0.001;
+
+    m_out << "SUMMARY"
+          << "\tfiles=" << m_fileCount
+          << "\terrors=" << m_errorCount
+          << "\tqueued=" << m_queuedCount
+          << "\tthreads=" << m_threadCount
+          << "\telapsed=" << elapsed
+          << "\tfiles_per_sec=" << m_fileCount / elapsed
+          << "\taudio_secs_per_sec=" << m_decodedSeconds / elapsed
+          << "\tbytes_copied_per_sec=" << qint64( m_bytesCopied / elapsed )
+          << "\tpeak_rss_kb=" << peakMemoryKb()
+          << "\tcache_hits=" << ( m_cache ? m_cache->hits() : 0 )
+          << "\tcache_misses=" << ( m_cache ? m_cache->misses() : 0 )
+          << endl;
+
+    emit finished( m_errorCount );
+}
@@ -0,0 +1,160 @@
+/*
+   Copyright 2013 Last.fm Ltd.
+
+   This file is part of liblastfm.
+
+   liblastfm is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   liblastfm is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with liblastfm.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FINGERPRINT_BATCH_H
+#define FINGERPRINT_BATCH_H
+
+#include <QObject>
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QQueue>
+#include <QMap>
+#include <QFile>
+#include <QTextStream>
+#include <QTime>
+
+#include <lastfm/Track.h>
+
+#include "FingerprintQueue.h"
+
+namespace lastfm { class Fingerprint; }
+class QNetworkReply;
+class LAV_Source;
+class FingerprintCache;
+class FingerprintBatch;
+
+
+/** One line of the manifest on its way through the batch */
+struct FingerprintJob
+{
+    FingerprintJob() : fp( 0 ), id( 0 ), queued( false ), decodedSeconds( 0 ), bytesCopied( 0 ) {}
+
+    lastfm::Track track;
+    lastfm::Fingerprint* fp;
+    FingerprintQueue::Entry submission;
+    int id;
+    QString error;
+    bool queued;
+    double decodedSeconds;
+    quint64 bytesCopied;
+};
+
+Q_DECLARE_METATYPE(FingerprintJob*)
+
+
+/** Decodes and generates fingerprints for jobs taken from the batch queue.
+  * Each worker owns its LAV_Source for its whole lifetime */
+class FingerprintWorker : public QThread
+{
+    Q_OBJECT
+public:
+    FingerprintWorker( FingerprintBatch* batch );
+    ~FingerprintWorker();
+
+    void run();
+
+signals:
+    void generated( FingerprintJob* job );
+
+private:
+    FingerprintBatch* m_batch;
+    LAV_Source* m_source;
+};
+
+
+/** Fingerprints every file listed in a manifest using a pool of worker
+  * threads, one per core by default.
+  *
+  * Manifest lines are tab separated: path [artist [album [title]]]
+  * Blank lines and lines starting with '#' are ignored, "-" reads stdin.
+  *
+  * Results are written to stdout one per line:
+  *     OK <tab> fingerprint id <tab> path
+  *     ERROR <tab> message <tab> path
+  *     QUEUED <tab> - <tab> path
+  * followed by a single SUMMARY line once the manifest is exhausted.
+  * QUEUED means we're offline and the fingerprint is waiting in the queue.
+  *
+  * lastfm::nam() must be a FingerprintRecorder, so the submission can be
+  * kept in the cache before it is sent or queued. Files the cache has a
+  * submission for are sent again without being decoded.
+  *
+  * Decoding happens in the workers, but everything that touches the network
+  * or liblastfm's local collection database stays on the main thread. */
+class FingerprintBatch : public QObject
+{
+    Q_OBJECT
+public:
+    /** cache may be 0, otherwise it is used to skip files we've seen before.
+      * If queue isn't 0 we're offline, and submissions go there instead */
+    FingerprintBatch( const QString& manifest, FingerprintCache* cache, FingerprintQueue* queue = 0, int threadCount = 0, QObject* parent = 0 );
+    ~FingerprintBatch();
+
+    /** returns false if the manifest couldn't be opened */
+    bool start();
+
+    /** blocks until a job is available, returns 0 once the manifest is done */
+    FingerprintJob* takeJob();
+
+    int errorCount() const { return m_errorCount; }
+
+signals:
+    void finished( int errorCount );
+
+private slots:
+    void onGenerated( FingerprintJob* job );
+    void onSubmitted();
+    void onWorkerFinished();
+
+private:
+    void fillQueue();
+    void submit( FingerprintJob* job );
+    void finishJob( FingerprintJob* job );
+    void checkFinished();
+
+    static lastfm::Track parseLine( const QString& line );
+    static qint64 peakMemoryKb();
+
+    QString m_manifestPath;
+    FingerprintCache* m_cache;
+    FingerprintQueue* m_offline;
+    QFile m_manifestFile;
+    QTextStream m_manifest;
+    int m_threadCount;
+    QList<FingerprintWorker*> m_workers;
+    int m_runningWorkers;
+
+    QMutex m_mutex;
+    QWaitCondition m_jobAvailable;
+    QQueue<FingerprintJob*> m_queue;
+    bool m_exhausted;
+
+    QMap<QNetworkReply*, FingerprintJob*> m_submitting;
+
+    QTextStream m_out;
+    QTime m_time;
+    int m_fileCount;
+    int m_errorCount;
+    int m_queuedCount;
+    double m_decodedSeconds;
+    quint64 m_bytesCopied;
+};
+
+#endif
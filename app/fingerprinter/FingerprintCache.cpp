@@ -0,0 +1,247 @@
+/*
+   Copyright 2013 Last.fm Ltd.
+
+   This file is part of liblastfm.
+
+   liblastfm is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   liblastfm is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with liblastfm.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <QCryptographicHash>
+#include <QFile>
+#include <QFileInfo>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QSqlRecord>
+#include <QVariant>
+#include <QDebug>
+
+#include <lastfm/misc.h>
+
+#ifndef Q_OS_WIN
+#include <sys/stat.h>
+#endif
+
+#include "FingerprintCache.h"
+
+#define TABLE_NAME "fingerprints"
+#define SCHEMA "device          INTEGER," \
+               "inode           INTEGER," \
+               "size            INTEGER," \
+               "mtime           INTEGER," \
+               "hash            VARCHAR( 32 )," \
+               "fpid            INTEGER," \
+               "submission      BLOB"
+
+static const qint64 HASH_CHUNK_SIZE = 64 * 1024;
+
+
+FingerprintCache::FingerprintCache( const QString& path )
+    :m_hits( 0 )
+    ,m_misses( 0 )
+{
+    QString dbPath = path.isEmpty() ? lastfm::dir::runtimeData().filePath( "fingerprints.db" ) : path;
+    m_connectionName = "FingerprintCache:" + dbPath;
+
+    m_db = QSqlDatabase::addDatabase( "QSQLITE", m_connectionName );
+    m_db.setDatabaseName( dbPath );
+
+    if ( !m_db.open() )
+    {
+        qWarning() << "Could not open fingerprint cache" << dbPath << m_db.lastError().text();
+        return;
+    }
+
+    // the first version kept only the fingerprint, which we can't submit
+    if ( m_db.tables().contains( TABLE_NAME ) && !m_db.record( TABLE_NAME ).contains( "submission" ) )
+        QSqlQuery( m_db ).exec( "DROP TABLE " TABLE_NAME ";" );
+
+    if ( !m_db.tables().contains( TABLE_NAME ) )
+    {
+        QSqlQuery query( m_db );
+        query.exec( "CREATE TABLE " TABLE_NAME " ( " SCHEMA ", PRIMARY KEY ( device, inode, size, mtime ) );" );
+        query.exec( "CREATE INDEX hash_idx ON " TABLE_NAME " ( hash, size );" );
+    }
+
+    // A lost cache entry just means decoding the file again, so don't wait
+    // for the disk on every insert
+    QSqlQuery( m_db ).exec( "PRAGMA synchronous = OFF;" );
+}
+
+
+FingerprintCache::~FingerprintCache()
+{
+    m_db.close();
+    m_db = QSqlDatabase();
+    QSqlDatabase::removeDatabase( m_connectionName );
+}
+
+
+FingerprintCache::Identity
+FingerprintCache::identity( const QString& filePath )
+{
+    Identity id;
+
+#ifdef Q_OS_WIN
+    QFileInfo info( filePath );
+    id.size = info.size();
+    id.mtime = info.lastModified().toTime_t();
+#else
+    struct stat st;
+    if ( ::stat( QFile::encodeName( filePath ), &st ) == 0 )
+    {
+        id.device = st.st_dev;
+        id.inode = st.st_ino;
+        id.size = st.st_size;
+        id.mtime = st.st_mtime;
+    }
+#endif
+
+    return id;
+}
+
+
+QByteArray
+FingerprintCache::contentHash( const QString& filePath, qint64 size )
+{
+    QFile file( filePath );
+    if ( !file.open( QIODevice::ReadOnly ) )
+        return QByteArray();
+
+    QCryptographicHash hash( QCryptographicHash::Md5 );
+    hash.addData( file.read( HASH_CHUNK_SIZE ) );
+
+    if ( size > HASH_CHUNK_SIZE )
+    {
+        file.seek( qMax( HASH_CHUNK_SIZE, size - HASH_CHUNK_SIZE ) );
+        hash.addData( file.read( HASH_CHUNK_SIZE ) );
+    }
+
+    return hash.result().toHex();
+}
+
+
+FingerprintCache::Entry
+FingerprintCache::entry( const QSqlQuery& query )
+{
+    Entry entry;
+    entry.id = query.value( 0 ).toInt();
+
+    QByteArray submission = query.value( 1 ).toByteArray();
+    QDataStream in( submission );
+    in >> entry.submission;
+
+    return entry;
+}
+
+
+FingerprintCache::Entry
+FingerprintCache::lookup( const QString& filePath )
+{
+    Entry entry;
+
+    if ( !m_db.isOpen() )
+        return entry;
+
+    Identity id = identity( filePath );
+
+    if ( id.isValid() )
+    {
+        QSqlQuery query( m_db );
+        query.prepare( "SELECT fpid, submission FROM " TABLE_NAME " "
+                       "WHERE device = :device AND inode = :inode AND size = :size AND mtime = :mtime LIMIT 1" );
+        query.bindValue( ":device", id.device );
+        query.bindValue( ":inode", id.inode );
+        query.bindValue( ":size", id.size );
+        query.bindValue( ":mtime", id.mtime );
+
+        if ( query.exec() && query.first() )
+        {
+            entry = FingerprintCache::entry( query );
+            entry.submission.path = filePath;
+            ++m_hits;
+            return entry;
+        }
+    }
+
+    QByteArray hash = contentHash( filePath, id.size );
+
+    if ( !hash.isEmpty() )
+    {
+        m_hashes[filePath] = hash;
+
+        QSqlQuery query( m_db );
+        query.prepare( "SELECT fpid, submission FROM " TABLE_NAME " WHERE hash = :hash AND size = :size LIMIT 1" );
+        query.bindValue( ":hash", QString::fromLatin1( hash ) );
+        query.bindValue( ":size", id.size );
+
+        if ( query.exec() && query.first() )
+        {
+            entry = FingerprintCache::entry( query );
+            ++m_hits;
+
+            // remember this identity so next time we don't need to hash
+            entry.submission.path = filePath;
+            store( filePath, entry.id, entry.submission );
+            return entry;
+        }
+    }
+
+    ++m_misses;
+    return entry;
+}
+
+
+void
+FingerprintCache::store( const QString& filePath, int fpid, const FingerprintQueue::Entry& submission )
+{
+    if ( !m_db.isOpen() )
+        return;
+
+    Identity id = identity( filePath );
+
+    QByteArray hash = m_hashes.take( filePath );
+    if ( hash.isEmpty() )
+        hash = contentHash( filePath, id.size );
+
+    // Without an inode, size and mtime alone would replace the row of any
+    // other file that happens to share them, so key on the hash instead.
+    // lookup() never matches these on identity, only on hash
+    if ( !id.isValid() )
+    {
+        if ( hash.isEmpty() )
+            return;
+
+        id.inode = hash.left( 15 ).toLongLong( 0, 16 );
+    }
+
+    QByteArray data;
+    {
+        QDataStream out( &data, QIODevice::WriteOnly );
+        out << submission;
+    }
+
+    QSqlQuery query( m_db );
+    query.prepare( "INSERT OR REPLACE INTO " TABLE_NAME " ( device, inode, size, mtime, hash, fpid, submission ) "
+                   "VALUES ( :device, :inode, :size, :mtime, :hash, :fpid, :submission )" );
+    query.bindValue( ":device", id.device );
+    query.bindValue( ":inode", id.inode );
+    query.bindValue( ":size", id.size );
+    query.bindValue( ":mtime", id.mtime );
+    query.bindValue( ":hash", QString::fromLatin1( hash ) );
+    query.bindValue( ":fpid", fpid );
+    query.bindValue( ":submission", data );
+
+    if ( !query.exec() )
+        qWarning() << query.lastError().text() << "in query:\n" << query.lastQuery();
+}
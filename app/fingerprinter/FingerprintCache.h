@@ -0,0 +1,100 @@
+/*
+   Copyright 2013 Last.fm Ltd.
+
+   This file is part of liblastfm.
+
+   liblastfm is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   liblastfm is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with liblastfm.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FINGERPRINT_CACHE_H
+#define FINGERPRINT_CACHE_H
+
+#include <QString>
+#include <QByteArray>
+#include <QHash>
+#include <QSqlDatabase>
+
+class QSqlQuery;
+
+#include "FingerprintQueue.h"
+
+
+/** Remembers the fingerprints we've already generated so that unchanged
+  * files never need to be decoded again.
+  *
+  * Along with the id we keep the request that submits the fingerprint, so
+  * one that was queued offline or that the server didn't take can be sent
+  * again without decoding the file.
+  *
+  * Files are identified by (device, inode, size, mtime). If that doesn't
+  * match, for instance because the file was copied or we're on a filesystem
+  * without inodes, we fall back to a hash of the first and last 64 KiB.
+  *
+  * Only use this from the thread that created it. */
+class FingerprintCache
+{
+public:
+    struct Entry
+    {
+        Entry() : id( 0 ) {}
+
+        /** true if we've never generated a fingerprint for the file */
+        bool isNull() const { return id == 0 && submission.url.isEmpty(); }
+
+        /** 0 if the fingerprint was generated but the server hasn't
+          * given us an id for it yet */
+        int id;
+        FingerprintQueue::Entry submission;
+    };
+
+    /** defaults to fingerprints.db in lastfm::dir::runtimeData() */
+    FingerprintCache( const QString& path = QString() );
+    ~FingerprintCache();
+
+    /** anything that saves decoding the file counts as a hit */
+    Entry lookup( const QString& filePath );
+    void store( const QString& filePath, int id, const FingerprintQueue::Entry& submission );
+
+    int hits() const { return m_hits; }
+    int misses() const { return m_misses; }
+
+private:
+    struct Identity
+    {
+        Identity() : device( 0 ), inode( 0 ), size( 0 ), mtime( 0 ) {}
+
+        /** false where the filesystem doesn't give us inodes */
+        bool isValid() const { return inode != 0; }
+
+        qint64 device;
+        qint64 inode;
+        qint64 size;
+        qint64 mtime;
+    };
+
+    static Identity identity( const QString& filePath );
+    static QByteArray contentHash( const QString& filePath, qint64 size );
+    static Entry entry( const QSqlQuery& query );
+
+    QSqlDatabase m_db;
+    QString m_connectionName;
+
+    // hashes computed by lookup() that store() will probably want next
+    QHash<QString, QByteArray> m_hashes;
+
+    int m_hits;
+    int m_misses;
+};
+
+#endif
@@ -0,0 +1,399 @@
+/*
+   Copyright 2013 Last.fm Ltd.
+
+   This file is part of liblastfm.
+
+   liblastfm is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   liblastfm is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with liblastfm.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <QDataStream>
+#include <QTimer>
+#include <QDebug>
+
+#include <lastfm/misc.h>
+#include <lastfm/ws.h>
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#include <io.h>
+#else
+#include <sys/file.h>
+#include <unistd.h>
+#endif
+
+#include "FingerprintQueue.h"
+
+// Each entry is written as a length followed by this many bytes of
+// QDataStream, so a half written entry at the end can be spotted
+static const quint32 ENTRY_MAGIC = 0x46505131; // "FPQ1"
+
+
+/** flush() only gets as far as the OS */
+static bool
+syncFile( QFile& file )
+{
+    if ( !file.flush() )
+        return false;
+
+#ifdef Q_OS_WIN
+    return _commit( file.handle() ) == 0;
+#else
+    return ::fsync( file.handle() ) == 0;
+#endif
+}
+
+
+/** an exclusive lock on the whole file, shared with other processes */
+static bool
+lockFile( QFile& file, bool wait )
+{
+#ifdef Q_OS_WIN
+    OVERLAPPED overlapped = {0};
+    DWORD flags = LOCKFILE_EXCLUSIVE_LOCK | ( wait ? 0 : LOCKFILE_FAIL_IMMEDIATELY );
+    return LockFileEx( (HANDLE)_get_osfhandle( file.handle() ), flags, 0, MAXDWORD, MAXDWORD, &overlapped );
+#else
+    return ::flock( file.handle(), LOCK_EX | ( wait ? 0 : LOCK_NB ) ) == 0;
+#endif
+}
+
+
+static void
+unlockFile( QFile& file )
+{
+#ifdef Q_OS_WIN
+    OVERLAPPED overlapped = {0};
+    UnlockFileEx( (HANDLE)_get_osfhandle( file.handle() ), 0, MAXDWORD, MAXDWORD, &overlapped );
+#else
+    ::flock( file.handle(), LOCK_UN );
+#endif
+}
+
+
+/** holds the queue's lock for as long as it's in scope */
+class QueueLocker
+{
+public:
+    QueueLocker( QFile& file ) : m_file( file ) { lockFile( m_file, true ); }
+    ~QueueLocker() { unlockFile( m_file ); }
+
+private:
+    QFile& m_file;
+};
+
+
+FingerprintQueue::FingerprintQueue( const QString& path )
+{
+    QString queuePath = path.isEmpty() ? lastfm::dir::runtimeData().filePath( "fingerprint_queue" ) : path;
+
+    m_file.setFileName( queuePath );
+    m_cursorPath = queuePath + ".pos";
+    m_uploadLock.setFileName( queuePath + ".upload" );
+
+    // other processes change it under us, so don't let QFile keep any of it
+    if ( !m_file.open( QIODevice::ReadWrite | QIODevice::Unbuffered ) )
+    {
+        qWarning() << "Could not open fingerprint queue" << queuePath << m_file.errorString();
+        return;
+    }
+
+    QueueLocker locker( m_file );
+    load();
+}
+
+
+bool
+FingerprintQueue::claimUploads()
+{
+    if ( m_uploadLock.isOpen() )
+        return true;
+
+    if ( !m_uploadLock.open( QIODevice::ReadWrite ) )
+        return false;
+
+    // released when the file is closed, even if we crash
+    if ( lockFile( m_uploadLock, false ) )
+        return true;
+
+    m_uploadLock.close();
+    return false;
+}
+
+
+int
+FingerprintQueue::count()
+{
+    if ( !m_file.isOpen() )
+        return 0;
+
+    QueueLocker locker( m_file );
+    load();
+    return m_offsets.count();
+}
+
+
+/** call with the lock held */
+void
+FingerprintQueue::load()
+{
+    m_offsets.clear();
+    m_paths.clear();
+    m_pathSet.clear();
+
+    qint64 cursor = 0;
+
+    QFile cursorFile( m_cursorPath );
+    if ( cursorFile.open( QIODevice::ReadOnly ) )
+        cursor = cursorFile.readAll().trimmed().toLongLong();
+
+    if ( cursor < 0 || cursor > m_file.size() )
+        cursor = 0;
+
+    m_file.seek( cursor );
+    QDataStream in( &m_file );
+    qint64 offset = cursor;
+
+    for (;;)
+    {
+        quint32 magic, length;
+        in >> magic >> length;
+
+        if ( in.status() != QDataStream::Ok || magic != ENTRY_MAGIC
+             || m_file.size() - m_file.pos() < length )
+            break;
+
+        // the path comes first
+        qint64 next = m_file.pos() + length;
+        QString path;
+        in >> path;
+
+        m_offsets << offset;
+        m_paths << path;
+        m_pathSet.insert( path );
+        m_file.seek( next );
+        offset = next;
+    }
+
+    // Throw away anything we didn't finish writing last time
+    if ( offset < m_file.size() )
+    {
+        qWarning() << "Dropping" << m_file.size() - offset << "bytes from the end of the fingerprint queue";
+        m_file.resize( offset );
+    }
+}
+
+
+void
+FingerprintQueue::saveCursor( qint64 cursor )
+{
+    QFile cursorFile( m_cursorPath + ".new" );
+
+    if ( cursorFile.open( QIODevice::WriteOnly | QIODevice::Truncate ) )
+    {
+        cursorFile.write( QByteArray::number( cursor ) );
+        cursorFile.close();
+
+        // QFile::rename won't overwrite
+        QFile::remove( m_cursorPath );
+        cursorFile.rename( m_cursorPath );
+    }
+}
+
+
+bool
+FingerprintQueue::append( const Entry& entry )
+{
+    if ( !m_file.isOpen() )
+        return false;
+
+    QueueLocker locker( m_file );
+    load();
+
+    if ( m_pathSet.contains( entry.path ) )
+        return true;
+
+    QByteArray bytes;
+    {
+        QDataStream out( &bytes, QIODevice::WriteOnly );
+        out << entry;
+    }
+
+    qint64 offset = m_file.size();
+    m_file.seek( offset );
+
+    QDataStream out( &m_file );
+    out << ENTRY_MAGIC << quint32( bytes.size() );
+    out.writeRawData( bytes.constData(), bytes.size() );
+
+    if ( out.status() != QDataStream::Ok || !syncFile( m_file ) )
+    {
+        qWarning() << "Could not write to the fingerprint queue" << m_file.errorString();
+        m_file.resize( offset );
+        return false;
+    }
+
+    m_offsets << offset;
+    m_paths << entry.path;
+    m_pathSet.insert( entry.path );
+    return true;
+}
+
+
+FingerprintQueue::Entry
+FingerprintQueue::recorded( QNetworkReply* reply, const QString& path, const QByteArray& data )
+{
+    Entry entry;
+    RecordedReply* recorded = qobject_cast<RecordedReply*>( reply );
+
+    if ( !recorded )
+        return entry;
+
+    entry.path = path;
+    entry.url = recorded->url();
+    entry.contentType = recorded->request().header( QNetworkRequest::ContentTypeHeader ).toByteArray();
+    entry.body = recorded->body();
+    entry.data = data;
+    return entry;
+}
+
+
+QList<FingerprintQueue::Entry>
+FingerprintQueue::pending( int max )
+{
+    QList<Entry> entries;
+
+    if ( !m_file.isOpen() )
+        return entries;
+
+    QueueLocker locker( m_file );
+    load();
+
+    for ( int i = 0; i < m_offsets.count() && i < max; ++i )
+    {
+        // skip the magic and length
+        m_file.seek( m_offsets[i] + 8 );
+
+        QDataStream in( &m_file );
+        Entry entry;
+        in >> entry;
+
+        entries << entry;
+    }
+
+    return entries;
+}
+
+
+void
+FingerprintQueue::markDone( int count )
+{
+    if ( !m_file.isOpen() )
+        return;
+
+    // Only whoever claimed the uploads takes entries off the front, so the
+    // first count are still the ones they were given
+    QueueLocker locker( m_file );
+    load();
+
+    count = qMin( count, m_offsets.count() );
+    if ( count <= 0 )
+        return;
+
+    m_offsets.erase( m_offsets.begin(), m_offsets.begin() + count );
+
+    for ( int i = 0; i < count; ++i )
+        m_pathSet.remove( m_paths.takeFirst() );
+
+    if ( m_offsets.isEmpty() )
+    {
+        // everything's been uploaded, start afresh
+        m_file.resize( 0 );
+        saveCursor( 0 );
+    }
+    else
+    {
+        saveCursor( m_offsets.first() );
+    }
+}
+
+
+QDataStream&
+operator<<( QDataStream& out, const FingerprintQueue::Entry& entry )
+{
+    return out << entry.path << entry.url.toEncoded() << entry.contentType << entry.body << entry.data;
+}
+
+
+QDataStream&
+operator>>( QDataStream& in, FingerprintQueue::Entry& entry )
+{
+    QByteArray url;
+    in >> entry.path >> url >> entry.contentType >> entry.body >> entry.data;
+    entry.url = QUrl::fromEncoded( url );
+    return in;
+}
+
+
+FingerprintRecorder::FingerprintRecorder( QObject* parent )
+    :QNetworkAccessManager( parent )
+    ,m_sending( false )
+{
+}
+
+
+QNetworkReply*
+FingerprintRecorder::send( const FingerprintQueue::Entry& entry, QNetworkAccessManager* nam )
+{
+    if ( !nam )
+        nam = lastfm::nam();
+
+    QNetworkRequest request( entry.url );
+    request.setHeader( QNetworkRequest::ContentTypeHeader, entry.contentType );
+
+    FingerprintRecorder* recorder = qobject_cast<FingerprintRecorder*>( nam );
+
+    // post() creates the request before it returns
+    if ( recorder )
+        recorder->m_sending = true;
+
+    QNetworkReply* reply = nam->post( request, entry.body );
+
+    if ( recorder )
+        recorder->m_sending = false;
+
+    return reply;
+}
+
+
+QNetworkReply*
+FingerprintRecorder::createRequest( Operation op, const QNetworkRequest& request, QIODevice* outgoingData )
+{
+    if ( m_sending || op != PostOperation || !request.url().path().contains( "fingerprint" ) )
+        return QNetworkAccessManager::createRequest( op, request, outgoingData );
+
+    return new RecordedReply( request, outgoingData ? outgoingData->readAll() : QByteArray(), this );
+}
+
+
+RecordedReply::RecordedReply( const QNetworkRequest& request, const QByteArray& body, QObject* parent )
+    :QNetworkReply( parent )
+    ,m_body( body )
+{
+    setRequest( request );
+    setUrl( request.url() );
+    setOperation( QNetworkAccessManager::PostOperation );
+    open( QIODevice::ReadOnly );
+
+    // callers connect to finished() after we return
+    QTimer::singleShot( 0, this, SIGNAL(finished()) );
+}
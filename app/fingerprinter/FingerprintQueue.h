@@ -0,0 +1,147 @@
+/*
+   Copyright 2013 Last.fm Ltd.
+
+   This file is part of liblastfm.
+
+   liblastfm is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   liblastfm is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with liblastfm.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FINGERPRINT_QUEUE_H
+#define FINGERPRINT_QUEUE_H
+
+#include <QDataStream>
+#include <QFile>
+#include <QList>
+#include <QSet>
+#include <QStringList>
+#include <QUrl>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+
+
+/** Fingerprint submissions waiting to be uploaded.
+  *
+  * Entries are appended to a file and synced to the disk before append()
+  * returns, so a crash or a restart loses nothing. A second small file
+  * remembers how far the uploader has got; once everything has been
+  * uploaded both are emptied.
+  *
+  * A file only has one entry waiting at a time, so fingerprinting it again
+  * before the queue is drained doesn't send it twice.
+  *
+  * Each entry is the exact request lastfm::Fingerprint::submit() made, as
+  * captured by FingerprintRecorder, plus the file and fingerprint it came
+  * from so the cache can be updated once we know the id.
+  *
+  * The client runs a fingerprinter per track, so several processes can
+  * have the same queue open. Each call locks the file and reads it again
+  * before touching it, and only the process that claimUploads() may take
+  * entries off the front.
+  *
+  * Only use this from the thread that created it. */
+class FingerprintQueue
+{
+public:
+    struct Entry
+    {
+        QString path;
+        QUrl url;
+        QByteArray contentType;
+        QByteArray body;
+        QByteArray data;
+    };
+
+    /** defaults to fingerprint_queue in lastfm::dir::runtimeData() */
+    FingerprintQueue( const QString& path = QString() );
+
+    /** @return true if it is in the queue, whether just now or before */
+    bool append( const Entry& entry );
+
+    /** the request a FingerprintRecorder reply captured, with an empty url
+      * if the reply wasn't from a FingerprintRecorder */
+    static Entry recorded( QNetworkReply* reply, const QString& path, const QByteArray& data );
+
+    /** the first max entries that haven't been uploaded yet, oldest first */
+    QList<Entry> pending( int max );
+
+    /** forgets the first count pending entries */
+    void markDone( int count );
+
+    /** @return false if another process is uploading the queue already.
+      * Otherwise nobody else can until this queue is destroyed */
+    bool claimUploads();
+
+    int count();
+
+private:
+    void load();
+    void saveCursor( qint64 cursor );
+
+    QFile m_file;
+    QString m_cursorPath;
+    QFile m_uploadLock;
+
+    // where each pending entry starts in m_file, and the file it's for
+    QList<qint64> m_offsets;
+    QStringList m_paths;
+    QSet<QString> m_pathSet;
+};
+
+QDataStream& operator<<( QDataStream& out, const FingerprintQueue::Entry& entry );
+QDataStream& operator>>( QDataStream& in, FingerprintQueue::Entry& entry );
+
+
+/** Stands in for lastfm::nam() so we get to keep fingerprint submissions.
+  *
+  * Fingerprint submissions aren't sent anywhere. The reply finishes
+  * straight away and carries the request, ready for
+  * FingerprintQueue::recorded(), and send() posts it for real when we're
+  * online. Everything else goes to the network as usual. */
+class FingerprintRecorder : public QNetworkAccessManager
+{
+    Q_OBJECT
+public:
+    FingerprintRecorder( QObject* parent = 0 );
+
+    /** posts a recorded submission for real, through nam or by default
+      * lastfm::nam(), without recording it again */
+    static QNetworkReply* send( const FingerprintQueue::Entry& entry, QNetworkAccessManager* nam = 0 );
+
+protected:
+    QNetworkReply* createRequest( Operation op, const QNetworkRequest& request, QIODevice* outgoingData );
+
+private:
+    bool m_sending;
+};
+
+
+class RecordedReply : public QNetworkReply
+{
+    Q_OBJECT
+public:
+    RecordedReply( const QNetworkRequest& request, const QByteArray& body, QObject* parent );
+
+    void abort() {}
+    qint64 bytesAvailable() const { return 0; }
+
+    const QByteArray& body() const { return m_body; }
+
+protected:
+    qint64 readData( char*, qint64 ) { return -1; }
+
+private:
+    QByteArray m_body;
+};
+
+#endif
@@ -0,0 +1,194 @@
+/*
+   Copyright 2013 Last.fm Ltd.
+
+   This file is part of liblastfm.
+
+   liblastfm is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   liblastfm is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with liblastfm.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QTimer>
+#include <QDebug>
+
+#include <lastfm/ws.h>
+
+#include "FingerprintCache.h"
+#include "FingerprintUploader.h"
+
+
+FingerprintUploader::FingerprintUploader( FingerprintQueue* queue, FingerprintCache* cache, QNetworkAccessManager* nam, QObject* parent )
+    :QObject( parent )
+    ,m_queue( queue )
+    ,m_cache( cache )
+    ,m_nam( nam ? nam : lastfm::nam() )
+    ,m_batchSize( 8 )
+    ,m_firstDelay( 1000 )
+    ,m_maxDelay( 5 * 60 * 1000 )
+    ,m_maxAttempts( 10 )
+    ,m_attempts( 0 )
+    ,m_delay( 0 )
+    ,m_uploaded( 0 )
+    ,m_dropped( 0 )
+{
+}
+
+
+void
+FingerprintUploader::setRetry( int firstDelayMs, int maxDelayMs, int maxAttempts )
+{
+    m_firstDelay = firstDelayMs;
+    m_maxDelay = maxDelayMs;
+    m_maxAttempts = maxAttempts;
+}
+
+
+void
+FingerprintUploader::start()
+{
+    m_delay = m_firstDelay;
+    m_attempts = 0;
+    sendBatch();
+}
+
+
+void
+FingerprintUploader::sendBatch()
+{
+    m_batch = m_queue->pending( m_batchSize );
+
+    if ( m_batch.isEmpty() )
+    {
+        emit finished( 0 );
+        return;
+    }
+
+    m_results.clear();
+    for ( int i = 0; i < m_batch.count(); ++i )
+        m_results << Retry;
+
+    sendRetries();
+}
+
+
+void
+FingerprintUploader::sendRetries()
+{
+    ++m_attempts;
+
+    for ( int i = 0; i < m_batch.count(); ++i )
+    {
+        if ( m_results[i] != Retry )
+            continue;
+
+        FingerprintQueue::Entry entry = m_batch[i];
+
+        if ( m_baseUrl.isValid() )
+        {
+            entry.url.setScheme( m_baseUrl.scheme() );
+            entry.url.setHost( m_baseUrl.host() );
+            entry.url.setPort( m_baseUrl.port() );
+        }
+
+        // m_nam is usually the FingerprintRecorder that recorded them
+        QNetworkReply* reply = FingerprintRecorder::send( entry, m_nam );
+        connect( reply, SIGNAL(finished()), SLOT(onReplyFinished()) );
+
+        m_replies[reply] = i;
+        m_results[i] = Pending;
+    }
+}
+
+
+void
+FingerprintUploader::onReplyFinished()
+{
+    QNetworkReply* reply = static_cast<QNetworkReply*>( sender() );
+    reply->deleteLater();
+
+    if ( !m_replies.contains( reply ) )
+        return;
+
+    int index = m_replies.take( reply );
+    const FingerprintQueue::Entry& entry = m_batch[index];
+    int status = reply->attribute( QNetworkRequest::HttpStatusCodeAttribute ).toInt();
+
+    if ( reply->error() == QNetworkReply::NoError )
+    {
+        // the same "<id> <status>" response lastfm::Fingerprint::decode reads
+        QList<QByteArray> response = reply->readAll().split( ' ' );
+        bool ok;
+        uint id = response.value( 0 ).trimmed().toUInt( &ok );
+
+        if ( ok && id )
+        {
+            ++m_uploaded;
+            if ( m_cache )
+                m_cache->store( entry.path, id, entry );
+        }
+        else
+        {
+            qWarning() << "Dropping fingerprint the server didn't understand:" << entry.path;
+            ++m_dropped;
+        }
+
+        m_results[index] = Done;
+    }
+    else if ( status == 0 || status >= 500 || status == 408 || status == 429 )
+    {
+        m_results[index] = Retry;
+    }
+    else
+    {
+        qWarning() << "Dropping fingerprint after HTTP" << status << ":" << entry.path;
+        ++m_dropped;
+        m_results[index] = Done;
+    }
+
+    if ( m_replies.isEmpty() )
+        batchFinished();
+}
+
+
+void
+FingerprintUploader::batchFinished()
+{
+    // The queue can only forget entries from the front
+    int done = m_results.indexOf( Retry );
+    if ( done == -1 )
+        done = m_results.count();
+
+    m_queue->markDone( done );
+    m_batch.erase( m_batch.begin(), m_batch.begin() + done );
+    m_results.erase( m_results.begin(), m_results.begin() + done );
+
+    if ( m_batch.isEmpty() )
+    {
+        m_attempts = 0;
+        m_delay = m_firstDelay;
+        sendBatch();
+        return;
+    }
+
+    if ( m_attempts >= m_maxAttempts )
+    {
+        qWarning() << "Giving up on the fingerprint queue for now," << m_queue->count() << "left";
+        emit finished( m_queue->count() );
+        return;
+    }
+
+    qDebug() << "Retrying fingerprint uploads in" << m_delay << "ms";
+    QTimer::singleShot( m_delay, this, SLOT(sendRetries()) );
+    m_delay = qMin( m_delay * 2, m_maxDelay );
+}
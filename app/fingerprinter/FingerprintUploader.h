@@ -0,0 +1,104 @@
+/*
+   Copyright 2013 Last.fm Ltd.
+
+   This file is part of liblastfm.
+
+   liblastfm is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   liblastfm is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with liblastfm.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FINGERPRINT_UPLOADER_H
+#define FINGERPRINT_UPLOADER_H
+
+#include <QObject>
+#include <QMap>
+#include <QUrl>
+
+#include "FingerprintQueue.h"
+
+class QNetworkAccessManager;
+class QNetworkReply;
+class FingerprintCache;
+
+
+/** Drains a FingerprintQueue, which the caller should have claimed with
+  * FingerprintQueue::claimUploads().
+  *
+  * The server takes one fingerprint per request, so a batch is several
+  * requests in flight at once over the same connections. Entries are only
+  * marked done once the server has answered them and everything before
+  * them, so quitting part way through just means some are sent again next
+  * time.
+  *
+  * Network errors, 5xx, 408 and 429 responses are retried after a delay
+  * that doubles each time, up to a limit. Only the failed requests are
+  * sent again. Other errors mean the server will never accept the entry,
+  * so it is dropped. */
+class FingerprintUploader : public QObject
+{
+    Q_OBJECT
+public:
+    /** cache may be 0, otherwise the ids we get back are stored in it.
+      * nam defaults to lastfm::nam() */
+    FingerprintUploader( FingerprintQueue* queue, FingerprintCache* cache, QNetworkAccessManager* nam = 0, QObject* parent = 0 );
+
+    /** send to this scheme, host and port rather than the one each request
+      * was recorded with */
+    void setBaseUrl( const QUrl& url ) { m_baseUrl = url; }
+
+    void setBatchSize( int size ) { m_batchSize = qMax( 1, size ); }
+
+    /** first and longest delay between retries, and how many times to try
+      * the same batch before giving up for now */
+    void setRetry( int firstDelayMs, int maxDelayMs, int maxAttempts );
+
+    void start();
+
+    int uploaded() const { return m_uploaded; }
+    int dropped() const { return m_dropped; }
+
+signals:
+    /** remaining is how many entries are left in the queue */
+    void finished( int remaining );
+
+private slots:
+    void sendBatch();
+    void sendRetries();
+    void onReplyFinished();
+
+private:
+    enum Result { Pending, Done, Retry };
+
+    void batchFinished();
+
+    FingerprintQueue* m_queue;
+    FingerprintCache* m_cache;
+    QNetworkAccessManager* m_nam;
+    QUrl m_baseUrl;
+
+    int m_batchSize;
+    int m_firstDelay;
+    int m_maxDelay;
+    int m_maxAttempts;
+
+    QList<FingerprintQueue::Entry> m_batch;
+    QList<Result> m_results;
+    QMap<QNetworkReply*, int> m_replies;
+
+    int m_attempts;
+    int m_delay;
+    int m_uploaded;
+    int m_dropped;
+};
+
+#endif
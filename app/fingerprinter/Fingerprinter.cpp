@@ -31,13 +31,37 @@
 #include <lastfm/Track.h>
 
 #include "LAV_Source.h"
+#include "FingerprintCache.h"
+#include "FingerprintQueue.h"
 #include "Fingerprinter.h"
 
 
-Fingerprinter::Fingerprinter( const lastfm::Track& track, QObject* parent )
-    :QObject( parent ), m_fp( track ), m_fpSource( 0 )
+Fingerprinter::Fingerprinter( const lastfm::Track& track, FingerprintCache* cache, FingerprintQueue* queue, QObject* parent )
+    :QObject( parent ), m_fp( track ), m_fpSource( 0 ), m_cache( cache ), m_queue( queue ), m_track( track )
 {
-    if ( m_fp.id().isNull() )
+    FingerprintCache::Entry cached;
+    if ( m_cache )
+        cached = m_cache->lookup( track.url().toLocalFile() );
+
+    int cachedId = cached.id;
+
+    if ( cachedId )
+    {
+        qDebug() << "Already Fingerprinted (cached): " << cachedId;
+
+#ifndef NDEBUG
+        connect( lastfm::FingerprintId( cachedId ).getSuggestions(), SIGNAL(finished()), SLOT(onGotSuggestions()) );
+#else
+        QTimer::singleShot(250, qApp, SLOT(quit()));
+#endif
+    }
+    else if ( m_fp.id().isNull() && !cached.submission.url.isEmpty() )
+    {
+        qDebug() << "Submitting the cached fingerprint again";
+        m_submission = cached.submission;
+        submit();
+    }
+    else if ( m_fp.id().isNull() )
     {
         m_fpSource = new LAV_Source();
 
@@ -46,7 +70,25 @@ Fingerprinter::Fingerprinter( const lastfm::Track& track, QObject* parent )
             try
             {
                 m_fp.generate( m_fpSource );
-                connect( m_fp.submit(), SIGNAL(finished()), SLOT(onFingerprintSubmitted()) );
+
+                // only records the request, see FingerprintRecorder
+                QNetworkReply* reply = m_fp.submit();
+                m_submission = FingerprintQueue::recorded( reply, track.url().toLocalFile(), m_fp.data() );
+                reply->deleteLater();
+
+                if ( m_submission.url.isEmpty() )
+                {
+                    qWarning() << "lastfm::nam() is not a FingerprintRecorder";
+                    QTimer::singleShot(250, qApp, SLOT(quit()));
+                }
+                else
+                {
+                    // keep it so we needn't decode the file again
+                    if ( m_cache )
+                        m_cache->store( track.url().toLocalFile(), 0, m_submission );
+
+                    submit();
+                }
             }
             catch ( const lastfm::Fingerprint::Error& error )
             {
@@ -74,21 +116,45 @@ Fingerprinter::~Fingerprinter()
     delete m_fpSource;
 }
 
+void
+Fingerprinter::submit()
+{
+    // Offline, so it'll be uploaded with the rest of the queue later
+    if ( m_queue )
+    {
+        if ( m_queue->append( m_submission ) )
+            qDebug() << "Fingerprint queued for upload";
+        else
+            qWarning() << "Could not queue the fingerprint";
+
+        QTimer::singleShot(250, qApp, SLOT(quit()));
+        return;
+    }
+
+    connect( FingerprintRecorder::send( m_submission ), SIGNAL(finished()), SLOT(onFingerprintSubmitted()) );
+}
+
 void
 Fingerprinter::onFingerprintSubmitted()
 {
+    QNetworkReply* reply = static_cast<QNetworkReply*>( sender() );
+
     try
     {
-        m_fp.decode( static_cast<QNetworkReply*>( sender() ) );
+        m_fp.decode( reply );
         qDebug() << "Fingerprint success: " << m_fp.id();
     }
     catch ( const lastfm::Fingerprint::Error& error )
     {
+        // the submission stays in the cache to try again next time
         qWarning() << "Fingerprint error: " << error;
         QTimer::singleShot(250, qApp, SLOT(quit()));
         return;
     }
 
+    if ( m_cache )
+        m_cache->store( m_track.url().toLocalFile(), m_fp.id(), m_submission );
+
 #ifndef NDEBUG
     // This code will fetch the suggestions from the fingerprint id, one
     // day we might do something with this info, like offer corrections
@@ -23,13 +23,19 @@
 #include <lastfm/Track.h>
 #include <lastfm/Fingerprint.h>
 
+#include "FingerprintQueue.h"
+
 namespace lastfm { class FingerprintableSource; }
+class FingerprintCache;
 
 class Fingerprinter : public QObject
 {
     Q_OBJECT
 public:
-    explicit Fingerprinter( const lastfm::Track& track, QObject* parent = 0 );
+    /** cache may be 0, otherwise it is checked before decoding anything.
+      * If queue isn't 0 we're offline, and the submission goes there.
+      * lastfm::nam() must be a FingerprintRecorder */
+    explicit Fingerprinter( const lastfm::Track& track, FingerprintCache* cache = 0, FingerprintQueue* queue = 0, QObject* parent = 0 );
     ~Fingerprinter();
 
 private slots:
@@ -37,8 +43,13 @@ private slots:
     void onGotSuggestions();
 
 private:
+    void submit();
+
     lastfm::Fingerprint m_fp;
+    FingerprintQueue::Entry m_submission;
     lastfm::FingerprintableSource* m_fpSource;
+    FingerprintCache* m_cache;
+    FingerprintQueue* m_queue;
     lastfm::Track m_track;
 };
 
@@ -17,6 +17,7 @@
  */
 
 #include "LAV_Source.h"
+#include "common/c++/SilenceDetection.h"
 
 // Needed by libavutil/common.h
 #ifndef __STDC_CONSTANT_MACROS
@@ -66,22 +67,27 @@ public:
         , streamIndex(-1)
         , duration(0)
         , timestamp(0)
+        , frameTimestamp(0)
+        , decodedSeconds(0)
+        , bytesCopied(0)
         , bitrate(0)
         , eof(false)
-        , overflowSize(0)
+        , pendingData(NULL)
+        , pendingSize(0)
     {
         outBuffer = (uint8_t*)av_malloc(sizeof(uint8_t)*AVCODEC_MAX_AUDIO_FRAME_SIZE*4);
         outBufferSize = sizeof(uint8_t)*AVCODEC_MAX_AUDIO_FRAME_SIZE*4;
-        overflow = (uint8_t*)av_malloc(sizeof(uint8_t)*AVCODEC_MAX_AUDIO_FRAME_SIZE*4);
+        decodedFrame = avcodec_alloc_frame();
     }
 
     ~LAV_SourcePrivate()
     {
         av_free(outBuffer);
-        av_free(overflow);
+        avcodec_free_frame(&decodedFrame);
     }
 
     uint8_t * decodeOneFrame(int &dataSize, int &channels, int& nSamples);
+    bool seek(double target);
 
     AVFormatContext *inFormatContext;
     AVCodecContext *inCodecContext;
@@ -93,17 +99,30 @@ public:
     int streamIndex;
     int duration;
     double timestamp;
+    double frameTimestamp;
+    double decodedSeconds;
+    quint64 bytesCopied;
     int bitrate;
     bool eof;
+
+    // Reused for every frame we decode
+    AVFrame *decodedFrame;
+
+    // Only used when the audio has to be converted
     uint8_t *outBuffer;
     size_t outBufferSize;
-    uint8_t *overflow;
-    size_t overflowSize;
+
+    // The part of the last decoded frame that didn't fit in the caller's
+    // buffer.  It points either into decodedFrame or outBuffer, and stays
+    // valid until the next call to decodeOneFrame.
+    uint8_t *pendingData;
+    size_t pendingSize;
 };
 
 
 /** This reads the audio data from one frame, converts it to an acceptable
  * format (if needed), and returns a pointer to the the decoded data.
+ * The data is only valid until the next call.
  *
  * @param dataSize bytes of decoded data
  * @param channels number of decoded channels
@@ -113,7 +132,8 @@ uint8_t * LAV_SourcePrivate::decodeOneFrame(int &dataSize, int &channels, int& n
 {
     char buf[256];
     AVPacket packet;
-    AVFrame *decodedFrame = avcodec_alloc_frame();
+    uint8_t *out = outBuffer;
+    avcodec_get_frame_defaults(decodedFrame);
     av_init_packet(&packet);
 
     int frameFinished = 0;
@@ -279,17 +299,49 @@ uint8_t * LAV_SourcePrivate::decodeOneFrame(int &dataSize, int &channels, int& n
             else
 #endif
             {
+                // Already S16 with 1 or 2 channels, so hand out the
+                // decoder's own buffer rather than copying it
                 nSamples = decodedFrame->nb_samples;
-                memcpy(outBuffer, decodedFrame->data[0], dataSize);
+                out = decodedFrame->data[0];
             }
         }
         if ( packet.pts != AV_NOPTS_VALUE )
             timestamp = av_q2d(inFormatContext->streams[streamIndex]->time_base)*packet.pts;
         av_free_packet(&packet);
     }
-    timestamp += (double)nSamples / decodedFrame->sample_rate;
-    avcodec_free_frame(&decodedFrame);
-    return outBuffer;
+    frameTimestamp = timestamp;
+    if (nSamples > 0)
+    {
+        timestamp += (double)nSamples / decodedFrame->sample_rate;
+        decodedSeconds += (double)nSamples / decodedFrame->sample_rate;
+    }
+    return out;
+}
+
+
+/** Seek the container to the last keyframe at or before target seconds.
+ * Returns false if the stream can't seek, in which case nothing has changed.
+ *
+ * @param target stream time in seconds, in the same terms as timestamp
+ */
+bool LAV_SourcePrivate::seek(double target)
+{
+    if ( !inFormatContext->pb || !inFormatContext->pb->seekable )
+        return false;
+
+    AVRational timeBase = inFormatContext->streams[streamIndex]->time_base;
+    int64_t pts = static_cast<int64_t>(target / av_q2d(timeBase));
+
+    if ( av_seek_frame(inFormatContext, streamIndex, pts, AVSEEK_FLAG_BACKWARD) < 0 )
+        return false;
+
+    avcodec_flush_buffers(inCodecContext);
+    pendingSize = 0;
+    eof = false;
+
+    // If the demuxer doesn't give us pts we have to trust that we got there
+    timestamp = target;
+    return true;
 }
 
 
@@ -314,6 +366,18 @@ bool LAV_Source::eof() const
 }
 
 
+double LAV_Source::decodedSeconds() const
+{
+    return d->decodedSeconds;
+}
+
+
+quint64 LAV_Source::bytesCopied() const
+{
+    return d->bytesCopied;
+}
+
+
 void LAV_Source::init(const QString& fileName)
 {
     // Assume that we want to start fresh
@@ -429,32 +493,21 @@ void LAV_Source::release()
     d->duration = 0;
     d->bitrate = 0;
     d->eof = false;
-    d->overflowSize = 0;
+    d->pendingSize = 0;
+    d->timestamp = 0;
+    d->frameTimestamp = 0;
 }
 
 
 void LAV_Source::skipSilence(double silenceThreshold /* = 0.0001 */)
 {
-    silenceThreshold *= static_cast<double>( numeric_limits<short>::max() );
+    d->pendingSize = 0;
 
     int dataSize, channels, nSamples;
     uint8_t *out = d->decodeOneFrame(dataSize, channels, nSamples);
     while(dataSize > 0)
     {
-        double sum = 0;
-        int16_t *buf = (int16_t*)out;
-        switch ( channels )
-        {
-            case 1:
-                for (int j = 0; j < nSamples; j++)
-                    sum += abs( buf[j] );
-                break;
-            case 2:
-                for (int j = 0; j < nSamples; j+=2)
-                    sum += abs( (buf[j] >> 1) + (buf[j+1] >> 1) );
-                break;
-        }
-        if ( sum >= silenceThreshold * static_cast<double>(nSamples) )
+        if ( !SilenceDetection::isSilent( (int16_t*)out, nSamples, channels, silenceThreshold ) )
         {
             break;
         }
@@ -467,8 +520,28 @@ void LAV_Source::skipSilence(double silenceThreshold /* = 0.0001 */)
 
 void LAV_Source::skip(const int mSecs)
 {
+    if ( mSecs <= 0 )
+        return;
+
+    double startTimestamp = d->timestamp;
     double targetTimestamp = d->timestamp + mSecs/1000.0;
     int dataSize, channels, nSamples;
+
+    d->pendingSize = 0;
+
+    // Let the container take us most of the way there, then decode forward
+    // from the keyframe it lands on.  Seeking in files without an index can
+    // be approximate, so if we overshot go back and do it the slow way.
+    if ( d->seek(targetTimestamp) )
+    {
+        d->decodeOneFrame(dataSize, channels, nSamples);
+        if ( d->frameTimestamp > targetTimestamp && !d->seek(startTimestamp) )
+            return;
+        if ( d->timestamp > targetTimestamp || d->eof )
+            return;
+    }
+
+    // Linear decode for streams we can't seek in
     for (;;)
     {
         d->decodeOneFrame(dataSize, channels, nSamples);
@@ -481,38 +554,29 @@ void LAV_Source::skip(const int mSecs)
 int LAV_Source::updateBuffer(signed short* pBuffer, size_t bufferSize)
 {
     size_t bufferFill = 0;
-    int dataSize;
 
-    if ( d->overflowSize )
-    {
-        memcpy( pBuffer, d->overflow, d->overflowSize );
-        bufferFill = d->overflowSize/outSampleSize;
-        d->overflowSize = 0;
-    }
-
-    uint8_t * out;
     while(bufferFill < bufferSize)
     {
-        int channels, nb_samples;
-
-        out = d->decodeOneFrame(dataSize, channels, nb_samples);
-        if (!dataSize)
-            break;
+        // Finish off the last frame before decoding another
+        if ( !d->pendingSize )
+        {
+            int dataSize, channels, nb_samples;
 
-        // Only put as many bytes in pBuffer as will fit; save the rest for the
-        // next call to updateBuffer
-        int bytesToBuffer = (bufferSize - bufferFill)*outSampleSize;
+            d->pendingData = d->decodeOneFrame(dataSize, channels, nb_samples);
+            d->pendingSize = dataSize;
 
-        if ( bytesToBuffer < dataSize )
-        {
-            d->overflowSize = dataSize - bytesToBuffer;
-            memcpy( d->overflow, out + bytesToBuffer, d->overflowSize);
-        }
-        else
-        {
-            bytesToBuffer = dataSize;
+            if (!dataSize)
+                break;
         }
-        memcpy( pBuffer + bufferFill, out, bytesToBuffer );
+
+        // Only put as many bytes in pBuffer as will fit; the rest stays
+        // pending for the next call to updateBuffer
+        size_t bytesToBuffer = min( (bufferSize - bufferFill)*outSampleSize, d->pendingSize );
+
+        memcpy( pBuffer + bufferFill, d->pendingData, bytesToBuffer );
+        d->pendingData += bytesToBuffer;
+        d->pendingSize -= bytesToBuffer;
+        d->bytesCopied += bytesToBuffer;
 
         bufferFill += bytesToBuffer/outSampleSize;
     }
@@ -40,6 +40,12 @@ public:
 
     bool eof() const;
 
+    // Seconds of audio decoded by this source since it was constructed
+    double decodedSeconds() const;
+
+    // Bytes of PCM copied out to callers since it was constructed
+    quint64 bytesCopied() const;
+
 private:
     class LAV_SourcePrivate * const d;
 };
@@ -14,14 +14,26 @@ mac {
 
 SOURCES += main.cpp \
             Fingerprinter.cpp \
-            LAV_Source.cpp
+            FingerprintBatch.cpp \
+            FingerprintCache.cpp \
+            FingerprintQueue.cpp \
+            FingerprintUploader.cpp \
+            LAV_Source.cpp \
+            $$ROOT_DIR/common/c++/SilenceDetection.cpp
 
 HEADERS += LAV_Source.h \
-            Fingerprinter.h
+            Fingerprinter.h \
+            FingerprintBatch.h \
+            FingerprintCache.h \
+            FingerprintQueue.h \
+            FingerprintUploader.h \
+            $$ROOT_DIR/common/c++/SilenceDetection.h
 
 
 
 
 
+win32:LIBS += psapi.lib
+
 DEFINES += LASTFM_COLLAPSE_NAMESPACE LASTFM_FINGERPRINTER
 
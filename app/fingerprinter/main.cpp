@@ -19,6 +19,10 @@
 */
 
 #include "Fingerprinter.h"
+#include "FingerprintBatch.h"
+#include "FingerprintCache.h"
+#include "FingerprintQueue.h"
+#include "FingerprintUploader.h"
 
 #include "lib/unicorn/UnicornCoreApplication.h"
 
@@ -28,7 +32,44 @@
 #include <QCoreApplication>
 #include <QDebug>
 
-// ./fingerprinter --username <username> --filename <filename> --title <title> --album <album> --artist <artist>
+// ./fingerprinter --username <username> --filename <filename> --title <title> --album <album> --artist <artist> [--no-cache] [--offline]
+// ./fingerprinter --username <username> --manifest <file|-> [--threads <n>] [--no-cache] [--offline]
+// ./fingerprinter --drain [--submit-url <url>] [--no-cache]
+//
+// --offline queues the submissions instead of sending them, --drain uploads the queue,
+// retrying for as long as it takes. Any other run that's online tries each of what's
+// left in the queue once before it exits, as the client waits on it
+
+/** uploads the queue, returns how many are left */
+static int
+drain( QCoreApplication& a, FingerprintCache* cache, bool retry )
+{
+    FingerprintQueue queue;
+    if ( queue.count() == 0 )
+        return 0;
+
+    if ( !queue.claimUploads() )
+    {
+        qDebug() << "Another fingerprinter is uploading the queue";
+        return queue.count();
+    }
+
+    FingerprintUploader uploader( &queue, cache );
+
+    if ( !retry )
+        uploader.setRetry( 0, 0, 1 );
+
+    int submitUrlIndex = a.arguments().indexOf( "--submit-url" );
+    if ( submitUrlIndex != -1 )
+        uploader.setBaseUrl( QUrl( a.arguments().value( submitUrlIndex + 1 ) ) );
+
+    QObject::connect( &uploader, SIGNAL(finished(int)), &a, SLOT(quit()) );
+    uploader.start();
+    a.exec();
+
+    qDebug() << "Fingerprints uploaded:" << uploader.uploaded() << "dropped:" << uploader.dropped() << "left:" << queue.count();
+    return queue.count();
+}
 
 int main(int argc, char *argv[])
 {
@@ -43,8 +84,44 @@ int main(int argc, char *argv[])
 
     int usernameIndex = a.arguments().indexOf( "--username" );
     int filenameIndex = a.arguments().indexOf( "--filename" );
+    int manifestIndex = a.arguments().indexOf( "--manifest" );
+
+    FingerprintCache* cache = a.arguments().contains( "--no-cache" ) ? 0 : new FingerprintCache;
+    FingerprintQueue* queue = 0;
+
+    // so we can keep the submissions, and queue them when we're offline
+    lastfm::setNetworkAccessManager( new FingerprintRecorder );
+
+    if ( a.arguments().contains( "--offline" ) )
+        queue = new FingerprintQueue;
+
+    if ( a.arguments().contains( "--drain" ) )
+    {
+        exitCode = drain( a, cache, true ) == 0 ? 0 : 1;
+    }
+    else if ( usernameIndex != -1 && manifestIndex != -1 )
+    {
+        lastfm::ws::Username = a.arguments().at( usernameIndex + 1 );
+
+        int threadsIndex = a.arguments().indexOf( "--threads" );
+        int threads = threadsIndex != -1 ? a.arguments().value( threadsIndex + 1 ).toInt() : 0;
+
+        FingerprintBatch* batch = new FingerprintBatch( a.arguments().value( manifestIndex + 1 ), cache, queue, threads );
+        QObject::connect( batch, SIGNAL(finished(int)), &a, SLOT(quit()) );
+
+        if ( batch->start() )
+        {
+            a.exec();
+            exitCode = batch->errorCount() == 0 ? 0 : 1;
+        }
 
-    if ( usernameIndex != -1 && filenameIndex != -1 )
+        delete batch;
+
+        // we're online, so catch up on anything queued by earlier runs
+        if ( !queue )
+            drain( a, cache, false );
+    }
+    else if ( usernameIndex != -1 && filenameIndex != -1 )
     {
         // username and filename are required fields
         lastfm::ws::Username = a.arguments().at( usernameIndex + 1 );
@@ -59,15 +136,28 @@ int main(int argc, char *argv[])
 
         if ( titleIndex != -1 ) track.setTitle( a.arguments().at( titleIndex + 1 ) );
         if ( albumIndex != -1 ) track.setAlbum( a.arguments().at( albumIndex + 1 ) );
-        if ( artistIndex != -1 ) track.setTitle( a.arguments().at( artistIndex + 1 ) );
+        if ( artistIndex != -1 ) track.setArtist( a.arguments().at( artistIndex + 1 ) );
 
-        Fingerprinter* fingerprinter = new Fingerprinter( track );
+        Fingerprinter* fingerprinter = new Fingerprinter( track, cache, queue );
         exitCode = a.exec();
         delete fingerprinter;
+
+        if ( !queue )
+            drain( a, cache, false );
     }
     else
     {
-        qWarning() << "Usage: fingerprinter --username <username> --filename <filename> --title <title> --album <album> --artist <artist>";
+        qWarning() << "Usage: fingerprinter --username <username> --filename <filename> --title <title> --album <album> --artist <artist> [--no-cache] [--offline]";
+        qWarning() << "       fingerprinter --username <username> --manifest <file|-> [--threads <n>] [--no-cache] [--offline]";
+        qWarning() << "       fingerprinter --drain [--submit-url <url>] [--no-cache]";
+    }
+
+    delete queue;
+
+    if ( cache )
+    {
+        qDebug() << "Fingerprint cache hits:" << cache->hits() << "misses:" << cache->misses();
+        delete cache;
     }
 
     return exitCode;
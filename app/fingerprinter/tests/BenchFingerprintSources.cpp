@@ -0,0 +1,410 @@
+/*
+   Copyright 2013 Last.fm Ltd.
+
+   This file is part of the Last.fm Desktop Application Suite.
+
+   lastfm-desktop is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   lastfm-desktop is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with lastfm-desktop.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/** Measures how fast each FingerprintableSource turns a file into PCM.
+  *
+  * initTestCase() writes a deterministic corpus to a temporary directory:
+  * a tone and a noise signal, each with a second of leading silence so that
+  * skipSilence() has something to do, rendered as WAV and then encoded to
+  * mp3, m4a, flac and ogg with whichever of ffmpeg or avconv is on the PATH.
+  * Formats the encoder can't produce are skipped.
+  *
+  * Every source that was built in is driven through init / getInfo /
+  * skipSilence / skip / updateBuffer, the way lastfm::Fingerprint does, and
+  * the results are written as JSON to bench_sources.json in the current
+  * directory, or wherever LASTFM_BENCH_JSON points.
+  *
+  * Allocations are those made through operator new. Memory the decoding
+  * libraries get from malloc directly isn't counted. */
+
+#include <QtTest>
+#include <QDir>
+#include <QFile>
+#include <QProcess>
+#include <QDateTime>
+#include <QTextStream>
+#include <QAtomicInt>
+
+#include <cmath>
+#include <cstdlib>
+#include <new>
+
+#include <lastfm/FingerprintableSource.h>
+
+#include "../LAV_Source.h"
+#ifdef HAVE_MAD
+#include "app/client/Fingerprinter/MadSource.h"
+#endif
+#ifdef HAVE_FAAD
+#include "app/client/Fingerprinter/AacSource.h"
+#endif
+#ifdef HAVE_FLAC
+#include "app/client/Fingerprinter/FlacSource.h"
+#endif
+#ifdef HAVE_VORBIS
+#include "app/client/Fingerprinter/VorbisSource.h"
+#endif
+
+
+static QAtomicInt allocations;
+
+void* operator new( size_t size )
+{
+    allocations.fetchAndAddRelaxed( 1 );
+    void* p = std::malloc( size ? size : 1 );
+    if ( !p )
+        throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[]( size_t size )
+{
+    return operator new( size );
+}
+
+void operator delete( void* p )
+{
+    std::free( p );
+}
+
+void operator delete[]( void* p )
+{
+    std::free( p );
+}
+
+
+static const int SAMPLE_RATE = 44100;
+static const int CHANNELS = 2;
+static const int SILENT_SECS = 1;
+static const int AUDIO_SECS = 30;
+static const int SKIP_MSECS = 5000;
+static const int RUNS = 3;
+static const double PI = 3.14159265358979323846;
+
+
+class BenchFingerprintSources : public QObject
+{
+    Q_OBJECT
+
+    struct Result
+    {
+        QString source;
+        QString format;
+        QString signal;
+        qint64 fileBytes;
+        qint64 pcmBytes;
+        double audioSecs;
+        double wallSecs;
+        int allocations;
+    };
+
+    static lastfm::FingerprintableSource* createSource( const QString& name );
+    static void writeWav( const QString& path, bool noise );
+    bool encode( const QString& wav, const QString& out, const QString& codec );
+
+    QString m_dir;
+    QString m_encoder;
+    QMap<QString, QString> m_corpus;
+    QList<Result> m_results;
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void decode_data();
+    void decode();
+};
+
+
+lastfm::FingerprintableSource*
+BenchFingerprintSources::createSource( const QString& name )
+{
+    if ( name == "LAV_Source" ) return new LAV_Source;
+#ifdef HAVE_MAD
+    if ( name == "MadSource" ) return new MadSource;
+#endif
+#ifdef HAVE_FAAD
+    if ( name == "AacSource" ) return new AacSource;
+#endif
+#ifdef HAVE_FLAC
+    if ( name == "FlacSource" ) return new FlacSource;
+#endif
+#ifdef HAVE_VORBIS
+    if ( name == "VorbisSource" ) return new VorbisSource;
+#endif
+    return 0;
+}
+
+
+/** 16 bit stereo with a second of silence, then a 440Hz tone or white noise.
+  * The noise comes from a fixed LCG so every build decodes the same bytes */
+void
+BenchFingerprintSources::writeWav( const QString& path, bool noise )
+{
+    const quint32 frames = SAMPLE_RATE * ( SILENT_SECS + AUDIO_SECS );
+    const quint32 dataSize = frames * CHANNELS * 2;
+
+    QFile file( path );
+    QVERIFY( file.open( QIODevice::WriteOnly ) );
+
+    QDataStream out( &file );
+    out.setByteOrder( QDataStream::LittleEndian );
+
+    out.writeRawData( "RIFF", 4 );
+    out << quint32( 36 + dataSize );
+    out.writeRawData( "WAVEfmt ", 8 );
+    out << quint32( 16 ) << quint16( 1 ) << quint16( CHANNELS ) << quint32( SAMPLE_RATE )
+        << quint32( SAMPLE_RATE * CHANNELS * 2 ) << quint16( CHANNELS * 2 ) << quint16( 16 );
+    out.writeRawData( "data", 4 );
+    out << dataSize;
+
+    quint32 seed = 12345;
+
+    for ( quint32 i = 0; i < frames; ++i )
+    {
+        qint16 sample = 0;
+
+        if ( i >= quint32( SAMPLE_RATE * SILENT_SECS ) )
+        {
+            if ( noise )
+            {
+                seed = seed * 1103515245 + 12345;
+                sample = qint16( ( seed >> 16 ) & 0xFFFF ) / 4;
+            }
+            else
+            {
+                sample = qint16( 8000 * std::sin( 2 * PI * 440 * i / SAMPLE_RATE ) );
+            }
+        }
+
+        for ( int c = 0; c < CHANNELS; ++c )
+            out << sample;
+    }
+}
+
+
+bool
+BenchFingerprintSources::encode( const QString& wav, const QString& out, const QString& codec )
+{
+    QStringList args;
+    args << "-y" << "-loglevel" << "error" << "-i" << wav
+         << "-strict" << "experimental" << "-acodec" << codec << out;
+
+    QProcess process;
+    process.start( m_encoder, args );
+
+    return process.waitForFinished( 120000 )
+        && process.exitStatus() == QProcess::NormalExit
+        && process.exitCode() == 0
+        && QFileInfo( out ).size() > 0;
+}
+
+
+void
+BenchFingerprintSources::initTestCase()
+{
+    m_dir = QDir::temp().filePath( QString( "bench_sources_%1" ).arg( QCoreApplication::applicationPid() ) );
+    QVERIFY( QDir().mkpath( m_dir ) );
+
+    foreach ( QString encoder, QStringList() << "ffmpeg" << "avconv" )
+    {
+        QProcess process;
+        process.start( encoder, QStringList() << "-version" );
+        if ( process.waitForFinished() && process.exitCode() == 0 )
+        {
+            m_encoder = encoder;
+            break;
+        }
+    }
+
+    if ( m_encoder.isEmpty() )
+        qWarning() << "Neither ffmpeg nor avconv found, only WAV will be benchmarked";
+
+    QMap<QString, QString> codecs;
+    codecs["mp3"] = "libmp3lame";
+    codecs["m4a"] = "aac";
+    codecs["flac"] = "flac";
+    codecs["ogg"] = "libvorbis";
+
+    foreach ( QString signal, QStringList() << "tone" << "noise" )
+    {
+        QString wav = QDir( m_dir ).filePath( signal + ".wav" );
+        writeWav( wav, signal == "noise" );
+        m_corpus["wav/" + signal] = wav;
+
+        if ( m_encoder.isEmpty() )
+            continue;
+
+        foreach ( QString format, codecs.keys() )
+        {
+            QString path = QDir( m_dir ).filePath( signal + "." + format );
+            if ( encode( wav, path, codecs[format] ) )
+                m_corpus[format + "/" + signal] = path;
+            else
+                qWarning() << m_encoder << "could not encode" << format;
+        }
+    }
+}
+
+
+void
+BenchFingerprintSources::cleanupTestCase()
+{
+    foreach ( QString path, m_corpus )
+        QFile::remove( path );
+    QDir().rmdir( m_dir );
+
+    QString jsonPath = QString::fromLocal8Bit( qgetenv( "LASTFM_BENCH_JSON" ) );
+    if ( jsonPath.isEmpty() )
+        jsonPath = "bench_sources.json";
+
+    QFile file( jsonPath );
+    QVERIFY( file.open( QIODevice::WriteOnly | QIODevice::Text | QIODevice::Truncate ) );
+
+    QString timestamp = QDateTime::currentDateTime().toUTC().toString( Qt::ISODate );
+#if QT_VERSION < 0x050000
+    // Qt 5 marks UTC times itself
+    timestamp += 'Z';
+#endif
+
+    QTextStream json( &file );
+    json << "{\n"
+         << "  \"benchmark\": \"fingerprint_sources\",\n"
+         << "  \"timestamp\": \"" << timestamp << "\",\n"
+         << "  \"results\": [";
+
+    for ( int i = 0; i < m_results.count(); ++i )
+    {
+        const Result& r = m_results[i];
+        double wall = qMax( r.wallSecs, 0.001 );
+
+        json << ( i ? "," : "" ) << "\n    { "
+             << "\"source\": \"" << r.source << "\", "
+             << "\"format\": \"" << r.format << "\", "
+             << "\"signal\": \"" << r.signal << "\", "
+             << "\"file_bytes\": " << r.fileBytes << ", "
+             << "\"pcm_bytes\": " << r.pcmBytes << ", "
+             << "\"wall_secs\": " << r.wallSecs << ", "
+             << "\"input_mb_per_sec\": " << r.fileBytes / wall / ( 1024 * 1024 ) << ", "
+             << "\"pcm_mb_per_sec\": " << r.pcmBytes / wall / ( 1024 * 1024 ) << ", "
+             << "\"audio_secs_per_sec\": " << r.audioSecs / wall << ", "
+             << "\"allocations\": " << r.allocations << " }";
+    }
+
+    json << "\n  ]\n}\n";
+}
+
+
+void
+BenchFingerprintSources::decode_data()
+{
+    QTest::addColumn<QString>( "source" );
+    QTest::addColumn<QString>( "format" );
+    QTest::addColumn<QString>( "signal" );
+
+    QList<QPair<QString, QString> > pairs;
+    foreach ( QString format, QStringList() << "wav" << "mp3" << "m4a" << "flac" << "ogg" )
+        pairs << qMakePair( QString( "LAV_Source" ), format );
+    pairs << qMakePair( QString( "MadSource" ), QString( "mp3" ) )
+          << qMakePair( QString( "AacSource" ), QString( "m4a" ) )
+          << qMakePair( QString( "FlacSource" ), QString( "flac" ) )
+          << qMakePair( QString( "VorbisSource" ), QString( "ogg" ) );
+
+    typedef QPair<QString, QString> Pair;
+    foreach ( Pair pair, pairs )
+        foreach ( QString signal, QStringList() << "tone" << "noise" )
+            QTest::newRow( QString( "%1 %2 %3" ).arg( pair.first, pair.second, signal ).toLatin1() )
+                    << pair.first << pair.second << signal;
+}
+
+
+void
+BenchFingerprintSources::decode()
+{
+    QFETCH( QString, source );
+    QFETCH( QString, format );
+    QFETCH( QString, signal );
+
+    QString path = m_corpus.value( format + "/" + signal );
+    if ( path.isEmpty() )
+        QSKIP( "No file for this format", SkipSingle );
+
+    if ( lastfm::FingerprintableSource* probe = createSource( source ) )
+        delete probe;
+    else
+        QSKIP( "Source not built", SkipSingle );
+
+    Result best;
+    best.source = source;
+    best.format = format;
+    best.signal = signal;
+    best.fileBytes = QFileInfo( path ).size();
+    best.wallSecs = -1;
+
+    static short buffer[8192];
+
+    // the best of a few runs, so a cold page cache doesn't count
+    for ( int run = 0; run < RUNS; ++run )
+    {
+        int allocationsBefore = allocations;
+        QTime time;
+        time.start();
+
+        lastfm::FingerprintableSource* s = createSource( source );
+        qint64 samples = 0;
+        int lengthSecs, sampleRate, bitrate, nChannels;
+
+        try
+        {
+            s->init( path );
+            s->getInfo( lengthSecs, sampleRate, bitrate, nChannels );
+            s->skipSilence();
+            s->skip( SKIP_MSECS );
+
+            int n;
+            while ( ( n = s->updateBuffer( buffer, sizeof( buffer ) / sizeof( buffer[0] ) ) ) > 0 )
+                samples += n;
+        }
+        catch ( const std::exception& e )
+        {
+            delete s;
+            QFAIL( e.what() );
+        }
+
+        delete s;
+
+        double wall = time.elapsed() / 1000.0;
+        int allocationCount = int( allocations ) - allocationsBefore;
+
+        QVERIFY( sampleRate > 0 && nChannels > 0 );
+        QVERIFY( samples > 0 );
+
+        if ( best.wallSecs < 0 || wall < best.wallSecs )
+        {
+            best.wallSecs = wall;
+            best.pcmBytes = samples * sizeof( short );
+            best.audioSecs = double( samples ) / ( sampleRate * nChannels );
+            best.allocations = allocationCount;
+        }
+    }
+
+    m_results << best;
+}
+
+QTEST_MAIN(BenchFingerprintSources)
+#include "BenchFingerprintSources.moc"
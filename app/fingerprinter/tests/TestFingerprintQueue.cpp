@@ -0,0 +1,268 @@
+/*
+   Copyright 2013 Last.fm Ltd.
+
+   This file is part of liblastfm.
+
+   liblastfm is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   liblastfm is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with liblastfm.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <QtTest>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QNetworkAccessManager>
+
+#include "FingerprintQueue.h"
+#include "FingerprintUploader.h"
+
+
+/** Answers each request with the next canned response, then "1234 NEW" */
+class FakeFingerprintServer : public QTcpServer
+{
+    Q_OBJECT
+public:
+    FakeFingerprintServer() : requests( 0 )
+    {
+        connect( this, SIGNAL(newConnection()), SLOT(onNewConnection()) );
+        listen( QHostAddress::LocalHost );
+    }
+
+    QList<QByteArray> responses;
+    int requests;
+
+private slots:
+    void onNewConnection()
+    {
+        while ( hasPendingConnections() )
+        {
+            QTcpSocket* socket = nextPendingConnection();
+            connect( socket, SIGNAL(readyRead()), SLOT(onReadyRead()) );
+            connect( socket, SIGNAL(disconnected()), socket, SLOT(deleteLater()) );
+        }
+    }
+
+    void onReadyRead()
+    {
+        QTcpSocket* socket = static_cast<QTcpSocket*>( sender() );
+        QByteArray& request = m_buffers[socket];
+        request += socket->readAll();
+
+        int headerEnd = request.indexOf( "\r\n\r\n" );
+        if ( headerEnd == -1 )
+            return;
+
+        QRegExp contentLength( "Content-Length: *(\\d+)", Qt::CaseInsensitive );
+        int length = contentLength.indexIn( request ) != -1 ? contentLength.cap( 1 ).toInt() : 0;
+        if ( request.size() < headerEnd + 4 + length )
+            return;
+
+        m_buffers.remove( socket );
+        ++requests;
+
+        QByteArray response = responses.isEmpty() ? QByteArray( "200 OK\r\n\r\n1234 NEW" ) : responses.takeFirst();
+        int split = response.indexOf( "\r\n\r\n" );
+        QByteArray body = response.mid( split + 4 );
+
+        socket->write( "HTTP/1.1 " + response.left( split ) + "\r\n"
+                       "Content-Length: " + QByteArray::number( body.size() ) + "\r\n"
+                       "Connection: close\r\n\r\n" + body );
+        socket->disconnectFromHost();
+    }
+
+private:
+    QMap<QTcpSocket*, QByteArray> m_buffers;
+};
+
+
+class TestFingerprintQueue : public QObject
+{
+    Q_OBJECT
+
+    QString m_path;
+
+    static FingerprintQueue::Entry entry( int i );
+
+private slots:
+    void init();
+    void cleanup();
+
+    void testPersists();
+    void testTornTail();
+    void testOncePerFile();
+    void testShared();
+    void testDrain();
+};
+
+
+FingerprintQueue::Entry
+TestFingerprintQueue::entry( int i )
+{
+    FingerprintQueue::Entry e;
+    e.path = QString( "/music/%1.mp3" ).arg( i );
+    e.url = QUrl( "http://www.last.fm/fingerprint/query/?artist=a" );
+    e.contentType = "multipart/form-data; boundary=x";
+    e.body = "--x\r\nfpdata " + QByteArray::number( i ) + "\r\n--x--";
+    e.data = QByteArray::number( i );
+    return e;
+}
+
+
+void
+TestFingerprintQueue::init()
+{
+    m_path = QDir::temp().filePath( "test_fingerprint_queue" );
+    cleanup();
+}
+
+
+void
+TestFingerprintQueue::cleanup()
+{
+    QFile::remove( m_path );
+    QFile::remove( m_path + ".pos" );
+    QFile::remove( m_path + ".upload" );
+}
+
+
+void
+TestFingerprintQueue::testPersists()
+{
+    {
+        FingerprintQueue queue( m_path );
+        for ( int i = 0; i < 5; ++i )
+            QVERIFY( queue.append( entry( i ) ) );
+        queue.markDone( 2 );
+    }
+
+    FingerprintQueue queue( m_path );
+    QCOMPARE( queue.count(), 3 );
+
+    QList<FingerprintQueue::Entry> pending = queue.pending( 10 );
+    QCOMPARE( pending.count(), 3 );
+    QCOMPARE( pending[0].path, entry( 2 ).path );
+    QCOMPARE( pending[0].url, entry( 2 ).url );
+    QCOMPARE( pending[0].body, entry( 2 ).body );
+    QCOMPARE( pending[2].data, entry( 4 ).data );
+
+    queue.markDone( 3 );
+    QCOMPARE( queue.count(), 0 );
+    QCOMPARE( QFileInfo( m_path ).size(), qint64( 0 ) );
+}
+
+
+void
+TestFingerprintQueue::testTornTail()
+{
+    {
+        FingerprintQueue queue( m_path );
+        QVERIFY( queue.append( entry( 0 ) ) );
+        QVERIFY( queue.append( entry( 1 ) ) );
+    }
+
+    // as if we died half way through writing the second entry
+    QFile file( m_path );
+    QVERIFY( file.open( QIODevice::ReadWrite ) );
+    file.resize( file.size() - 3 );
+    file.close();
+
+    FingerprintQueue queue( m_path );
+    QCOMPARE( queue.count(), 1 );
+    QCOMPARE( queue.pending( 10 )[0].path, entry( 0 ).path );
+
+    QVERIFY( queue.append( entry( 2 ) ) );
+    QCOMPARE( queue.pending( 10 )[1].path, entry( 2 ).path );
+}
+
+
+void
+TestFingerprintQueue::testOncePerFile()
+{
+    {
+        FingerprintQueue queue( m_path );
+        QVERIFY( queue.append( entry( 0 ) ) );
+        QVERIFY( queue.append( entry( 1 ) ) );
+        QVERIFY( queue.append( entry( 0 ) ) );
+        QCOMPARE( queue.count(), 2 );
+    }
+
+    // and still after a restart
+    FingerprintQueue queue( m_path );
+    QVERIFY( queue.append( entry( 1 ) ) );
+    QCOMPARE( queue.count(), 2 );
+
+    // until it has been uploaded
+    queue.markDone( 1 );
+    QVERIFY( queue.append( entry( 0 ) ) );
+    QCOMPARE( queue.count(), 2 );
+    QCOMPARE( queue.pending( 10 )[1].path, entry( 0 ).path );
+}
+
+
+void
+TestFingerprintQueue::testShared()
+{
+    // as two fingerprinters would have it
+    FingerprintQueue first( m_path );
+    FingerprintQueue second( m_path );
+
+    QVERIFY( first.append( entry( 0 ) ) );
+    QVERIFY( second.append( entry( 0 ) ) );
+    QVERIFY( second.append( entry( 1 ) ) );
+    QCOMPARE( first.count(), 2 );
+
+    QVERIFY( first.claimUploads() );
+    QVERIFY( !second.claimUploads() );
+
+    first.markDone( 2 );
+    QCOMPARE( second.count(), 0 );
+
+    QVERIFY( second.append( entry( 2 ) ) );
+    QCOMPARE( first.pending( 10 ).count(), 1 );
+    QCOMPARE( first.pending( 10 )[0].path, entry( 2 ).path );
+}
+
+
+void
+TestFingerprintQueue::testDrain()
+{
+    FakeFingerprintServer server;
+    QVERIFY( server.isListening() );
+    server.responses << "500 Internal Server Error\r\n\r\n"
+                     << "400 Bad Request\r\n\r\n";
+
+    FingerprintQueue queue( m_path );
+    for ( int i = 0; i < 5; ++i )
+        queue.append( entry( i ) );
+
+    QNetworkAccessManager nam;
+    FingerprintUploader uploader( &queue, 0, &nam );
+    uploader.setBaseUrl( QUrl( QString( "http://127.0.0.1:%1/" ).arg( server.serverPort() ) ) );
+    uploader.setBatchSize( 2 );
+    uploader.setRetry( 10, 100, 5 );
+
+    QSignalSpy spy( &uploader, SIGNAL(finished(int)) );
+    uploader.start();
+
+    for ( int i = 0; i < 100 && spy.isEmpty(); ++i )
+        QTest::qWait( 50 );
+
+    QCOMPARE( spy.count(), 1 );
+    QCOMPARE( spy[0][0].toInt(), 0 );
+    QCOMPARE( uploader.uploaded(), 4 );
+    QCOMPARE( uploader.dropped(), 1 );
+    // only the one that got the 500 was sent twice
+    QCOMPARE( server.requests, 6 );
+    QCOMPARE( FingerprintQueue( m_path ).count(), 0 );
+}
+
+QTEST_MAIN(TestFingerprintQueue)
+#include "TestFingerprintQueue.moc"
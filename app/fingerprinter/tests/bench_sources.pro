@@ -0,0 +1,40 @@
+TEMPLATE = app
+TARGET = bench_sources
+QT = core testlib
+CONFIG += lastfm fingerprint ffmpeg
+CONFIG -= app_bundle
+INCLUDEPATH += ..
+include( ../../../admin/include.qmake )
+
+DEFINES += LASTFM_COLLAPSE_NAMESPACE LASTFM_FINGERPRINTER
+
+SOURCES = BenchFingerprintSources.cpp \
+          ../LAV_Source.cpp \
+          $$ROOT_DIR/common/c++/SilenceDetection.cpp \
+          $$ROOT_DIR/common/c++/PcmConversion.cpp
+
+# The other sources are only benchmarked if their decoders are installed
+unix {
+    CONFIG += link_pkgconfig
+
+    packagesExist(mad) {
+        PKGCONFIG += mad
+        DEFINES += HAVE_MAD
+        SOURCES += $$ROOT_DIR/app/client/Fingerprinter/MadSource.cpp
+    }
+    packagesExist(flac) {
+        PKGCONFIG += flac
+        DEFINES += HAVE_FLAC
+        SOURCES += $$ROOT_DIR/app/client/Fingerprinter/FlacSource.cpp
+    }
+    packagesExist(vorbisfile) {
+        PKGCONFIG += vorbisfile
+        DEFINES += HAVE_VORBIS
+        SOURCES += $$ROOT_DIR/app/client/Fingerprinter/VorbisSource.cpp
+    }
+    exists(/usr/include/mp4ff.h)|exists(/usr/local/include/mp4ff.h) {
+        LIBS += -lfaad -lmp4ff
+        DEFINES += HAVE_FAAD
+        SOURCES += $$ROOT_DIR/app/client/Fingerprinter/AacSource.cpp
+    }
+}
@@ -0,0 +1,18 @@
+TEMPLATE = app
+TARGET = test_fingerprintqueue
+QT = core network sql testlib
+CONFIG += lastfm
+CONFIG -= app_bundle
+INCLUDEPATH += ..
+include( ../../../admin/include.qmake )
+
+DEFINES += LASTFM_COLLAPSE_NAMESPACE
+
+SOURCES = TestFingerprintQueue.cpp \
+          ../FingerprintQueue.cpp \
+          ../FingerprintUploader.cpp \
+          ../FingerprintCache.cpp
+
+HEADERS = ../FingerprintQueue.h \
+          ../FingerprintUploader.h \
+          ../FingerprintCache.h
@@ -0,0 +1,223 @@
+/*
+   Copyright 2013 Last.fm Ltd.
+
+   This file is part of the Last.fm Desktop Application Suite.
+
+   lastfm-desktop is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   lastfm-desktop is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with lastfm-desktop.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "PcmConversion.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define PCM_SSE2 1
+    #include <emmintrin.h>
+#endif
+
+// Downmix weights are fixed point with this many fractional bits
+static const int WEIGHT_BITS = 14;
+
+
+static inline short
+clamp16( long long v )
+{
+    return static_cast<short>( v > 32767 ? 32767 : v < -32768 ? -32768 : v );
+}
+
+
+/** scales one sample of the given depth to 16 bits, rounding to nearest */
+static inline short
+scale16( long long v, int shift )
+{
+    if ( shift > 0 )
+        return clamp16( ( v + ( 1LL << ( shift - 1 ) ) ) >> shift );
+    return clamp16( v << -shift );
+}
+
+
+/** How much of each channel goes into the left and right outputs, for the
+  * FLAC channel assignments of 3 to 8 channels. False means the layout isn't
+  * one we know, so just use the first two channels. */
+static bool
+downmixWeights( int channels, int* left, int* right )
+{
+    static const double C = 0.7071; // -3dB
+
+    // front left, front right, centre, LFE, and the rest as pairs
+    static const double layouts[6][8][2] =
+    {
+        /* L R C */             { {1,0}, {0,1}, {C,C} },
+        /* L R BL BR */         { {1,0}, {0,1}, {C,0}, {0,C} },
+        /* L R C BL BR */       { {1,0}, {0,1}, {C,C}, {C,0}, {0,C} },
+        /* L R C LFE BL BR */   { {1,0}, {0,1}, {C,C}, {0,0}, {C,0}, {0,C} },
+        /* L R C LFE BC SL SR */{ {1,0}, {0,1}, {C,C}, {0,0}, {0.5,0.5}, {C,0}, {0,C} },
+        /* L R C LFE BL BR SL SR */ { {1,0}, {0,1}, {C,C}, {0,0}, {C,0}, {0,C}, {C,0}, {0,C} }
+    };
+
+    if ( channels < 3 || channels > 8 )
+        return false;
+
+    const double (*layout)[2] = layouts[channels - 3];
+
+    // normalise so every channel at full scale can't clip
+    double total = 0;
+    for ( int c = 0; c < channels; ++c )
+        total += layout[c][0];
+
+    for ( int c = 0; c < channels; ++c )
+    {
+        left[c] = static_cast<int>( layout[c][0] / total * ( 1 << WEIGHT_BITS ) + 0.5 );
+        right[c] = static_cast<int>( layout[c][1] / total * ( 1 << WEIGHT_BITS ) + 0.5 );
+    }
+
+    return true;
+}
+
+
+static void
+downmix( const int* const planes[], int channels, int shift, size_t nFrames, short* out )
+{
+    int left[8], right[8];
+
+    if ( !downmixWeights( channels, left, right ) )
+    {
+        for ( size_t i = 0; i < nFrames; ++i )
+        {
+            *out++ = scale16( planes[0][i], shift );
+            *out++ = scale16( planes[1][i], shift );
+        }
+        return;
+    }
+
+    for ( size_t i = 0; i < nFrames; ++i )
+    {
+        long long l = 0, r = 0;
+
+        for ( int c = 0; c < channels; ++c )
+        {
+            l += static_cast<long long>( planes[c][i] ) * left[c];
+            r += static_cast<long long>( planes[c][i] ) * right[c];
+        }
+
+        *out++ = scale16( l, shift + WEIGHT_BITS );
+        *out++ = scale16( r, shift + WEIGHT_BITS );
+    }
+}
+
+
+int
+PcmConversion::toInterleaved16Scalar( const int* const planes[], int channels, int bitsPerSample, size_t nFrames, short* out )
+{
+    const int shift = bitsPerSample - 16;
+
+    if ( channels == 1 )
+    {
+        for ( size_t i = 0; i < nFrames; ++i )
+            out[i] = scale16( planes[0][i], shift );
+    }
+    else if ( channels == 2 )
+    {
+        for ( size_t i = 0; i < nFrames; ++i )
+        {
+            out[2*i]   = scale16( planes[0][i], shift );
+            out[2*i+1] = scale16( planes[1][i], shift );
+        }
+    }
+    else if ( channels > 2 )
+    {
+        downmix( planes, channels, shift, nFrames, out );
+    }
+
+    return outputChannels( channels );
+}
+
+
+#ifdef PCM_SSE2
+enum Scaling { Down, None, Up };
+
+/** 4 samples scaled to 16 bits, still in 32 bit lanes */
+template <Scaling scaling>
+static inline __m128i
+scale4( const int* p, __m128i round, __m128i count )
+{
+    __m128i v = _mm_loadu_si128( reinterpret_cast<const __m128i*>( p ) );
+    if ( scaling == Down )
+        return _mm_sra_epi32( _mm_add_epi32( v, round ), count );
+    if ( scaling == Up )
+        return _mm_sll_epi32( v, count );
+    return v;
+}
+
+
+/** returns how many frames it did, the caller finishes the rest */
+template <Scaling scaling>
+static size_t
+sse2Interleave( const int* const planes[], int channels, int shift, size_t nFrames, short* out )
+{
+    const __m128i round = _mm_set1_epi32( shift > 0 ? 1 << ( shift - 1 ) : 0 );
+    const __m128i count = _mm_cvtsi32_si128( shift > 0 ? shift : -shift );
+
+    size_t i = 0;
+
+    if ( channels == 1 )
+    {
+        for ( ; i + 8 <= nFrames; i += 8 )
+        {
+            __m128i a = scale4<scaling>( planes[0] + i, round, count );
+            __m128i b = scale4<scaling>( planes[0] + i + 4, round, count );
+            // packs saturates, which is the clamp
+            _mm_storeu_si128( reinterpret_cast<__m128i*>( out + i ), _mm_packs_epi32( a, b ) );
+        }
+    }
+    else
+    {
+        for ( ; i + 4 <= nFrames; i += 4 )
+        {
+            __m128i l = scale4<scaling>( planes[0] + i, round, count );
+            __m128i r = scale4<scaling>( planes[1] + i, round, count );
+            __m128i lo = _mm_unpacklo_epi32( l, r );
+            __m128i hi = _mm_unpackhi_epi32( l, r );
+            _mm_storeu_si128( reinterpret_cast<__m128i*>( out + 2 * i ), _mm_packs_epi32( lo, hi ) );
+        }
+    }
+
+    return i;
+}
+#endif
+
+
+int
+PcmConversion::toInterleaved16( const int* const planes[], int channels, int bitsPerSample, size_t nFrames, short* out )
+{
+#ifdef PCM_SSE2
+    // Past 24 bits adding the rounding term could overflow a lane
+    if ( ( channels == 1 || channels == 2 ) && bitsPerSample <= 24 )
+    {
+        const int shift = bitsPerSample - 16;
+        size_t i;
+
+        if ( shift > 0 )
+            i = sse2Interleave<Down>( planes, channels, shift, nFrames, out );
+        else if ( shift < 0 )
+            i = sse2Interleave<Up>( planes, channels, shift, nFrames, out );
+        else
+            i = sse2Interleave<None>( planes, channels, shift, nFrames, out );
+
+        // the last few frames
+        const int* tail[2] = { planes[0] + i, planes[channels - 1] + i };
+        toInterleaved16Scalar( tail, channels, bitsPerSample, nFrames - i, out + i * channels );
+        return channels;
+    }
+#endif
+
+    return toInterleaved16Scalar( planes, channels, bitsPerSample, nFrames, out );
+}
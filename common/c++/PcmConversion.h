@@ -0,0 +1,46 @@
+/*
+   Copyright 2013 Last.fm Ltd.
+
+   This file is part of the Last.fm Desktop Application Suite.
+
+   lastfm-desktop is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   lastfm-desktop is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with lastfm-desktop.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef PCM_CONVERSION_H
+#define PCM_CONVERSION_H
+
+#include <cstddef>
+
+/** Turns the planar integer samples decoders like libFLAC produce into the
+  * interleaved signed 16 bit audio the fingerprinter wants.
+  *
+  * Samples deeper than 16 bits are rounded to 16 bits, shallower ones are
+  * scaled up. More than two channels are mixed down to stereo using the
+  * usual -3dB centre and surround weights, in the FLAC / WAVE channel order.
+  * The LFE channel is dropped.
+  *
+  * Mono and stereo streams of up to 24 bits use SSE2 where it's available. */
+namespace PcmConversion
+{
+    /** the number of channels toInterleaved16() writes for a stream */
+    inline int outputChannels( int channels ) { return channels > 2 ? 2 : channels; }
+
+    /** writes nFrames * outputChannels( channels ) samples to out
+      * @return outputChannels( channels ) */
+    int toInterleaved16( const int* const planes[], int channels, int bitsPerSample, size_t nFrames, short* out );
+
+    /** as above, but never vectorised, for testing */
+    int toInterleaved16Scalar( const int* const planes[], int channels, int bitsPerSample, size_t nFrames, short* out );
+}
+
+#endif
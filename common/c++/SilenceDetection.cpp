@@ -0,0 +1,237 @@
+/*
+   Copyright 2013 Last.fm Ltd.
+
+   This file is part of the Last.fm Desktop Application Suite.
+
+   lastfm-desktop is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   lastfm-desktop is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with lastfm-desktop.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "SilenceDetection.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define SILENCE_SSE2 1
+    #include <emmintrin.h>
+#endif
+
+#if defined(SILENCE_SSE2) && (defined(__clang__) || (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+    #define SILENCE_AVX2 1
+    #define SILENCE_AVX2_TARGET __attribute__((target("avx2")))
+    #include <immintrin.h>
+#elif defined(SILENCE_SSE2) && defined(_MSC_VER) && _MSC_VER >= 1700
+    #define SILENCE_AVX2 1
+    #define SILENCE_AVX2_TARGET
+    #include <immintrin.h>
+    #include <intrin.h>
+#endif
+
+// The 32 bit accumulators in the vector kernels are flushed into the 64 bit
+// total after this many frames, well before any lane could overflow
+static const size_t FRAMES_PER_BLOCK = 64 * 1024;
+
+
+static unsigned long long
+scalarSum( const short* samples, size_t nFrames, int channels )
+{
+    unsigned long long sum = 0;
+
+    if ( channels == 1 )
+    {
+        for ( size_t i = 0; i < nFrames; ++i )
+            sum += std::abs( static_cast<int>( samples[i] ) );
+    }
+    else if ( channels > 1 )
+    {
+        for ( size_t i = 0; i < nFrames; ++i, samples += channels )
+            sum += std::abs( (samples[0] >> 1) + (samples[1] >> 1) );
+    }
+
+    return sum;
+}
+
+
+#ifdef SILENCE_SSE2
+static inline unsigned long long
+horizontalSum( __m128i v )
+{
+    unsigned int lanes[4];
+    _mm_storeu_si128( reinterpret_cast<__m128i*>( lanes ), v );
+    return static_cast<unsigned long long>( lanes[0] ) + lanes[1] + lanes[2] + lanes[3];
+}
+
+
+static unsigned long long
+sse2Sum( const short* samples, size_t nFrames, int channels )
+{
+    if ( channels != 1 && channels != 2 )
+        return scalarSum( samples, nFrames, channels );
+
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ones = _mm_set1_epi16( 1 );
+    const size_t framesPerVector = 8 / channels;
+
+    unsigned long long sum = 0;
+    size_t i = 0;
+
+    while ( nFrames - i >= framesPerVector )
+    {
+        size_t vectors = std::min( nFrames - i, FRAMES_PER_BLOCK ) / framesPerVector;
+        __m128i acc = zero;
+
+        for ( size_t v = 0; v < vectors; ++v, i += framesPerVector )
+        {
+            __m128i x = _mm_loadu_si128( reinterpret_cast<const __m128i*>( samples + i * channels ) );
+
+            if ( channels == 1 )
+            {
+                // max( x, -x ) is |x| once read as unsigned, even for -32768
+                __m128i a = _mm_max_epi16( x, _mm_sub_epi16( zero, x ) );
+                acc = _mm_add_epi32( acc, _mm_unpacklo_epi16( a, zero ) );
+                acc = _mm_add_epi32( acc, _mm_unpackhi_epi16( a, zero ) );
+            }
+            else
+            {
+                // madd sums each (left >> 1, right >> 1) pair into 32 bits
+                __m128i m = _mm_madd_epi16( _mm_srai_epi16( x, 1 ), ones );
+                __m128i sign = _mm_srai_epi32( m, 31 );
+                acc = _mm_add_epi32( acc, _mm_sub_epi32( _mm_xor_si128( m, sign ), sign ) );
+            }
+        }
+
+        sum += horizontalSum( acc );
+    }
+
+    return sum + scalarSum( samples + i * channels, nFrames - i, channels );
+}
+#endif
+
+
+#ifdef SILENCE_AVX2
+SILENCE_AVX2_TARGET static unsigned long long
+avx2Sum( const short* samples, size_t nFrames, int channels )
+{
+    if ( channels != 1 && channels != 2 )
+        return scalarSum( samples, nFrames, channels );
+
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i ones = _mm256_set1_epi16( 1 );
+    const size_t framesPerVector = 16 / channels;
+
+    unsigned long long sum = 0;
+    size_t i = 0;
+
+    while ( nFrames - i >= framesPerVector )
+    {
+        size_t vectors = std::min( nFrames - i, FRAMES_PER_BLOCK ) / framesPerVector;
+        __m256i acc = zero;
+
+        for ( size_t v = 0; v < vectors; ++v, i += framesPerVector )
+        {
+            __m256i x = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( samples + i * channels ) );
+
+            if ( channels == 1 )
+            {
+                __m256i a = _mm256_max_epi16( x, _mm256_sub_epi16( zero, x ) );
+                acc = _mm256_add_epi32( acc, _mm256_unpacklo_epi16( a, zero ) );
+                acc = _mm256_add_epi32( acc, _mm256_unpackhi_epi16( a, zero ) );
+            }
+            else
+            {
+                __m256i m = _mm256_madd_epi16( _mm256_srai_epi16( x, 1 ), ones );
+                __m256i sign = _mm256_srai_epi32( m, 31 );
+                acc = _mm256_add_epi32( acc, _mm256_sub_epi32( _mm256_xor_si256( m, sign ), sign ) );
+            }
+        }
+
+        sum += horizontalSum( _mm_add_epi32( _mm256_castsi256_si128( acc ), _mm256_extracti128_si256( acc, 1 ) ) );
+    }
+
+    return sum + scalarSum( samples + i * channels, nFrames - i, channels );
+}
+
+
+static bool
+cpuHasAvx2()
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid( info, 0 );
+    if ( info[0] < 7 )
+        return false;
+
+    // the OS has to save the ymm registers for us too
+    __cpuid( info, 1 );
+    bool osxsave = ( info[2] & (1 << 27) ) != 0;
+    if ( !osxsave || ( _xgetbv( 0 ) & 0x6 ) != 0x6 )
+        return false;
+
+    __cpuidex( info, 7, 0 );
+    return ( info[1] & (1 << 5) ) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports( "avx2" );
+#endif
+}
+#endif
+
+
+SilenceDetection::Kernel
+SilenceDetection::bestKernel()
+{
+#if defined(SILENCE_AVX2)
+    static const Kernel kernel = cpuHasAvx2() ? AVX2Kernel : SSE2Kernel;
+    return kernel;
+#elif defined(SILENCE_SSE2)
+    return SSE2Kernel;
+#else
+    return ScalarKernel;
+#endif
+}
+
+
+unsigned long long
+SilenceDetection::magnitudeSum( Kernel kernel, const short* samples, size_t nFrames, int channels )
+{
+    switch ( std::min( kernel, bestKernel() ) )
+    {
+#ifdef SILENCE_AVX2
+        case AVX2Kernel:
+            return avx2Sum( samples, nFrames, channels );
+#endif
+#ifdef SILENCE_SSE2
+        case SSE2Kernel:
+            return sse2Sum( samples, nFrames, channels );
+#endif
+        default:
+            return scalarSum( samples, nFrames, channels );
+    }
+}
+
+
+unsigned long long
+SilenceDetection::magnitudeSum( const short* samples, size_t nFrames, int channels )
+{
+    return magnitudeSum( bestKernel(), samples, nFrames, channels );
+}
+
+
+bool
+SilenceDetection::isSilent( const short* samples, size_t nFrames, int channels, double threshold )
+{
+    threshold *= static_cast<double>( std::numeric_limits<short>::max() );
+    double sum = static_cast<double>( magnitudeSum( samples, nFrames, channels ) );
+    return sum < threshold * static_cast<double>( nFrames );
+}
@@ -0,0 +1,57 @@
+/*
+   Copyright 2013 Last.fm Ltd.
+
+   This file is part of the Last.fm Desktop Application Suite.
+
+   lastfm-desktop is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   lastfm-desktop is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with lastfm-desktop.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef SILENCE_DETECTION_H
+#define SILENCE_DETECTION_H
+
+#include <cstddef>
+
+/** The silence test shared by the FingerprintableSource implementations.
+  *
+  * A block of interleaved signed 16 bit audio is silent if the mean
+  * magnitude of its mono mix is below the threshold. Stereo is mixed as
+  * (left >> 1) + (right >> 1), which is what the sources always did, so
+  * fingerprints don't change. With more than two channels only the first
+  * two are considered.
+  *
+  * The vectorised kernels are picked once at runtime: AVX2 or SSE2 on x86,
+  * plain C++ everywhere else. */
+namespace SilenceDetection
+{
+    enum Kernel
+    {
+        ScalarKernel,
+        SSE2Kernel,
+        AVX2Kernel
+    };
+
+    /** the fastest kernel this CPU supports */
+    Kernel bestKernel();
+
+    /** sum of the magnitudes of the mono mix of nFrames frames */
+    unsigned long long magnitudeSum( const short* samples, size_t nFrames, int channels );
+
+    /** as above with a specific kernel, for testing. Kernels the CPU can't
+      * run fall back to bestKernel() */
+    unsigned long long magnitudeSum( Kernel, const short* samples, size_t nFrames, int channels );
+
+    /** @param threshold fraction of full scale, as passed to skipSilence() */
+    bool isSilent( const short* samples, size_t nFrames, int channels, double threshold );
+}
+
+#endif
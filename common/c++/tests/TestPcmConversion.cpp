@@ -0,0 +1,215 @@
+/*
+   Copyright 2013 Last.fm Ltd.
+
+   This file is part of the Last.fm Desktop Application Suite.
+
+   lastfm-desktop is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   lastfm-desktop is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with lastfm-desktop.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <QtTest>
+#include <QVector>
+#include "PcmConversion.h"
+
+using namespace PcmConversion;
+
+
+class TestPcmConversion : public QObject
+{
+    Q_OBJECT
+
+private:
+    static QVector<int> noise( int nFrames, int bitsPerSample );
+    static void legacy( const int* const planes[], int channels, size_t nFrames, short* out );
+
+private slots:
+    void testMatchesScalar_data();
+    void testMatchesScalar();
+    void testScaling();
+    void testDownmix();
+    void benchmark_data();
+    void benchmark();
+};
+
+
+QVector<int>
+TestPcmConversion::noise( int nFrames, int bitsPerSample )
+{
+    QVector<int> samples( nFrames );
+    for ( int i = 0; i < nFrames; ++i )
+    {
+        long long v = ( static_cast<long long>( qrand() ) << 16 ) ^ qrand();
+        samples[i] = static_cast<int>( ( v & ( ( 1LL << bitsPerSample ) - 1 ) ) - ( 1LL << ( bitsPerSample - 1 ) ) );
+    }
+    return samples;
+}
+
+
+/** the loop FlacSource::write_callback used before */
+void
+TestPcmConversion::legacy( const int* const planes[], int channels, size_t nFrames, short* out )
+{
+    size_t len = 0;
+    for ( size_t i = 0; i < nFrames; i++ )
+    {
+        switch ( channels )
+        {
+            case 1:
+                out[len] = (short)planes[0][i];
+                len++;
+                break;
+            case 2:
+                out[len] = (short)planes[0][i];
+                out[len+1] = (short)planes[1][i];
+                len += 2;
+                break;
+        }
+    }
+}
+
+
+void
+TestPcmConversion::testMatchesScalar_data()
+{
+    QTest::addColumn<int>( "bits" );
+    QTest::addColumn<int>( "channels" );
+    QTest::addColumn<int>( "frames" );
+
+    int bits[] = { 8, 16, 20, 24, 32 };
+    int sizes[] = { 0, 1, 3, 4, 7, 8, 9, 4608 };
+
+    for ( unsigned b = 0; b < sizeof(bits) / sizeof(bits[0]); ++b )
+        for ( int channels = 1; channels <= 6; ++channels )
+            for ( unsigned s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s )
+                QTest::newRow( QString( "%1bit %2ch %3" ).arg( bits[b] ).arg( channels ).arg( sizes[s] ).toLatin1() )
+                        << bits[b] << channels << sizes[s];
+}
+
+
+void
+TestPcmConversion::testMatchesScalar()
+{
+    QFETCH( int, bits );
+    QFETCH( int, channels );
+    QFETCH( int, frames );
+
+    QVector<QVector<int> > data;
+    data.reserve( channels );
+    const int* planes[8];
+    for ( int c = 0; c < channels; ++c )
+    {
+        data << noise( frames, bits );
+        planes[c] = data.last().constData();
+    }
+
+    QVector<short> expected( frames * outputChannels( channels ) );
+    QVector<short> actual( expected.size() );
+
+    QCOMPARE( toInterleaved16Scalar( planes, channels, bits, frames, expected.data() ), outputChannels( channels ) );
+    QCOMPARE( toInterleaved16( planes, channels, bits, frames, actual.data() ), outputChannels( channels ) );
+    QCOMPARE( actual, expected );
+}
+
+
+void
+TestPcmConversion::testScaling()
+{
+    // 24 bit rounds to the nearest 16 bit value and saturates
+    int left[] = { 0x7FFFFF, 0x000080, 0x00007F, -0x800000 };
+    int right[] = { -0x000081, 0x000180, 0x012345, 0x000000 };
+    const int* planes[] = { left, right };
+    short out[8];
+
+    toInterleaved16( planes, 2, 24, 4, out );
+    short expected24[] = { 32767, -1, 1, 2, 0, 0x123, -32768, 0 };
+    for ( int i = 0; i < 8; ++i )
+        QCOMPARE( out[i], expected24[i] );
+
+    // 8 bit is scaled up
+    int mono[] = { 127, -128, 1, 0 };
+    const int* monoPlanes[] = { mono };
+    toInterleaved16( monoPlanes, 1, 8, 4, out );
+    QCOMPARE( out[0], short( 127 << 8 ) );
+    QCOMPARE( out[1], short( -32768 ) );
+    QCOMPARE( out[2], short( 256 ) );
+    QCOMPARE( out[3], short( 0 ) );
+}
+
+
+void
+TestPcmConversion::testDownmix()
+{
+    // 5.1 with only the left surround playing comes out on the left
+    int silent[] = { 0, 0 };
+    int loud[] = { 20000, -20000 };
+    const int* planes[] = { silent, silent, silent, silent, loud, silent };
+    short out[4];
+
+    QCOMPARE( toInterleaved16( planes, 6, 16, 2, out ), 2 );
+    QVERIFY( out[0] > 0 && out[0] < 20000 );
+    QCOMPARE( out[1], short( 0 ) );
+    QVERIFY( out[2] < 0 && out[2] > -20000 );
+    QCOMPARE( out[3], short( 0 ) );
+
+    // every channel at full scale doesn't clip
+    int full[] = { 32767 };
+    const int* fullPlanes[] = { full, full, full, full, full, full };
+    QCOMPARE( toInterleaved16( fullPlanes, 6, 16, 1, out ), 2 );
+    QVERIFY( out[0] >= 32766 && out[1] >= 32766 );
+}
+
+
+void
+TestPcmConversion::benchmark_data()
+{
+    QTest::addColumn<int>( "method" );
+    QTest::addColumn<int>( "bits" );
+
+    QTest::newRow( "legacy 16bit" ) << 0 << 16;
+    QTest::newRow( "scalar 16bit" ) << 1 << 16;
+    QTest::newRow( "vectorised 16bit" ) << 2 << 16;
+    QTest::newRow( "scalar 24bit" ) << 1 << 24;
+    QTest::newRow( "vectorised 24bit" ) << 2 << 24;
+}
+
+
+void
+TestPcmConversion::benchmark()
+{
+    QFETCH( int, method );
+    QFETCH( int, bits );
+
+    // ten seconds of 44.1kHz stereo, in FLAC's usual 4608 frame blocks
+    const int frames = 441000;
+    QVector<int> left = noise( frames, bits );
+    QVector<int> right = noise( frames, bits );
+    QVector<short> out( frames * 2 );
+
+    QBENCHMARK
+    {
+        for ( int i = 0; i < frames; i += 4608 )
+        {
+            const int* planes[] = { left.constData() + i, right.constData() + i };
+            size_t n = qMin( 4608, frames - i );
+
+            if ( method == 0 )
+                legacy( planes, 2, n, out.data() + i * 2 );
+            else if ( method == 1 )
+                toInterleaved16Scalar( planes, 2, bits, n, out.data() + i * 2 );
+            else
+                toInterleaved16( planes, 2, bits, n, out.data() + i * 2 );
+        }
+    }
+}
+
+QTEST_APPLESS_MAIN(TestPcmConversion)
+#include "TestPcmConversion.moc"
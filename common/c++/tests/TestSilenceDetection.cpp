@@ -0,0 +1,192 @@
+/*
+   Copyright 2013 Last.fm Ltd.
+
+   This file is part of the Last.fm Desktop Application Suite.
+
+   lastfm-desktop is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   lastfm-desktop is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with lastfm-desktop.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <QtTest>
+#include <QVector>
+#include <cstdlib>
+#include <cmath>
+#include "SilenceDetection.h"
+
+using namespace SilenceDetection;
+
+Q_DECLARE_METATYPE(SilenceDetection::Kernel)
+
+
+class TestSilenceDetection : public QObject
+{
+    Q_OBJECT
+
+private:
+    static QVector<short> noise( int nFrames, int channels );
+    static QVector<short> tone( int nFrames, int channels, double amplitude );
+    static unsigned long long reference( const QVector<short>& samples, int channels );
+
+private slots:
+    void testKernels_data();
+    void testKernels();
+    void testExtremes();
+    void testThreshold();
+    void benchmark_data();
+    void benchmark();
+};
+
+
+QVector<short>
+TestSilenceDetection::noise( int nFrames, int channels )
+{
+    QVector<short> samples( nFrames * channels );
+    for ( int i = 0; i < samples.size(); ++i )
+        samples[i] = static_cast<short>( ( qrand() & 0xFFFF ) - 0x8000 );
+    return samples;
+}
+
+
+QVector<short>
+TestSilenceDetection::tone( int nFrames, int channels, double amplitude )
+{
+    QVector<short> samples( nFrames * channels );
+    for ( int i = 0; i < nFrames; ++i )
+        for ( int c = 0; c < channels; ++c )
+            samples[i * channels + c] = static_cast<short>( amplitude * 32767 * std::sin( i * 0.0627 ) );
+    return samples;
+}
+
+
+/** the loop the sources used before they shared a kernel */
+unsigned long long
+TestSilenceDetection::reference( const QVector<short>& buf, int channels )
+{
+    unsigned long long sum = 0;
+    switch ( channels )
+    {
+        case 1:
+            for ( int j = 0; j < buf.size(); ++j )
+                sum += abs( buf[j] );
+            break;
+        case 2:
+            for ( int j = 0; j < buf.size(); j += 2 )
+                sum += abs( (buf[j] >> 1) + (buf[j+1] >> 1) );
+            break;
+    }
+    return sum;
+}
+
+
+void
+TestSilenceDetection::testKernels_data()
+{
+    QTest::addColumn<int>( "channels" );
+    QTest::addColumn<int>( "frames" );
+
+    int sizes[] = { 0, 1, 7, 8, 15, 16, 17, 1152, 4096, 65537, 200003 };
+    for ( int channels = 1; channels <= 2; ++channels )
+        for ( unsigned i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i )
+            QTest::newRow( QString( "%1ch %2" ).arg( channels ).arg( sizes[i] ).toLatin1() ) << channels << sizes[i];
+}
+
+
+void
+TestSilenceDetection::testKernels()
+{
+    QFETCH( int, channels );
+    QFETCH( int, frames );
+
+    QVector<short> samples = noise( frames, channels );
+    unsigned long long expected = reference( samples, channels );
+
+    QCOMPARE( magnitudeSum( ScalarKernel, samples.constData(), frames, channels ), expected );
+    QCOMPARE( magnitudeSum( SSE2Kernel, samples.constData(), frames, channels ), expected );
+    QCOMPARE( magnitudeSum( AVX2Kernel, samples.constData(), frames, channels ), expected );
+    QCOMPARE( magnitudeSum( samples.constData(), frames, channels ), expected );
+}
+
+
+void
+TestSilenceDetection::testExtremes()
+{
+    // -32768 has no positive 16 bit counterpart
+    for ( int channels = 1; channels <= 2; ++channels )
+    {
+        QVector<short> samples( 1001 * channels, -32768 );
+        unsigned long long expected = reference( samples, channels );
+        QCOMPARE( magnitudeSum( SSE2Kernel, samples.constData(), 1001, channels ), expected );
+        QCOMPARE( magnitudeSum( AVX2Kernel, samples.constData(), 1001, channels ), expected );
+
+        samples.fill( 32767 );
+        expected = reference( samples, channels );
+        QCOMPARE( magnitudeSum( SSE2Kernel, samples.constData(), 1001, channels ), expected );
+        QCOMPARE( magnitudeSum( AVX2Kernel, samples.constData(), 1001, channels ), expected );
+    }
+}
+
+
+void
+TestSilenceDetection::testThreshold()
+{
+    QVector<short> silence( 2048 * 2, 0 );
+    QVERIFY( isSilent( silence.constData(), 2048, 2, 0.0001 ) );
+
+    QVector<short> quiet = tone( 2048, 2, 0.00005 );
+    QVERIFY( isSilent( quiet.constData(), 2048, 2, 0.0001 ) );
+
+    QVector<short> loud = tone( 2048, 2, 0.5 );
+    QVERIFY( !isSilent( loud.constData(), 2048, 2, 0.0001 ) );
+
+    QVector<short> mono = tone( 2048, 1, 0.5 );
+    QVERIFY( !isSilent( mono.constData(), 2048, 1, 0.0001 ) );
+}
+
+
+void
+TestSilenceDetection::benchmark_data()
+{
+    QTest::addColumn<SilenceDetection::Kernel>( "kernel" );
+    QTest::addColumn<int>( "channels" );
+
+    QTest::newRow( "scalar mono" ) << ScalarKernel << 1;
+    QTest::newRow( "scalar stereo" ) << ScalarKernel << 2;
+    QTest::newRow( "sse2 mono" ) << SSE2Kernel << 1;
+    QTest::newRow( "sse2 stereo" ) << SSE2Kernel << 2;
+    QTest::newRow( "avx2 mono" ) << AVX2Kernel << 1;
+    QTest::newRow( "avx2 stereo" ) << AVX2Kernel << 2;
+}
+
+
+void
+TestSilenceDetection::benchmark()
+{
+    QFETCH( SilenceDetection::Kernel, kernel );
+    QFETCH( int, channels );
+
+    if ( kernel > bestKernel() )
+        QSKIP( "Kernel not supported on this CPU", SkipSingle );
+
+    // ten seconds of 44.1kHz audio
+    QVector<short> samples = noise( 441000, channels );
+    unsigned long long sum = 0;
+
+    QBENCHMARK
+    {
+        sum += magnitudeSum( kernel, samples.constData(), 441000, channels );
+    }
+
+    QVERIFY( sum > 0 );
+}
+
+QTEST_APPLESS_MAIN(TestSilenceDetection)
+#include "TestSilenceDetection.moc"
@@ -0,0 +1,6 @@
+TEMPLATE = app
+QT = testlib
+INCLUDEPATH += ..
+include( ../../../admin/include.qmake )
+
+SOURCES = TestSilenceDetection.cpp ../SilenceDetection.cpp
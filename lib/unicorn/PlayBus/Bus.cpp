@@ -61,6 +61,17 @@ unicorn::Bus::announceSessionChange( unicorn::Session& s )
     sendMessage( ba );
 }
 
+void
+unicorn::Bus::announceSettingsChange()
+{
+    QByteArray ba;
+    QDataStream ds( &ba, QIODevice::WriteOnly | QIODevice::Truncate );
+
+    ds << QString( "SETTINGSCHANGED" );
+
+    sendMessage( ba );
+}
+
 void
 unicorn::Bus::onMessage( const QByteArray& message )
 {
@@ -80,6 +91,10 @@ unicorn::Bus::onMessage( const QByteArray& message )
         emit sessionChanged( *session );
         delete session;
     }
+    else if( stringMessage == "SETTINGSCHANGED" )
+    {
+        emit settingsChanged();
+    }
     else if( message.startsWith( "LOVED=" ))
     {
         QByteArray sessionData = message.right( message.size() - 6);
@@ -35,6 +35,7 @@ public:
     bool isWizardRunning();
     QMap<QString, QString> getSessionData();
     void announceSessionChange( unicorn::Session& s );
+    void announceSettingsChange();
 
 private slots:
     void onMessage( const QByteArray& message );
@@ -44,6 +45,7 @@ signals:
     void wizardRunningQuery( const QString& uuid );
     void sessionQuery( const QString& uuid );
     void sessionChanged( const unicorn::Session& s );
+    void settingsChanged();
     void rosterUpdated();
     void lovedStateChanged(bool loved);
 };
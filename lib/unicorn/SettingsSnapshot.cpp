@@ -0,0 +1,265 @@
+/*
+   Copyright 2013 Last.fm Ltd.
+
+   This file is part of the Last.fm Desktop Application Suite.
+
+   lastfm-desktop is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   lastfm-desktop is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with lastfm-desktop.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "SettingsSnapshot.h"
+#include "UnicornSettings.h"
+#include "PlayBus/Bus.h"
+
+#include <QCoreApplication>
+#include <QTimer>
+
+
+static QVariant
+orDefault( const QVariant& value, const QVariant& defaultValue )
+{
+    return value.isValid() ? value : defaultValue;
+}
+
+
+unicorn::SettingsSnapshot
+unicorn::SettingsSnapshot::read( const QString& user )
+{
+    static const char* const userKeys[] = {
+        "scrobblingOn", "podcasts", "scrobblePoint", "enforceScrobbleTimeMax",
+        "ExclusionDirs", "lastStationUrl", "lastStationTitle",
+        "Session/valid", "Session/subscriptionPrice",
+        "Session/youRadio", "Session/registeredRadio", "Session/subscriberRadio",
+        "Session/youWebRadio", "Session/registeredWebRadio", "Session/subscriberWebRadio" };
+
+    static const char* const appKeys[] = { "rep", "mainstr", "disco" };
+
+    SettingsSnapshot s;
+    s.user = user;
+
+    UserSettings us( user );
+
+    for ( size_t i = 0; i < sizeof( userKeys ) / sizeof( userKeys[0] ); ++i )
+        s.setUserValue( userKeys[i], us.value( userKeys[i] ) );
+
+    int count = us.beginReadArray( "associatedDevices" );
+    for ( int i = 0; i < count; ++i )
+    {
+        us.setArrayIndex( i );
+        s.associatedDevices << us.value( "deviceId", "" ).toString();
+    }
+    us.endArray();
+
+    AppSettings as;
+
+    for ( size_t i = 0; i < sizeof( appKeys ) / sizeof( appKeys[0] ); ++i )
+        s.setAppValue( appKeys[i], as.value( appKeys[i] ) );
+
+    return s;
+}
+
+
+/** the defaults are the same as UserSettings' and RadioService's */
+void
+unicorn::SettingsSnapshot::setUserValue( const QString& key, const QVariant& value )
+{
+    if ( key == "scrobblingOn" ) scrobblingOn = orDefault( value, true ).toBool();
+    else if ( key == "podcasts" ) podcasts = orDefault( value, true ).toBool();
+    else if ( key == "scrobblePoint" ) scrobblePoint = orDefault( value, 50 ).toDouble();
+    else if ( key == "enforceScrobbleTimeMax" ) enforceScrobbleTimeMax = orDefault( value, true ).toBool();
+    else if ( key == "ExclusionDirs" ) exclusionDirs = value.toStringList();
+    else if ( key == "lastStationUrl" ) lastStationUrl = value.toString();
+    else if ( key == "lastStationTitle" ) lastStationTitle = value.toString();
+    else if ( key == "Session/valid" ) sessionInfo.valid = value.toBool();
+    else if ( key == "Session/subscriptionPrice" ) sessionInfo.subscriptionPrice = orDefault( value, "" ).toString();
+    else if ( key == "Session/youRadio" ) sessionInfo.youRadio = value.toBool();
+    else if ( key == "Session/registeredRadio" ) sessionInfo.registeredRadio = value.toBool();
+    else if ( key == "Session/subscriberRadio" ) sessionInfo.subscriberRadio = value.toBool();
+    else if ( key == "Session/youWebRadio" ) sessionInfo.youWebRadio = value.toBool();
+    else if ( key == "Session/registeredWebRadio" ) sessionInfo.registeredWebRadio = value.toBool();
+    else if ( key == "Session/subscriberWebRadio" ) sessionInfo.subscriberWebRadio = value.toBool();
+}
+
+
+void
+unicorn::SettingsSnapshot::setAppValue( const QString& key, const QVariant& value )
+{
+    if ( key == "rep" ) rep = orDefault( value, 0.5 ).toDouble();
+    else if ( key == "mainstr" ) mainstr = orDefault( value, 0.5 ).toDouble();
+    else if ( key == "disco" ) disco = value.toBool();
+}
+
+
+unicorn::SettingsStore&
+unicorn::SettingsStore::instance()
+{
+    static SettingsStore s;
+    return s;
+}
+
+
+unicorn::SettingsStore::SettingsStore()
+    : m_current( new SettingsSnapshot( SettingsSnapshot::read( User().name() ) ) )
+    , m_quitting( false )
+{
+    m_flushTimer = new QTimer( this );
+    m_flushTimer->setSingleShot( true );
+    m_flushTimer->setInterval( 500 );
+    connect( m_flushTimer, SIGNAL(timeout()), SLOT(flush()) );
+
+    if ( qApp )
+        connect( qApp, SIGNAL(aboutToQuit()), SLOT(onAboutToQuit()) );
+}
+
+
+unicorn::SettingsStore::~SettingsStore()
+{
+    // We're static, so this is after the application has gone, and it's
+    // too late to write settings. onAboutToQuit() has done that
+    qDeleteAll( m_retired );
+    delete m_current.fetchAndStoreOrdered( 0 );
+}
+
+
+const unicorn::SettingsSnapshot&
+unicorn::SettingsStore::snapshot()
+{
+#if QT_VERSION >= 0x050000
+    return *instance().m_current.loadAcquire();
+#else
+    return *static_cast<SettingsSnapshot*>( instance().m_current );
+#endif
+}
+
+
+void
+unicorn::SettingsStore::publish( SettingsSnapshot* snapshot )
+{
+    m_retired << m_current.fetchAndStoreOrdered( snapshot );
+
+    // nobody can still be reading it once we're back in the event loop
+    if ( m_retired.count() == 1 )
+        QTimer::singleShot( 0, this, SLOT(freeRetired()) );
+
+    emit changed();
+}
+
+
+void
+unicorn::SettingsStore::freeRetired()
+{
+    qDeleteAll( m_retired );
+    m_retired.clear();
+}
+
+
+void
+unicorn::SettingsStore::onAboutToQuit()
+{
+    m_quitting = true;
+    flush();
+}
+
+
+void
+unicorn::SettingsStore::scheduleFlush()
+{
+    // There won't be an event loop to flush from once we're quitting
+    if ( m_quitting || !qApp )
+    {
+        flush();
+        return;
+    }
+
+    // in case we were made before the application was
+    connect( qApp, SIGNAL(aboutToQuit()), this, SLOT(onAboutToQuit()), Qt::UniqueConnection );
+    m_flushTimer->start();
+}
+
+
+void
+unicorn::SettingsStore::setUserValue( const QString& key, const QVariant& value )
+{
+    SettingsSnapshot* s = new SettingsSnapshot( snapshot() );
+    s->setUserValue( key, value );
+
+    m_userWrites << qMakePair( key, value );
+    publish( s );
+    scheduleFlush();
+}
+
+
+void
+unicorn::SettingsStore::setAppValue( const QString& key, const QVariant& value )
+{
+    SettingsSnapshot* s = new SettingsSnapshot( snapshot() );
+    s->setAppValue( key, value );
+
+    m_appWrites << qMakePair( key, value );
+    publish( s );
+    scheduleFlush();
+}
+
+
+void
+unicorn::SettingsStore::setBus( Bus* bus )
+{
+    if ( m_bus )
+        disconnect( m_bus, 0, this, 0 );
+
+    m_bus = bus;
+
+    if ( m_bus )
+        connect( m_bus, SIGNAL(settingsChanged()), SLOT(reload()) );
+}
+
+
+void
+unicorn::SettingsStore::flush()
+{
+    m_flushTimer->stop();
+
+    if ( m_userWrites.isEmpty() && m_appWrites.isEmpty() )
+        return;
+
+    if ( !m_userWrites.isEmpty() )
+    {
+        // reload() flushes before it changes user, so these are all for
+        // the snapshot's user
+        UserSettings us( snapshot().user );
+        for ( int i = 0; i < m_userWrites.count(); ++i )
+            us.setValue( m_userWrites[i].first, m_userWrites[i].second );
+        us.sync();
+        m_userWrites.clear();
+    }
+
+    if ( !m_appWrites.isEmpty() )
+    {
+        AppSettings as;
+        for ( int i = 0; i < m_appWrites.count(); ++i )
+            as.setValue( m_appWrites[i].first, m_appWrites[i].second );
+        as.sync();
+        m_appWrites.clear();
+    }
+
+    if ( m_bus )
+        m_bus->announceSettingsChange();
+}
+
+
+void
+unicorn::SettingsStore::reload()
+{
+    flush();
+    publish( new SettingsSnapshot( SettingsSnapshot::read( User().name() ) ) );
+}
@@ -0,0 +1,131 @@
+/*
+   Copyright 2013 Last.fm Ltd.
+
+   This file is part of the Last.fm Desktop Application Suite.
+
+   lastfm-desktop is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   lastfm-desktop is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with lastfm-desktop.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef UNICORN_SETTINGS_SNAPSHOT_H
+#define UNICORN_SETTINGS_SNAPSHOT_H
+
+#include "lib/unicorn/UnicornSession.h"
+
+#include "lib/DllExportMacro.h"
+
+#include <QAtomicPointer>
+#include <QList>
+#include <QPair>
+#include <QPointer>
+#include <QStringList>
+#include <QVariant>
+
+class QTimer;
+
+namespace unicorn
+{
+    class Bus;
+
+    /** The settings that get read for every track or station, copied out
+      * of QSettings for the current user and application. */
+    struct UNICORN_DLLEXPORT SettingsSnapshot
+    {
+        QString user;
+
+        // UserSettings
+        bool scrobblingOn;
+        bool podcasts;
+        double scrobblePoint;
+        bool enforceScrobbleTimeMax;
+        QStringList exclusionDirs;
+        QStringList associatedDevices;
+        QString lastStationUrl;
+        QString lastStationTitle; // null if we've never had one
+        Session::Info sessionInfo;
+
+        // AppSettings
+        double rep;
+        double mainstr;
+        bool disco;
+
+        /** with one UserSettings and one AppSettings */
+        static SettingsSnapshot read( const QString& user );
+
+        /** an invalid value puts back the default */
+        void setUserValue( const QString& key, const QVariant& value );
+        void setAppValue( const QString& key, const QVariant& value );
+    };
+
+
+    /** Hands out the current SettingsSnapshot.
+      *
+      * Reading the snapshot is a single atomic load, so there is no
+      * QSettings to construct and no lock to take. A published snapshot is
+      * never changed. Changes make a new snapshot, which is fine as these
+      * settings change when the user changes them and not otherwise. The
+      * ones they replace are freed the next time the main thread gets back
+      * to its event loop, so don't keep a reference past that; copy what
+      * you need instead.
+      *
+      * Writes through setUserValue() and setAppValue() show up in the
+      * snapshot straight away and go to QSettings a moment later, or
+      * straight away once the application is quitting. Other processes on
+      * the Bus are told when that happens, and reload. Anything that writes
+      * these keys to QSettings directly should call reload().
+      *
+      * Only use it from the main thread. */
+    class UNICORN_DLLEXPORT SettingsStore : public QObject
+    {
+        Q_OBJECT
+    public:
+        static SettingsStore& instance();
+
+        static const SettingsSnapshot& snapshot();
+
+        void setUserValue( const QString& key, const QVariant& value );
+        void setAppValue( const QString& key, const QVariant& value );
+
+        void setBus( Bus* bus );
+
+    public slots:
+        void reload();
+        void flush();
+
+    signals:
+        void changed();
+
+    private slots:
+        void freeRetired();
+        void onAboutToQuit();
+
+    private:
+        SettingsStore();
+        ~SettingsStore();
+
+        void publish( SettingsSnapshot* snapshot );
+        void scheduleFlush();
+
+        QAtomicPointer<SettingsSnapshot> m_current;
+        // replaced, but someone may still be reading them
+        QList<SettingsSnapshot*> m_retired;
+        bool m_quitting;
+
+        QList< QPair<QString, QVariant> > m_userWrites;
+        QList< QPair<QString, QVariant> > m_appWrites;
+        QTimer* m_flushTimer;
+
+        QPointer<Bus> m_bus;
+    };
+}
+
+#endif
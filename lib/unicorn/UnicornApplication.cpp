@@ -54,6 +54,7 @@
 #include "dialogs/UserManagerDialog.h"
 #include "LoginProcess.h"
 #include "QMessageBoxBuilder.h"
+#include "SettingsSnapshot.h"
 #include "SignalBlocker.h"
 #include "UnicornCoreApplication.h"
 #include "UnicornSettings.h"
@@ -126,6 +127,8 @@ unicorn::Application::init()
     connect( m_bus, SIGNAL(sessionChanged(unicorn::Session)), SLOT(onBusSessionChanged(unicorn::Session)));
     connect( m_bus, SIGNAL(lovedStateChanged(bool)), SIGNAL(busLovedStateChanged(bool)));
 
+    SettingsStore::instance().setBus( m_bus );
+
     m_bus->board();
 
 #ifdef __APPLE__
@@ -334,6 +337,9 @@ unicorn::Application::changeSession( Session* newSession, bool announce )
 
     lastfm::ws::Username = m_currentSession->user().name();
     lastfm::ws::SessionKey = m_currentSession->sessionKey();
+
+    // the snapshot is for the new user now
+    SettingsStore::instance().reload();
     
     if( announce )
         m_bus->announceSessionChange( currentSession() );
@@ -26,6 +26,7 @@
 #include <lastfm/Auth.h>
 #include <lastfm/XmlQuery.h>
 
+#include "SettingsSnapshot.h"
 #include "UnicornSession.h"
 #include "UnicornSettings.h"
 
@@ -288,6 +289,9 @@ Session::cacheSessionInfo( const unicorn::Session& session )
 {
     UserSettings userSettings( session.user().name() );
     userSettings.setSessionInfo( m_info );
+
+    if ( session.user().name() == SettingsStore::snapshot().user )
+        SettingsStore::instance().reload();
 }
 
 QDataStream&
@@ -22,8 +22,10 @@
 #include "UnicornApplication.h"
 #include <lastfm/User.h>
 
+// defaultFormat() is NativeFormat unless a test has asked for files it can
+// put somewhere harmless
 unicorn::Settings::Settings()
-    :QSettings( unicorn::organizationName(), "" )
+    :QSettings( QSettings::defaultFormat(), QSettings::UserScope, unicorn::organizationName(), "" )
 {}
 
 QList<lastfm::User>
@@ -142,7 +144,7 @@ unicorn::Settings::setCheckForUpdates( bool checkForUpdates )
 }
 
 unicorn::AppSettings::AppSettings( QString appname )
-    : QSettings( unicorn::organizationName(), appname.isEmpty() ? qApp->applicationName() : appname )
+    : QSettings( QSettings::defaultFormat(), QSettings::UserScope, unicorn::organizationName(), appname.isEmpty() ? qApp->applicationName() : appname )
 {}
 
 unicorn::UserSettings::UserSettings( QString username )
@@ -0,0 +1,155 @@
+/*
+   Copyright 2013 Last.fm Ltd.
+
+   This file is part of the Last.fm Desktop Application Suite.
+
+   lastfm-desktop is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   lastfm-desktop is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with lastfm-desktop.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <QtTest>
+#include <QTime>
+
+#include <lastfm/ws.h>
+
+#include "lib/unicorn/SettingsSnapshot.h"
+#include "lib/unicorn/UnicornSettings.h"
+
+
+/** Reading the settings ScrobbleService checks for every track, from a
+  * fresh UserSettings as it used to and from the snapshot. */
+class BenchSettings : public QObject
+{
+    Q_OBJECT
+
+    QString m_dir;
+
+    static bool
+    readSettings()
+    {
+        unicorn::UserSettings us;
+        return us.scrobblingOn() && us.podcasts() && us.scrobblePoint() > 0 && us.exclusionDirs().count() >= 0;
+    }
+
+    static bool
+    readSnapshot()
+    {
+        const unicorn::SettingsSnapshot& s = unicorn::SettingsStore::snapshot();
+        return s.scrobblingOn && s.podcasts && s.scrobblePoint > 0 && s.exclusionDirs.count() >= 0;
+    }
+
+private slots:
+    void initTestCase()
+    {
+        // setPath() can't move the registry or CFPreferences, so keep to ini
+        // files of our own rather than touch the real Last.fm settings
+        m_dir = QDir::tempPath() + "/bench_settings";
+        QSettings::setDefaultFormat( QSettings::IniFormat );
+        QSettings::setPath( QSettings::IniFormat, QSettings::UserScope, m_dir );
+        QCoreApplication::setApplicationName( "bench_settings" );
+
+        lastfm::ws::Username = "bench";
+
+        unicorn::UserSettings us;
+        us.setScrobblingOn( true );
+        us.setPodcasts( true );
+        us.setScrobblePoint( 60 );
+        us.setExclusionDirs( QStringList() << "/a" << "/b" );
+        unicorn::AppSettings().setValue( "rep", 0.25 );
+    }
+
+    void cleanupTestCase()
+    {
+        // only what we wrote, in case anything else shares the files
+        unicorn::UserSettings().remove( "" );
+        unicorn::AppSettings().remove( "rep" );
+    }
+
+    void testSnapshot()
+    {
+        const unicorn::SettingsSnapshot& s = unicorn::SettingsStore::snapshot();
+        unicorn::UserSettings us;
+
+        QCOMPARE( s.user, QString( "bench" ) );
+        QCOMPARE( s.scrobblePoint, us.scrobblePoint() );
+        QCOMPARE( s.exclusionDirs, us.exclusionDirs() );
+        QCOMPARE( s.enforceScrobbleTimeMax, us.enforceScrobbleTimeMax() );
+        QCOMPARE( s.rep, 0.25 );
+        QCOMPARE( s.mainstr, 0.5 );
+        QVERIFY( s.lastStationTitle.isNull() );
+    }
+
+    void testWriteBehind()
+    {
+        unicorn::SettingsStore& store = unicorn::SettingsStore::instance();
+        const unicorn::SettingsSnapshot& before = store.snapshot();
+
+        QSignalSpy spy( &store, SIGNAL(changed()) );
+        store.setUserValue( "podcasts", false );
+
+        QCOMPARE( spy.count(), 1 );
+        QCOMPARE( store.snapshot().podcasts, false );
+        // the old one is left alone for anyone still reading it
+        QCOMPARE( before.podcasts, true );
+
+        store.flush();
+        QCOMPARE( unicorn::UserSettings().podcasts(), false );
+
+        unicorn::UserSettings().setPodcasts( true );
+        store.reload();
+        QCOMPARE( store.snapshot().podcasts, true );
+    }
+
+    void benchmark_data()
+    {
+        QTest::addColumn<bool>( "snapshot" );
+        QTest::newRow( "UserSettings" ) << false;
+        QTest::newRow( "snapshot" ) << true;
+    }
+
+    void benchmark()
+    {
+        QFETCH( bool, snapshot );
+
+        bool ok = true;
+        QBENCHMARK
+        {
+            ok = snapshot ? readSnapshot() : readSettings();
+        }
+        QVERIFY( ok );
+    }
+
+    void readsPerSecond()
+    {
+        const int ms = 500;
+
+        for ( int pass = 0; pass < 2; ++pass )
+        {
+            int reads = 0;
+            QTime t;
+            t.start();
+
+            while ( t.elapsed() < ms )
+            {
+                for ( int i = 0; i < 100; ++i )
+                    pass ? readSnapshot() : readSettings();
+                reads += 100;
+            }
+
+            qDebug() << ( pass ? "snapshot:" : "UserSettings:" ) << qint64( reads ) * 1000 / t.elapsed() << "reads/s";
+        }
+    }
+};
+
+QTEST_MAIN(BenchSettings)
+#include "BenchSettings.moc"
@@ -0,0 +1,10 @@
+TEMPLATE = app
+TARGET = bench_settings
+QT = core gui network xml testlib
+CONFIG += lastfm unicorn
+CONFIG -= app_bundle
+include( ../../../admin/include.qmake )
+
+DEFINES += LASTFM_COLLAPSE_NAMESPACE
+
+SOURCES = BenchSettings.cpp
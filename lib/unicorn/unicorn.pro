@@ -45,6 +45,7 @@ SOURCES += \
     widgets/ActionButton.cpp \
     UpdateInfoFetcher.cpp \
     UnicornSettings.cpp \
+    SettingsSnapshot.cpp \
     UnicornSession.cpp \
     UnicornMainWindow.cpp \
     UnicornCoreApplication.cpp \
@@ -103,6 +104,7 @@ HEADERS += \
     widgets/ActionButton.h \
     UpdateInfoFetcher.h \
     UnicornSettings.h \
+    SettingsSnapshot.h \
     UnicornSession.h \
     UnicornMainWindow.h \
     UnicornCoreApplication.h \